@@ -142,11 +142,49 @@ static short mapxstart=0; /* x-value for the bitmap. */
 /*   byte screens[][SCREENWIDTH*SCREENHEIGHT];   */
 /*   void V_MarkRect (int x, int y, int width, int height);   */
 
-/* Functions */
+/*
+ * The walls in map coordinates, one per line, built by AM_initLines and
+ *  freed with the level.  color is what the line was last drawn in, -1
+ *  for not drawn, so AM_cullWalls can tell when the walls look different.
+ */
+typedef struct
+{
+  mline_t ml;
+  line_t *line;
+  int color;
+} amline_t;
+
+static amline_t *amlines;
+static unsigned *amvisible;  /* a bit per line, set for the lines near the window */
+static int *amdrawn;         /* the lines to draw this frame, in line order */
+static int numamdrawn;
+
+/*
+ * The background, grid and walls as last drawn, copied back instead of
+ *  drawn again as long as the window and the walls stay the same.
+ */
+static byte *amframe;
+static boolean amframevalid;
+static fixed_t amframe_x, amframe_y, amframe_x2, amframe_y2, amframe_scale;
+static int amframe_grid;
+
+/*
+ * The antialias colors by weight and fade, as PUTDOT picked them.  Row
+ *  AMSOLID is for the pixels right on the line, which fade a little less.
+ *  The fade is the sum of amxfade and amyfade, the darkening towards the
+ *  edges of the window.
+ */
+#define AMSOLID 8
+#define AMFADES 15
+static byte amramp[NUMALIAS][AMSOLID+1][AMFADES];
+static byte amxfade[MAXSCREENWIDTH];
+static byte amyfade[MAXSCREENHEIGHT+1];
 
+/* Functions */
 
-void DrawWuLine(int X0, int Y0, int X1, int Y1, byte *BaseColor,
-		int NumLevels, unsigned short IntensityBits);
+void AM_initRamps(void);
+void AM_initLines(void);
+static void AM_drawWuLine(fline_t *fl, byte (*ramp)[AMFADES]);
 
 /*
   // Calculates the slope and slope according to the x-axis of a line
@@ -415,6 +453,8 @@ void AM_LevelInit(void)
   scale_mtof = FixedDiv(min_scale_mtof, (int) (0.7*FRACUNIT));
   if (scale_mtof > max_scale_mtof) scale_mtof = min_scale_mtof;
   scale_ftom = FixedDiv(FRACUNIT, scale_mtof);
+  AM_initRamps();
+  if (!amlines) AM_initLines();
 }
 
 static boolean stopped = true;
@@ -888,13 +928,13 @@ void AM_drawFline(fline_t *fl, int color)
   switch(color)
     {
     case WALLCOLORS:
-      DrawWuLine(fl->a.x, fl->a.y, fl->b.x, fl->b.y, &antialias[0][0], 8, 3);
+      AM_drawWuLine(fl, amramp[0]);
       break;
     case FDWALLCOLORS:
-      DrawWuLine(fl->a.x, fl->a.y, fl->b.x, fl->b.y, &antialias[1][0], 8, 3);
+      AM_drawWuLine(fl, amramp[1]);
       break;
     case CDWALLCOLORS:
-      DrawWuLine(fl->a.x, fl->a.y, fl->b.x, fl->b.y, &antialias[2][0], 8, 3);
+      AM_drawWuLine(fl, amramp[2]);
       break;
     default:
       {
@@ -955,169 +995,175 @@ void AM_drawFline(fline_t *fl, int color)
     }
 }
 
-/* Wu antialiased line drawer.
- * (X0,Y0),(X1,Y1) = line to draw
- * BaseColor = color # of first color in block used for antialiasing, the
- *          100% intensity version of the drawing color
- * NumLevels = size of color block, with BaseColor+NumLevels-1 being the
- *          0% intensity version of the drawing color
- * IntensityBits = log base 2 of NumLevels; the # of bits used to describe
- *          the intensity of the drawing color. 2**IntensityBits==NumLevels
+/*
+ * Fills amramp and the fade tables for the window.  PUTDOT darkened a
+ *  pixel by a step for every 4 pixels it was closer than 32 to an edge
+ *  of the window, but never further than 6 steps for the pixels right
+ *  on the line, nor past the last color for the weighted ones.
  */
-void PUTDOT(short xx,short yy,byte *cc, byte *cm)
+void AM_initRamps(void)
 {
-  static int oldyy;
-  static int oldyyshifted;
-  byte *oldcc=cc;
-  
-  if(xx < 32)
-    cc += 7-(xx>>2);
-  else if(xx > (finit_width - 32))
-    cc += 7-((finit_width-xx) >> 2);
-  /*	if(cc==oldcc) //make sure that we don't double fade the corners. */
-  /*	{ */
-  if(yy < 32)
-    cc += 7-(yy>>2);
-  else if(yy > (finit_height - 32))
-    cc += 7-((finit_height-yy) >> 2);
-  /*	} */
-  if(cc > cm && cm != NULL)
-    {
-      cc = cm;
-    }
-  else if(cc > oldcc+6) /* don't let the color escape from the fade table... */
+  int i, w, f;
+  
+  for (i=0;i<NUMALIAS;i++)
+    for (w=0;w<=AMSOLID;w++)
+      for (f=0;f<AMFADES;f++)
+	{
+	  if (w == AMSOLID)
+	    amramp[i][w][f] = antialias[i][f > 6 ? 6 : f];
+	  else if (w+f > 7)
+	    amramp[i][w][f] = antialias[i][7];
+	  else
+	    amramp[i][w][f] = antialias[i][f > 6 ? w+6 : w+f];
+	}
+  
+  for (i=0;i<f_w;i++)
     {
-      cc=oldcc+6;
+      if (i < 32) amxfade[i] = 7-(i>>2);
+      else if (i > finit_width-32) amxfade[i] = 7-((finit_width-i)>>2);
+      else amxfade[i] = 0;
     }
-  if(yy == oldyy+1)
+  for (i=0;i<=f_h;i++)
     {
-      oldyy++;
-      oldyyshifted += screenwidth;
+      if (i < 32) amyfade[i] = 7-(i>>2);
+      else if (i > finit_height-32) amyfade[i] = 7-((finit_height-i)>>2);
+      else amyfade[i] = 0;
     }
-  else if(yy == oldyy-1)
+}
+
+/*
+ * Draws the pixels x0 to x1 of a row in the solid color of a ramp.  The
+ *  middle of the window doesn't fade, so most of it is one memset.
+ */
+static void AM_drawSpan(byte *row, int x0, int x1, byte *solid, int yfade)
+{
+  while (x0 <= x1 && amxfade[x0])
     {
-      oldyy--;
-      oldyyshifted -= screenwidth;
+      row[x0] = solid[amxfade[x0]+yfade];
+      x0++;
     }
-  else if(yy != oldyy)
+  while (x1 >= x0 && amxfade[x1])
     {
-      oldyy = yy;
-      oldyyshifted = yy*screenwidth;
+      row[x1] = solid[amxfade[x1]+yfade];
+      x1--;
     }
-  fb[oldyyshifted+xx] = *(cc);
-  /* 	fb[(yy)*f_w+(xx)]=*(cc); */
+  if (x0 <= x1)
+    memset(row+x0, solid[yfade], x1-x0+1);
 }
 
-void DrawWuLine(int X0, int Y0, int X1, int Y1, byte *BaseColor,
-		int NumLevels, unsigned short IntensityBits)
+/*
+ * Wu antialiased line drawer, for a line already clipped to the window.
+ *  Every step along the major axis draws the pixel on the line and its
+ *  neighbour on the minor axis, weighted by how close the line passes
+ *  to each; the ends, and horizontal, vertical and diagonal lines, go
+ *  right through the pixel centers and need no weighting.  The pixels
+ *  are written through a pointer that follows the line, their colors
+ *  come out of the ramp.
+ */
+static void AM_drawWuLine(fline_t *fl, byte (*ramp)[AMFADES])
 {
-  unsigned short IntensityShift, ErrorAdj, ErrorAcc;
-  unsigned short ErrorAccTemp, Weighting, WeightingComplementMask;
-  short DeltaX, DeltaY, Temp, XDir;
+  int x0, y0, x1, y1;
+  int dx, dy, xdir, tmp;
+  unsigned erroracc, erroradj;
+  int weight, xfade;
+  byte *solid = ramp[AMSOLID];
+  byte *dest;
   
   /* Make sure the line runs top to bottom */
-  if (Y0 > Y1) {
-    Temp = Y0; Y0 = Y1; Y1 = Temp;
-    Temp = X0; X0 = X1; X1 = Temp;
-  }
-  /* Draw the initial pixel, which is always exactly intersected by
-     the line and so needs no weighting */
-  PUTDOT(X0, Y0, &BaseColor[0], NULL);
+  x0 = fl->a.x; y0 = fl->a.y;
+  x1 = fl->b.x; y1 = fl->b.y;
+  if (y0 > y1)
+    {
+      tmp = y0; y0 = y1; y1 = tmp;
+      tmp = x0; x0 = x1; x1 = tmp;
+    }
+  dy = y1 - y0;
+  if ((dx = x1 - x0) >= 0)
+    xdir = 1;
+  else
+    {
+      xdir = -1;
+      dx = -dx;
+    }
+  dest = fb + y0*screenwidth;
   
-  if ((DeltaX = X1 - X0) >= 0) {
-    XDir = 1;
-  } else {
-    XDir = -1;
-    DeltaX = -DeltaX; /* make DeltaX positive */
-  }
-  /* Special-case horizontal, vertical, and diagonal lines, which
-     require no weighting because they go right through the center of
-     every pixel */
-  if ((DeltaY = Y1 - Y0) == 0) {
-    /* Horizontal line */
-    while (DeltaX-- != 0) {
-      X0 += XDir;
-      PUTDOT(X0, Y0, &BaseColor[0], NULL);
+  if (!dy)
+    {
+      /* Horizontal line */
+      if (x0 < x1) AM_drawSpan(dest, x0, x1, solid, amyfade[y0]);
+      else AM_drawSpan(dest, x1, x0, solid, amyfade[y0]);
+      return;
     }
-    return;
-  }
-  if (DeltaX == 0) {
-    /* Vertical line */
-    do {
-      Y0++;
-      PUTDOT(X0, Y0, &BaseColor[0], NULL);
-    } while (--DeltaY != 0);
-    return;
-  }
-  /* diagonal line. */
-  if (DeltaX == DeltaY) {
-    do {
-      X0 += XDir;
-      Y0++;
-      PUTDOT(X0, Y0, &BaseColor[0], NULL);
-    } while (--DeltaY != 0);
-    return;
-  }
-  /* Line is not horizontal, diagonal, or vertical */
-  ErrorAcc = 0;  /* initialize the line error accumulator to 0 */
-  /* # of bits by which to shift ErrorAcc to get intensity level */
-  IntensityShift = 16 - IntensityBits;
-  /* Mask used to flip all bits in an intensity weighting, producing the
-     result (1 - intensity weighting) */
-  WeightingComplementMask = NumLevels - 1;
-  /* Is this an X-major or Y-major line? */
-  if (DeltaY > DeltaX) {
-    /* Y-major line; calculate 16-bit fixed-point fractional part of a
-       pixel that X advances each time Y advances 1 pixel, truncating the
-       result so that we won't overrun the endpoint along the X axis */
-    ErrorAdj = ((unsigned long) DeltaX << 16) / (unsigned long) DeltaY;
-    /* Draw all pixels other than the first and last */
-    while (--DeltaY) {
-      ErrorAccTemp = ErrorAcc;   /* remember currrent accumulated error */
-      ErrorAcc += ErrorAdj;      /* calculate error for next pixel */
-      if (ErrorAcc <= ErrorAccTemp) {
-	/* The error accumulator turned over, so advance the X coord */
-	X0 += XDir;
-      }
-      Y0++; /* Y-major, so always advance Y */
-      /* The IntensityBits most significant bits of ErrorAcc give us the
-	 intensity weighting for this pixel, and the complement of the
-	 weighting for the paired pixel */
-      Weighting = ErrorAcc >> IntensityShift;
-      PUTDOT(X0, Y0, &BaseColor[Weighting], &BaseColor[7]);
-      PUTDOT(X0 + XDir, Y0,
-	     &BaseColor[(Weighting ^ WeightingComplementMask)], &BaseColor[7]);
+  
+  dest += x0;
+  *dest = solid[amxfade[x0]+amyfade[y0]];
+  if (!dx)
+    {
+      /* Vertical line */
+      xfade = amxfade[x0];
+      do
+	{
+	  dest += screenwidth;
+	  *dest = solid[xfade+amyfade[++y0]];
+	} while (--dy);
+      return;
     }
-    /* Draw the final pixel, which is always exactly intersected by the line
-       and so needs no weighting */
-    PUTDOT(X1, Y1, &BaseColor[0], NULL);
-    return;
-  }
-  /* It's an X-major line; calculate 16-bit fixed-point fractional part of a
-     pixel that Y advances each time X advances 1 pixel, truncating the
-     result to avoid overrunning the endpoint along the X axis */
-  ErrorAdj = ((unsigned long) DeltaY << 16) / (unsigned long) DeltaX;
-  /* Draw all pixels other than the first and last */
-  while (--DeltaX) {
-    ErrorAccTemp = ErrorAcc;   /* remember currrent accumulated error */
-    ErrorAcc += ErrorAdj;      /* calculate error for next pixel */
-    if (ErrorAcc <= ErrorAccTemp) {
-      /* The error accumulator turned over, so advance the Y coord */
-      Y0++;
+  if (dx == dy)
+    {
+      /* Diagonal line */
+      do
+	{
+	  x0 += xdir;
+	  dest += screenwidth+xdir;
+	  *dest = solid[amxfade[x0]+amyfade[++y0]];
+	} while (--dy);
+      return;
     }
-    X0 += XDir; /* X-major, so always advance X */
-    /* The IntensityBits most significant bits of ErrorAcc give us the
-       intensity weighting for this pixel, and the complement of the
-       weighting for the paired pixel */
-    Weighting = ErrorAcc >> IntensityShift;
-    PUTDOT(X0, Y0, &BaseColor[Weighting], &BaseColor[7]);
-    PUTDOT(X0, Y0 + 1,
-	   &BaseColor[(Weighting ^ WeightingComplementMask)], &BaseColor[7]);
-    
-  }
-  /* Draw the final pixel, which is always exactly intersected by the line
-     and so needs no weighting */
-  PUTDOT(X1, Y1, &BaseColor[0], NULL);
+  
+  /* The top 3 bits of the error are the weight of the second pixel */
+  erroracc = 0;
+  if (dy > dx)
+    {
+      /* Y-major line; x advances when the 16 bit error turns over */
+      erroradj = (dx<<16)/dy;
+      while (--dy)
+	{
+	  erroracc += erroradj;
+	  if (erroracc > 0xffff)
+	    {
+	      erroracc &= 0xffff;
+	      x0 += xdir;
+	      dest += xdir;
+	    }
+	  dest += screenwidth;
+	  y0++;
+	  weight = erroracc >> 13;
+	  dest[0] = ramp[weight][amxfade[x0]+amyfade[y0]];
+	  dest[xdir] = ramp[weight^7][amxfade[x0+xdir]+amyfade[y0]];
+	}
+    }
+  else
+    {
+      /* X-major line; y advances when the 16 bit error turns over */
+      erroradj = (dy<<16)/dx;
+      while (--dx)
+	{
+	  erroracc += erroradj;
+	  if (erroracc > 0xffff)
+	    {
+	      erroracc &= 0xffff;
+	      y0++;
+	      dest += screenwidth;
+	    }
+	  x0 += xdir;
+	  dest += xdir;
+	  weight = erroracc >> 13;
+	  xfade = amxfade[x0];
+	  dest[0] = ramp[weight][xfade+amyfade[y0]];
+	  dest[screenwidth] = ramp[weight^7][xfade+amyfade[y0+1]];
+	}
+    }
+  fb[y1*screenwidth+x1] = solid[amxfade[x1]+amyfade[y1]];
 }
 
 void AM_drawMline(mline_t *ml, int color)
@@ -1170,69 +1216,126 @@ void AM_drawGrid(int color)
     }
 }
 
-void AM_drawWalls(void)
+/*
+ * Builds amlines from the lines of the level.  The lists have the
+ *  level's tag, so they go with it and are built again for the next.
+ */
+void AM_initLines(void)
 {
   int i;
-  static mline_t l;
   
+  amlines = Z_Malloc(numlines*sizeof(*amlines), PU_LEVEL, &amlines);
+  amvisible = Z_Malloc(((numlines+31)>>5)*sizeof(*amvisible), PU_LEVEL,
+		       &amvisible);
+  amdrawn = Z_Malloc(numlines*sizeof(*amdrawn), PU_LEVEL, &amdrawn);
   for (i=0;i<numlines;i++)
     {
-      l.a.x = lines[i].v1->x;
-      l.a.y = lines[i].v1->y;
-      l.b.x = lines[i].v2->x;
-      l.b.y = lines[i].v2->y;
-      if (cheating || (lines[i].flags & ML_MAPPED))
+      amlines[i].ml.a.x = lines[i].v1->x;
+      amlines[i].ml.a.y = lines[i].v1->y;
+      amlines[i].ml.b.x = lines[i].v2->x;
+      amlines[i].ml.b.y = lines[i].v2->y;
+      amlines[i].line = &lines[i];
+      amlines[i].color = -1;
+    }
+  amframevalid = false;
+}
+
+/* The color a wall is drawn in, -1 if it isn't drawn */
+
+int AM_wallColor(line_t *line)
+{
+  if (cheating || (line->flags & ML_MAPPED))
+    {
+      if ((line->flags & LINE_NEVERSEE) && !cheating)
+	return -1;
+      if (!line->backsector)
+	return WALLCOLORS+lightlev;
+      if (line->special == 39) /* teleporters */
+	return WALLCOLORS+WALLRANGE/2;
+      if (line->flags & ML_SECRET) /* secret door */
+	return cheating ? 0 : WALLCOLORS+lightlev;
+      if (line->special > 25 && line->special < 35)
 	{
-	  if ((lines[i].flags & LINE_NEVERSEE) && !cheating)
-	    continue;
-	  if (!lines[i].backsector)
+	  switch(line->special)
 	    {
-	      AM_drawMline(&l, WALLCOLORS+lightlev);
-	    } else {
-	      if (lines[i].special == 39)
-		{ /* teleporters */
-		  AM_drawMline(&l, WALLCOLORS+WALLRANGE/2);
-		} else if (lines[i].flags & ML_SECRET) /* secret door */
-		  {
-		    if (cheating) AM_drawMline(&l, 0);
-		    else AM_drawMline(&l, WALLCOLORS+lightlev);
-		  }
-	      else if(lines[i].special > 25 && lines[i].special < 35)
-		{
-		  switch(lines[i].special)
-		    {
-		    case 26:
-		    case 32:
-		      AM_drawMline(&l, BLUEKEY);
-		      break;
-		    case 27:
-		    case 34:
-		      AM_drawMline(&l, YELLOWKEY);
-		      break;
-		    case 28:
-		    case 33:
-		      AM_drawMline(&l, GREENKEY);
-		      break;
-		    default:
-		      break;
-		    }
-		}
-	      else if (lines[i].backsector->floorheight
-		       != lines[i].frontsector->floorheight) {
-		AM_drawMline(&l, FDWALLCOLORS + lightlev); /* floor level change */
-	      } else if (lines[i].backsector->ceilingheight
-			 != lines[i].frontsector->ceilingheight) {
-		AM_drawMline(&l, CDWALLCOLORS+lightlev); /* ceiling level change */
-	      } else if (cheating) {
-		AM_drawMline(&l, TSWALLCOLORS+lightlev);
-	      }
+	    case 26:
+	    case 32:
+	      return BLUEKEY;
+	    case 27:
+	    case 34:
+	      return YELLOWKEY;
+	    case 28:
+	    case 33:
+	      return GREENKEY;
+	    default:
+	      return -1;
 	    }
-	} else if (plr->powers[pw_allmap])
+	}
+      if (line->backsector->floorheight != line->frontsector->floorheight)
+	return FDWALLCOLORS+lightlev; /* floor level change */
+      if (line->backsector->ceilingheight != line->frontsector->ceilingheight)
+	return CDWALLCOLORS+lightlev; /* ceiling level change */
+      if (cheating)
+	return TSWALLCOLORS+lightlev;
+      return -1;
+    }
+  if (plr->powers[pw_allmap] && !(line->flags & LINE_NEVERSEE))
+    return GRAYS+3;
+  return -1;
+}
+
+/*
+ * Lists the walls to draw: those in the blocks of the blockmap that the
+ *  window covers, in line order so they overlap as they always did.
+ *  Returns false if one of them changed color since the last frame.
+ */
+boolean AM_cullWalls(void)
+{
+  int x, y, x1, y1;
+  int i, j;
+  int color;
+  unsigned bits;
+  short *list;
+  boolean same = true;
+  
+  if (!amlines) AM_initLines();
+  
+  memset(amvisible, 0, ((numlines+31)>>5)*sizeof(*amvisible));
+  x1 = (m_x2-bmaporgx)>>MAPBLOCKSHIFT;
+  y1 = (m_y2-bmaporgy)>>MAPBLOCKSHIFT;
+  if (x1 >= bmapwidth) x1 = bmapwidth-1;
+  if (y1 >= bmapheight) y1 = bmapheight-1;
+  for (y=(m_y-bmaporgy)>>MAPBLOCKSHIFT, y=y<0?0:y; y<=y1; y++)
+    for (x=(m_x-bmaporgx)>>MAPBLOCKSHIFT, x=x<0?0:x; x<=x1; x++)
+      for (list=blockmaplump+blockmap[y*bmapwidth+x]; *list != -1; list++)
+	amvisible[*list>>5] |= 1u<<(*list&31);
+  
+  numamdrawn = 0;
+  for (i=0;i<numlines;i+=32)
+    for (j=i, bits=amvisible[i>>5]; bits; j++, bits>>=1)
+      {
+	if (!(bits & 1)) continue;
+	color = AM_wallColor(amlines[j].line);
+	if (color != amlines[j].color)
 	  {
-	    if (!(lines[i].flags & LINE_NEVERSEE)) AM_drawMline(&l, GRAYS+3);
+	    amlines[j].color = color;
+	    same = false;
 	  }
-    }
+	if (color != -1) amdrawn[numamdrawn++] = j;
+      }
+  return same;
+}
+
+void AM_drawWalls(void)
+{
+  int i;
+  amline_t *l;
   
+  for (i=0;i<numamdrawn;i++)
+    {
+      l = &amlines[amdrawn[i]];
+      AM_drawMline(&l->ml, l->color);
+    }
 }
 
 void AM_rotate(fixed_t *x, fixed_t *y, angle_t a)
@@ -1386,9 +1489,27 @@ void AM_Drawer(void)
   if (!automapactive) return;
   
   /* UpdateState |= I_FULLSCRN; */
-  AM_clearFB(BACKGROUND);
-  if (grid) AM_drawGrid(GRIDCOLORS);
-  AM_drawWalls();
+  /* the map under the players only changes when the window or a wall does */
+  if (!AM_cullWalls() || !amframevalid || !amframe
+      || amframe_x != m_x || amframe_y != m_y
+      || amframe_x2 != m_x2 || amframe_y2 != m_y2
+      || amframe_scale != scale_mtof || amframe_grid != grid)
+    {
+      AM_clearFB(BACKGROUND);
+      if (grid) AM_drawGrid(GRIDCOLORS);
+      AM_drawWalls();
+      if (!amframe) Z_Malloc(f_w*f_h, PU_CACHE, &amframe);
+      memcpy(amframe, fb, f_w*f_h);
+      amframevalid = true;
+      amframe_x = m_x;
+      amframe_y = m_y;
+      amframe_x2 = m_x2;
+      amframe_y2 = m_y2;
+      amframe_scale = scale_mtof;
+      amframe_grid = grid;
+    } else {
+      memcpy(fb, amframe, f_w*f_h);
+    }
   AM_drawPlayers();
   if (cheating==2) AM_drawThings(THINGCOLORS, THINGRANGE);
   /*   AM_drawCrosshair(XHAIRCOLORS);   */
@@ -1403,6 +1524,6 @@ void AM_Drawer(void)
       MN_DrTextA(LevelNames[(gameepisode-1)*9+gamemap-1], 20, Y_BOTTOM+145);
     }
   /*   I_Update();   */
-  /*   V_MarkRect(f_x, f_y, f_w, f_h);   */
+  V_MarkRect(f_x, f_y, f_w, f_h);
 }
 
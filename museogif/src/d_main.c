@@ -25,6 +25,13 @@ boolean debugmode;			/* checkparm of -debug */
 boolean ravpic;				/* checkparm of -ravpic */
 boolean cdrom;				/* true if cd-rom mode active */
 boolean singletics;			/* debug flag to cancel adaptiveness */
+boolean nodraw;				/* checkparm of -nodraw / -fastdemo */
+int drawevery;				/* -nodraw <n>: draw every nth tic */
+boolean drawfinal;			/* checkparm of -drawfinal */
+char *drawfinalname;			/* -drawfinal <file>, NULL for HRTICnn.pcx */
+boolean novideo;			/* nodraw without drawevery */
+boolean wavout;				/* checkparm of -wavout */
+boolean uncapped;			/* checkparm of -uncapped */
 boolean noartiskip;			/* whether shift-enter skips an artifact */
 
 skill_t startskill;
@@ -242,7 +249,10 @@ void D_Display(void)
   NetUpdate();
   
   /* Flush buffered stuff to screen */
-  I_FinishUpdate();
+  if(!novideo)
+    {
+      I_FinishUpdate();
+    }
 
 }
 
@@ -262,12 +272,40 @@ void D_DoomLoop(void)
       debugfile = fopen(filename,"w");
     }
 
-  I_InitGraphics();
-  
-  I_SetPalette (W_CacheLumpName ("PLAYPAL",PU_CACHE));
+  if(!novideo)
+    {
+      I_InitGraphics();
+      I_SetPalette (W_CacheLumpName ("PLAYPAL",PU_CACHE));
+    }
+  else if(drawfinal)
+    { /* Headless, the last frame is only drawn for the screenshot */
+      screen = malloc(screenwidth*screenheight);
+      if(!screen)
+	{
+	  I_Error("D_DoomLoop: no memory for the screen");
+	}
+    }
   
   while(1)
     {
+      if(nodraw)
+	{ /* Demo playback flat out: no input, sound or pacing */
+	  if (advancedemo)
+	    D_DoAdvanceDemo ();
+	  G_Ticker();
+	  gametic++;
+	  maketic++;
+	  if(wavout)
+	    {
+	      S_UpdateSounds(players[consoleplayer].mo);
+	    }
+	  if(drawevery && !(gametic%drawevery))
+	    {
+	      D_Display();
+	    }
+	  continue;
+	}
+      
       /* Frame syncronous IO operations */
       I_StartFrame();
       
@@ -282,7 +320,6 @@ void D_DoomLoop(void)
 	  G_Ticker();
 	  gametic++;
 	  maketic++;
-	  printf("SINGLE\n");
 	}
       else
 	{
@@ -291,8 +328,14 @@ void D_DoomLoop(void)
 	}
       
       /* Move positional sounds */
+      D_StartPrediction();
       S_UpdateSounds(players[consoleplayer].mo);
-      D_Display();
+      if(!novideo)
+	{
+	  interpfrac = singletics ? FRACUNIT : D_TicFrac();
+	  D_Display();
+	}
+      D_EndPrediction();
     }
 }
 
@@ -374,7 +417,7 @@ void D_DoAdvanceDemo (void)
       pagetic = 210;
       gamestate = GS_DEMOSCREEN;
       pagename = "TITLE";
-      
+      S_StartSong(mus_titl, false);
       break;
     case 1:
       pagetic = 140;
@@ -606,8 +649,55 @@ void D_DoomMain(void)
   printf("========================================================\n");
   /* getchar(); */
 
+  /* -fastdemo <demo> is -timedemo <demo> -nodraw */
+  p = M_CheckParm("-nodraw");
+  if(p || M_CheckParm("-fastdemo"))
+    {
+      nodraw = true;
+      if(p && p < myargc-1)
+	{
+	  drawevery = atoi(myargv[p+1]);
+	}
+      novideo = !drawevery;
+    }
+  p = M_CheckParm("-drawfinal");
+  if(p)
+    {
+      drawfinal = true;
+      if(p < myargc-1 && myargv[p+1][0] != '-')
+	{
+	  drawfinalname = myargv[p+1];
+	}
+    }
+
+  /*
+   * -uncapped: TryRunTics doesn't wait for the next tic, but lets the
+   *  loop draw as many frames as it can, the world moved on between the
+   *  last two tics by how far the clock is into the next
+   */
+  uncapped = M_CheckParm("-uncapped");
+
+  /* -novideo: play normally, but headless (net test nodes) */
+  if(M_CheckParm("-novideo"))
+    {
+      novideo = true;
+    }
+
+  /*
+   * -wavout <file> renders the sound to a file tic by tic, so the
+   *  loop has to take tics one at a time, however fast it runs.
+   */
+  if(M_CheckParm("-wavout"))
+    {
+      wavout = true;
+      singletics = true;
+    }
+  
   /* calls SVGALib init and revokes root rights, dummy for other displays */
-  InitGraphLib();
+  if(!novideo)
+    {
+      InitGraphLib();
+    }
   
   /* Gets the home-directory of the user */
   I_GetHomeDirectory();
@@ -708,10 +798,13 @@ void D_DoomMain(void)
     {
       p = M_CheckParm("-timedemo");
     }
+  if(!p)
+    {
+      p = M_CheckParm("-fastdemo");
+    }
   if (p && p < myargc-1)
     {
-      sprintf(file, "%s.lmp", myargv[p+1]);
-      D_AddFile(file);
+      /* G_OpenDemoRead streams <name>.lmp itself */
       printf("Playing demo %s.lmp.\n", myargv[p+1]);
     }
   
@@ -814,7 +907,7 @@ void D_DoomMain(void)
   D_CheckNetGame();
   
   printf("S_Init: Setting up sound.\n");
-  S_Init( snd_SfxVolume, 10 ); 
+  S_Init( snd_SfxVolume, snd_MusicVolume ); 
  
   printf("SB_Init: Loading patches.\n");
   SB_Init();
@@ -823,8 +916,15 @@ void D_DoomMain(void)
    * start the apropriate game based on parms
    */
   
+  G_InitStateHash();
   D_CheckRecordFrom();
   
+  p = M_CheckParm("-autosave");
+  if(p)
+    {
+      G_InitAutoSave(p < myargc-1 ? atoi(myargv[p+1]) : 0);
+    }
+  
   p = M_CheckParm("-record");
   if(p && p < myargc-1)
     {
@@ -841,6 +941,10 @@ void D_DoomMain(void)
     }
   
   p = M_CheckParm("-timedemo");
+  if(!p)
+    {
+      p = M_CheckParm("-fastdemo");
+    }
   if(p && p < myargc-1)
     {
       G_TimeDemo(myargv[p+1]);
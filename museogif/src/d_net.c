@@ -4,20 +4,12 @@
  * This version has the fixed ticdup code
  */
 
-#ifdef HAVE_USLEEP
-#include <unistd.h>
-#endif
 #include "doomdef.h"
-
-#define NCMD_EXIT               0x80000000
-#define NCMD_RETRANSMIT         0x40000000
-#define NCMD_SETUP              0x20000000
-#define NCMD_KILL               0x10000000      /* kill game */
-#define NCMD_CHECKSUM           0x0fffffff
-
+#include "p_local.h"
 
 doomcom_t               *doomcom;
-doomdata_t              *netbuffer;             /* points inside doomcom */
+doomdata_t              *netbuffer;             /* points to netpacket */
+static doomdata_t       netpacket;
 
 
 /*
@@ -31,20 +23,44 @@ doomdata_t              *netbuffer;             /* points inside doomcom */
   
   a gametic cannot be run until nettics[] > gametic for all players
   
+  Every packet acknowledges the tics the sender has from the receiver:
+  all of them below ack, plus the ones flagged in sack.  A tic goes out
+  in every packet until it is acknowledged, skipping the ones sack says
+  have arrived, so a lost packet costs the receiver one tic of waiting
+  instead of a timeout.  The delta coding makes the repeats cheap.  Tics
+  that arrive after a gap are kept until it is filled.
+  
+  With -server the game goes through hereticd instead: every player
+  sends its tics to relaynode only and gets back relay packets with the
+  tics of all the others together, each tic sent once the server has it
+  from everyone.  The players' nodes are still there for nettics[] and
+  nodeack[], copied from the relay node's as its packets come in.  A
+  player the server has dropped is missing from the relayed tics, and
+  leaves the game when the first of them is run.
+  
   ==============================================================================
 */
 
-#define RESENDCOUNT     10
 #define PL_DRONE        0x80                    /* bit flag in doomdata->player */
 
+/* tics a player may build ahead, when -netwindow doesn't say */
+#define NETWINDOW       32
+
+/* most tics repeated in one packet, bounding what a long outage costs
+   every packet after it */
+#define NETMAXTICS      64
+
 ticcmd_t        localcmds[BACKUPTICS];
 
 ticcmd_t        netcmds[MAXPLAYERS][BACKUPTICS];
 int             nettics[MAXNETNODES];
 boolean         nodeingame[MAXNETNODES];        /* set false as nodes leave game */
-boolean         remoteresend[MAXNETNODES];      /* set when local needs tics */
-int             resendto[MAXNETNODES];          /* set when remote needs tics */
-int             resendcount[MAXNETNODES];
+int             resendto[MAXNETNODES];          /* first tic not yet sent to the node */
+byte            netgot[MAXNETNODES][BACKUPTICS];/* tics past nettics[] already in */
+
+/* what each node has acknowledged of our tics */
+int             nodeack[MAXNETNODES];
+unsigned        nodesack[MAXNETNODES];
 
 int             nodeforplayer[MAXPLAYERS];
 
@@ -52,6 +68,35 @@ int             maketic;
 int             lastnettic, skiptics;
 int             ticdup;
 int             maxsend;                        /* BACKUPTICS/(2*ticdup)-1 */
+int             netwindow;                      /* -netwindow, up to BACKUPTICS */
+
+/*
+ * -netsoak <tics>: a test game for netsoak.c.  The console player
+ *  plays made up input, and at gametic <tics> the node stops, waits
+ *  for its tics to be acknowledged, prints what the network did and
+ *  quits without a word to the others, which may still be behind.
+ */
+int             netsoak;
+static unsigned soakseed;
+
+/*
+ * -predict: frames show the console player moved on by the tics it
+ *  has made that the game hasn't run yet, and TryRunTics stops waiting
+ *  for the others as soon as a new one is made.
+ */
+boolean         netpredict;
+
+/* -uncapped: the I_GetTime/ticdup the last tics were run in */
+static int      rantime;
+
+/* -server: the node of hereticd, that all tics go through, or -1 */
+int             relaynode = -1;
+static byte     relaymask[BACKUPTICS];  /* the players in a relayed tic */
+
+/* for the netstats: line */
+static int      packetssent, bytessent, packetsgot, packetsbad;
+static int      ticssent, ticsresent;
+static int      stallms, stallmax, stalls;
 
 void D_ProcessEvents (void);
 void G_BuildTiccmd (ticcmd_t *cmd);
@@ -61,44 +106,21 @@ boolean         reboundpacket;
 doomdata_t      reboundstore;
 
 
-unsigned long NetbufferSize (void)
-{
-  return (unsigned long)&(((doomdata_t *)0)->cmds[netbuffer->numtics]);
-}
-
-unsigned NetbufferChecksum (void)
-{
-  unsigned int  c;
-  int           i,l;
-  
-  c = 0x1234567;
-
-#if defined(NeXT)
-  return 0;                       /* byte order problems */
-#endif
-  
-  l = (int)((NetbufferSize () - (unsigned long)&(((doomdata_t *)0)->retransmitfrom))/4);
-  for (i=0 ; i<l ; i++)
-    c += ((unsigned *)&netbuffer->retransmitfrom)[i] * (i+1);
-  
-  return c & NCMD_CHECKSUM;
-}
-
+/*
+ * Tic numbers go out as their low 16 bits;
+ *  the rest is taken from maketic, which they are near.
+ */
 int ExpandTics (int low)
 {
   int     delta;
   
-  delta = low - (maketic&0xff);
-  
-  if (delta >= -64 && delta <= 64)
-    return (maketic&~0xff) + low;
-  if (delta > 64)
-    return (maketic&~0xff) - 256 + low;
-  if (delta < -64)
-    return (maketic&~0xff) + 256 + low;
+  delta = low - (maketic&0xffff);
   
-  I_Error ("ExpandTics: strange value %i at maketic %i",low,maketic);
-  return 0;
+  if (delta >= -0x8000 && delta < 0x8000)
+    return (maketic&~0xffff) + low;
+  if (delta >= 0x8000)
+    return (maketic&~0xffff) - 0x10000 + low;
+  return (maketic&~0xffff) + 0x10000 + low;
 }
 
 
@@ -115,7 +137,7 @@ int ExpandTics (int low)
 
 void HSendPacket (int node, int flags)
 {
-  netbuffer->checksum = NetbufferChecksum () | flags;
+  netbuffer->flags = flags;
   
   /* if (!node) */
   if (node == doomcom->consoleplayer)
@@ -133,26 +155,43 @@ void HSendPacket (int node, int flags)
   
   doomcom->command = CMD_SEND;
   doomcom->remotenode = node;
-  doomcom->datalength = NetbufferSize ();
+  doomcom->datalength = NetEncode (netbuffer, doomcom->data);
+  packetssent++;
+  bytessent += doomcom->datalength;
   
   if (debugfile)
     {
       int             i;
-      int             realretrans;
-      if (netbuffer->checksum & NCMD_RETRANSMIT)
-	realretrans = ExpandTics (netbuffer->retransmitfrom);
-      else
-	realretrans = -1;
-      fprintf (debugfile,"send (%i + %i, R %i) [%i] "
-	       ,ExpandTics(netbuffer->starttic),netbuffer->numtics, realretrans, doomcom->datalength);
+      fprintf (debugfile,"send (%i + %i, A %i/%x) [%i] "
+	       ,ExpandTics(netbuffer->starttic),netbuffer->numtics
+	       ,ExpandTics(netbuffer->ack),netbuffer->sack,doomcom->datalength);
       for (i=0 ; i<doomcom->datalength ; i++)
-	fprintf (debugfile,"%i ",((byte *)netbuffer)[i]);
+	fprintf (debugfile,"%i ",doomcom->data[i]);
       fprintf (debugfile,"\n");
     }
   
   I_NetCmd ();
 }
 
+/*
+  ==============
+  =
+  = HFlushPackets
+  =
+  = Sends the packets the driver may still hold back from HSendPacket
+  =
+  ==============
+*/
+
+void HFlushPackets (void)
+{
+  if (!netgame || demoplayback)
+    return;
+  
+  doomcom->command = CMD_FLUSH;
+  I_NetCmd ();
+}
+
 /*
   ==============
   =
@@ -179,42 +218,34 @@ boolean HGetPacket (void)
   if (demoplayback)
     return false;
   
-  doomcom->command = CMD_GET;
-  I_NetCmd ();
-  if (doomcom->remotenode == -1)
-    return false;
-  
-  if (doomcom->datalength != (int)NetbufferSize ())
-    {
-      if (debugfile)
-	fprintf (debugfile,"bad packet length %i\n",doomcom->datalength);
-      return false;
-    }
-  
-  if (NetbufferChecksum () != (netbuffer->checksum&NCMD_CHECKSUM) )
+  /* a bad packet is skipped, not taken as the end of them */
+  while (1)
     {
+      doomcom->command = CMD_GET;
+      I_NetCmd ();
+      if (doomcom->remotenode == -1)
+	return false;
+      if (NetDecode (netbuffer, doomcom->data, doomcom->datalength))
+	break;
+      packetsbad++;
       if (debugfile)
-	fprintf (debugfile,"bad packet checksum\n");
-      return false;
+	fprintf (debugfile,"bad packet [%i]\n",doomcom->datalength);
     }
   
+  packetsgot++;
   if (debugfile)
     {
-      int     realretrans;
       int     i;
       
-      if (netbuffer->checksum & NCMD_SETUP)
+      if (netbuffer->flags & NCMD_SETUP)
 	fprintf (debugfile,"setup packet\n");
       else
 	{
-	  if (netbuffer->checksum & NCMD_RETRANSMIT)
-	    realretrans = ExpandTics (netbuffer->retransmitfrom);
-	  else
-	    realretrans = -1;
-	  fprintf (debugfile,"get %i = (%i + %i, R %i)[%i] ",doomcom->remotenode,
-		   ExpandTics(netbuffer->starttic),netbuffer->numtics, realretrans, doomcom->datalength);
+	  fprintf (debugfile,"get %i = (%i + %i, A %i/%x)[%i] ",doomcom->remotenode,
+		   ExpandTics(netbuffer->starttic),netbuffer->numtics,
+		   ExpandTics(netbuffer->ack),netbuffer->sack,doomcom->datalength);
 	  for (i=0 ; i<doomcom->datalength ; i++)
-	    fprintf (debugfile,"%i ",((byte *)netbuffer)[i]);
+	    fprintf (debugfile,"%i ",doomcom->data[i]);
 	  fprintf (debugfile,"\n");
 	}
     }
@@ -222,6 +253,84 @@ boolean HGetPacket (void)
 }
 
 
+/*
+  ===================
+  =
+  = NetAck
+  =
+  = Takes note of what node says it has of our tics
+  =
+  ===================
+*/
+
+void NetAck (int node, int ack, unsigned sack)
+{
+  if (ack < nodeack[node] || ack > resendto[node])
+    return;                     /* old news, or nonsense */
+  if (ack == nodeack[node])
+    {
+      nodesack[node] |= sack;
+      return;
+    }
+  nodeack[node] = ack;
+  nodesack[node] = sack;
+}
+
+
+/*
+  ===================
+  =
+  = NetBuildTics
+  =
+  = Fills netbuffer with the tics node is to get: all it has not
+  = acknowledged, oldest first
+  =
+  ===================
+*/
+
+void NetBuildTics (int node)
+{
+  int             first = -1;
+  int             tic;
+  int             slot;
+  int             n;
+  
+  /* what we have of node's */
+  netbuffer->ack = nettics[node];
+  netbuffer->sack = 0;
+  for (n=0 ; n<32 ; n++)
+    if (netgot[node][(nettics[node]+1+n)%BACKUPTICS])
+      netbuffer->sack |= 1u << n;
+  
+  memset (netbuffer->present, 0, sizeof(netbuffer->present));
+  netbuffer->numtics = 0;
+  for (tic = nodeack[node] ; tic < maketic ; tic++)
+    {
+      n = tic - nodeack[node] - 1;
+      if (n >= 0 && n < 32 && (nodesack[node] & (1u << n)))
+	continue;               /* it has that one */
+      if (first == -1)
+	first = tic;
+      else if (tic - first == NETMAXTICS)
+	break;
+      
+      slot = tic%BACKUPTICS;
+      netbuffer->present[(tic-first)>>3] |= 1 << ((tic-first)&7);
+      netbuffer->cmds[tic-first] = localcmds[slot];
+      netbuffer->numtics = tic-first+1;
+      if (node == doomcom->consoleplayer)
+	continue;
+      if (tic < resendto[node])
+	ticsresent++;
+      else
+	ticssent++;
+    }
+  netbuffer->starttic = first == -1 ? maketic : first;
+  if (tic > resendto[node])
+    resendto[node] = tic;
+}
+
+
 /*
   ===================
   =
@@ -232,41 +341,128 @@ boolean HGetPacket (void)
 
 char    exitmsg[80];
 
+static void PlayerLeft (int player)
+{
+  nodeingame[player] = false;
+  playeringame[player] = false;
+  strcpy (exitmsg, "PLAYER 1 LEFT THE GAME");
+  exitmsg[7] += player;
+  players[consoleplayer].message = exitmsg;
+  players[consoleplayer].messageTics = MESSAGETICS;
+}
+
+/*
+  ===================
+  =
+  = GetRelayPacket
+  =
+  = Takes the tics of a relay packet from hereticd
+  =
+  ===================
+*/
+
+static void GetRelayPacket (void)
+{
+  int             realstart;
+  int             tic;
+  int             slot;
+  int             i, j;
+  
+  NetAck (relaynode, ExpandTics (netbuffer->ack), netbuffer->sack);
+  
+  realstart = ExpandTics (netbuffer->starttic);
+  for (i=0 ; i<netbuffer->numtics ; i++)
+    {
+      if (!(netbuffer->present[i>>3] & (1 << (i&7))))
+	continue;
+      tic = realstart + i;
+      slot = tic%BACKUPTICS;
+      if (tic < nettics[relaynode]
+	  || tic - nettics[relaynode] >= BACKUPTICS
+	  || tic - gametic/ticdup >= BACKUPTICS
+	  || netgot[relaynode][slot])
+	continue;
+      for (j=0 ; j<MAXPLAYERS ; j++)
+	if (netbuffer->player & (1 << j))
+	  netcmds[j][slot] = netbuffer->cmds[i*MAXPLAYERS+j];
+      relaymask[slot] = netbuffer->player | 1 << consoleplayer;
+      netgot[relaynode][slot] = true;
+    }
+  
+  while (netgot[relaynode][nettics[relaynode]%BACKUPTICS])
+    {
+      netgot[relaynode][nettics[relaynode]%BACKUPTICS] = false;
+      nettics[relaynode]++;
+    }
+  
+  for (i=0 ; i<doomcom->numnodes ; i++)
+    if (i != consoleplayer)
+      {
+	nodeforplayer[i] = i;
+	nettics[i] = nettics[relaynode];
+	nodeack[i] = nodeack[relaynode];
+      }
+}
+
+/*
+  ===================
+  =
+  = RelayDrops
+  =
+  = Takes the players hereticd has dropped out before tic is run
+  =
+  ===================
+*/
+
+static void RelayDrops (int tic)
+{
+  int             i;
+  
+  for (i=0 ; i<MAXPLAYERS ; i++)
+    if (playeringame[i] && !(relaymask[tic%BACKUPTICS] & (1 << i)))
+      PlayerLeft (i);
+}
+
 void GetPackets (void)
 {
   int             netconsole;
   int             netnode;
-  ticcmd_t        *src, *dest;
-  int             realend;
   int             realstart;
+  int             tic;
+  int             i;
   
   while (HGetPacket ())
     {
-      if (netbuffer->checksum & NCMD_SETUP)
+      if (netbuffer->flags & NCMD_SETUP)
 	continue;               /* extra setup packet */
       
+      if (relaynode != -1 && doomcom->remotenode == relaynode)
+	{
+	  if (netbuffer->flags & NCMD_KILL)
+	    I_Error ("Dropped by the server");
+	  if (netbuffer->flags & NCMD_RELAY)
+	    GetRelayPacket ();
+	  continue;
+	}
+      
       netconsole = netbuffer->player & ~PL_DRONE;
       netnode = doomcom->remotenode;
+      if (netconsole >= MAXPLAYERS)
+	continue;
       /*
-       * to save bytes, only the low byte of tic numbers are sent
+       * to save bytes, only the low 16 bits of tic numbers are sent
        * Figure out what the rest of the bytes are
        */
       realstart = ExpandTics (netbuffer->starttic);
-      realend = (realstart+netbuffer->numtics);
       
       /*
        * check for exiting the game
        */
-      if (netbuffer->checksum & NCMD_EXIT)
+      if (netbuffer->flags & NCMD_EXIT)
 	{
 	  if (!nodeingame[netnode])
 	    continue;
-	  nodeingame[netnode] = false;
-	  playeringame[netconsole] = false;
-	  strcpy (exitmsg, "PLAYER 1 LEFT THE GAME");
-	  exitmsg[7] += netconsole;
-	  players[consoleplayer].message = exitmsg;
-          players[consoleplayer].messageTics = MESSAGETICS;
+	  PlayerLeft (netconsole);
 
 	  /*
 	   *			if (demorecording)
@@ -278,72 +474,172 @@ void GetPackets (void)
       /*
        * check for a remote game kill
        */
-      if (netbuffer->checksum & NCMD_KILL)
+      if (netbuffer->flags & NCMD_KILL)
 	I_Error ("Killed by network driver");
       
       nodeforplayer[netconsole] = netnode;
       
-      /*
-       * check for retransmit request
-       */
-      if ( resendcount[netnode] <= 0
-	   && (netbuffer->checksum & NCMD_RETRANSMIT) )
-	{
-	  resendto[netnode] = ExpandTics(netbuffer->retransmitfrom);
-	  if (debugfile)
-	    fprintf (debugfile,"retransmit from %i\n", resendto[netnode]);
-	  resendcount[netnode] = RESENDCOUNT;
-	}
-      else
-	resendcount[netnode]--;
+      NetAck (netnode, ExpandTics (netbuffer->ack), netbuffer->sack);
       
       /*
-       * check for out of order / duplicated packet
+       * update command store from the packet; tics past a gap are
+       * kept until the gap is filled
        */
-      if (realend == nettics[netnode])
-	continue;
-      
-      if (realend < nettics[netnode])
+      for (i=0 ; i<netbuffer->numtics ; i++)
 	{
-	  if (debugfile)
-	    fprintf (debugfile,"out of order packet (%i + %i)\n" ,realstart,netbuffer->numtics);
-	  continue;
+	  if (!(netbuffer->present[i>>3] & (1 << (i&7))))
+	    continue;
+	  tic = realstart + i;
+	  if (tic < nettics[netnode]
+	      || tic - nettics[netnode] >= BACKUPTICS
+	      || tic - gametic/ticdup >= BACKUPTICS
+	      || netgot[netnode][tic%BACKUPTICS])
+	    continue;           /* duplicate, or too far ahead */
+	  netcmds[netconsole][tic%BACKUPTICS] = netbuffer->cmds[i];
+	  netgot[netnode][tic%BACKUPTICS] = true;
 	}
       
-      /*
-       * check for a missed packet
-       */
-      if (realstart > nettics[netnode])
+      while (netgot[netnode][nettics[netnode]%BACKUPTICS])
 	{
-	  /* stop processing until the other system resends the missed tics */
-	  if (debugfile)
-	    fprintf (debugfile,"missed tics from %i (%i - %i)\n", netnode, realstart, nettics[netnode]);
-	  remoteresend[netnode] = true;
-	  continue;
+	  netgot[netnode][nettics[netnode]%BACKUPTICS] = false;
+	  nettics[netnode]++;
 	}
-      
-      /*
-       * update command store from the packet
-       */
-      {
-	int             start;
-	
-	remoteresend[netnode] = false;
-	
-	start = nettics[netnode] - realstart;
-	src = &netbuffer->cmds[start];
-	
-	while (nettics[netnode] < realend)
-	  {
-	    dest = &netcmds[netconsole][nettics[netnode]%BACKUPTICS];
-	    nettics[netnode]++;
-	    *dest = *src;
-	    src++;
-	  }
-      }
     }  
 }
 
+/*
+  =============
+  =
+  = NetSoakCmd
+  =
+  = Replaces the movement in a -netsoak player's ticcmd with a wander:
+  = a new heading and speed every half second, firing now and then
+  =
+  =============
+*/
+
+void NetSoakCmd (ticcmd_t *cmd)
+{
+  static int      forward, side, turn;
+  
+  soakseed = soakseed*1103515245 + 12345;
+  if (maketic % (TICRATE/2) == 0)
+    {
+      forward = (int)(soakseed>>16)%101 - 50;
+      side = (int)(soakseed>>8)%41 - 20;
+      turn = soakseed & 1 ? 0 : (int)(soakseed>>4)%1281 - 640;
+    }
+  cmd->forwardmove = forward;
+  cmd->sidemove = side;
+  cmd->angleturn = turn;
+  if (!(soakseed>>24 & 7))
+    cmd->buttons |= BT_ATTACK;
+  if (players[consoleplayer].playerstate == PST_DEAD)
+    cmd->buttons |= BT_USE;             /* back in */
+}
+
+/*
+  =============
+  =
+  = D_StartPrediction
+  =
+  = Runs the console player's own tics past gametic, for a frame.
+  = D_EndPrediction takes them back before the next real tic.
+  =
+  =============
+*/
+
+void D_StartPrediction (void)
+{
+  player_t        *player = &players[consoleplayer];
+  int             tic;
+  int             i;
+  
+  if (!netpredict || !netgame || demoplayback || paused
+      || gamestate != GS_LEVEL || gameaction != ga_nothing
+      || player->playerstate != PST_LIVE || !player->mo)
+    return;
+  
+  P_StartPrediction (player);
+  for (tic = gametic/ticdup ; tic < maketic ; tic++)
+    for (i=0 ; i<ticdup ; i++)
+      P_PredictTic (&localcmds[tic%BACKUPTICS]);
+}
+
+void D_EndPrediction (void)
+{
+  P_EndPrediction ();
+}
+
+/*
+  =============
+  =
+  = D_TicFrac
+  =
+  = How far the clock is into the tic after the last one run, for an
+  = -uncapped frame to show the world that far from the tic before to
+  = the last.  FRACUNIT, the last tic as it is, if it wasn't run in this
+  = tic's time: the game is waiting for tics or running behind.
+  =
+  =============
+*/
+
+fixed_t D_TicFrac (void)
+{
+  fixed_t         frac;
+  int             tic;
+  
+  if (!uncapped)
+    return FRACUNIT;
+  tic = I_GetTimeFrac (&frac);
+  if (tic/ticdup != rantime || gametic/ticdup < maketic)
+    return FRACUNIT;
+  return ((tic%ticdup << FRACBITS) + frac) / ticdup;
+}
+
+/*
+  =============
+  =
+  = NetSoakEnd
+  =
+  = Called when a -netsoak game reaches its last tic.  Keeps the
+  = network going until every node has all our tics, and a second
+  = more so our last acks get through, then quits
+  =
+  =============
+*/
+
+void NetSoakEnd (void)
+{
+  int             stoptime;
+  int             ackedtime;
+  int             i;
+  
+  stoptime = I_GetTimeMS () + 10000;
+  ackedtime = -1;
+  while (I_GetTimeMS () < stoptime)
+    {
+      I_NetWait ();
+      NetUpdate ();
+      for (i=0 ; i<doomcom->numnodes ; i++)
+	if (nodeingame[i] && nodeack[i] < maketic)
+	  break;
+      if (i < doomcom->numnodes)
+	continue;
+      if (ackedtime == -1)
+	ackedtime = I_GetTimeMS ();
+      else if (I_GetTimeMS () - ackedtime >= 1000)
+	break;
+    }
+  
+  printf ("netstats: %i tics, %i packets sent, %i bytes, %i got, %i bad, "
+	  "%i tics sent, %i repeated, %i ms stalled in %i waits, "
+	  "longest %i ms%s\n", gametic, packetssent, bytessent, packetsgot
+	  , packetsbad, ticssent, ticsresent, stallms, stalls, stallmax
+	  , ackedtime == -1 ? ", not all acknowledged" : "");
+  I_Quit ();
+}
+
 /*
   =============
   =
@@ -360,9 +656,9 @@ void NetUpdate (void)
 {
   int             nowtime;
   int             newtics;
-  int             i,j;
-  int             realstart;
+  int             i;
   int             gameticdiv;
+  int             lowack;
   
   /*
    * check time
@@ -390,16 +686,26 @@ void NetUpdate (void)
   
   /*
    * build new ticcmds for console player
+   * as long as the tics nobody acknowledged yet are still held
    */
   gameticdiv = gametic/ticdup;
+  lowack = maketic;
+  for (i=0 ; i<doomcom->numnodes ; i++)
+    if (nodeingame[i] && nodeack[i] < lowack)
+      lowack = nodeack[i];
   for (i=0 ; i<newtics ; i++)
     {
       I_StartTic ();
       D_ProcessEvents ();
-      if (maketic - gameticdiv >= BACKUPTICS/2-1)
+      if (maketic - gameticdiv >= netwindow/2-1
+	  || maketic - lowack >= BACKUPTICS)
 	break;          /* can't hold any more */
+      if (netsoak && maketic >= netsoak/ticdup)
+	break;          /* the test game ends there */
       /*   printf ("mk:%i ",maketic);   */
       G_BuildTiccmd (&localcmds[maketic%BACKUPTICS]);
+      if (netsoak)
+	NetSoakCmd (&localcmds[maketic%BACKUPTICS]);
       maketic++;
     }
   
@@ -411,30 +717,17 @@ void NetUpdate (void)
    * send the packet to the other nodes
    */
   for (i=0 ; i<doomcom->numnodes ; i++)
-    if (nodeingame[i])
+    if (nodeingame[i] && (relaynode == -1 || i == consoleplayer))
       {
-	netbuffer->starttic = realstart = resendto[i];
-	netbuffer->numtics = maketic - realstart;
-	if (netbuffer->numtics > BACKUPTICS)
-	  I_Error ("NetUpdate: netbuffer->numtics > BACKUPTICS");
-	
-	resendto[i] = maketic - doomcom->extratics;
-	
-	for (j=0 ; j< netbuffer->numtics ; j++)
-	  netbuffer->cmds[j] =
-	    localcmds[(realstart+j)%BACKUPTICS];
-	
-	if (remoteresend[i])
-	  {
-	    netbuffer->retransmitfrom = nettics[i];
-	    HSendPacket (i, NCMD_RETRANSMIT);
-	  }
-	else
-	  {
-	    netbuffer->retransmitfrom = 0;
-	    HSendPacket (i, 0);
-	  }
+	NetBuildTics (i);
+	HSendPacket (i, 0);
       }
+  if (relaynode != -1)
+    {
+      NetBuildTics (relaynode);
+      HSendPacket (relaynode, 0);
+    }
+  HFlushPackets ();
   
   /*
    * listen for other packets
@@ -472,6 +765,102 @@ void CheckAbort (void)
     }
 }
 
+/*
+  =====================
+  =
+  = SetupPacket
+  =
+  = Puts the game settings into netbuffer: ack carries the game flags,
+  = starttic episode and map
+  =
+  =====================
+*/
+
+static void SetupPacket (void)
+{
+  netbuffer->ack = startskill;
+  if (deathmatch)
+    netbuffer->ack |= (deathmatch<<6);
+  if (nomonsters)
+    netbuffer->ack |= 0x20;
+  if (respawnparm)
+    netbuffer->ack |= 0x10;
+  /*   netbuffer->starttic = startepisode * 64 + startmap;   */
+  netbuffer->starttic = (startepisode<<4)+startmap;
+  netbuffer->player = VERSION;
+  netbuffer->sack = 0;
+  netbuffer->numtics = 0;
+}
+
+static void ReadSetup (void)
+{
+  if (netbuffer->player != VERSION)
+    I_Error ("Different Heretic versions cannot play a net game!");
+  startskill = netbuffer->ack & 15;
+  deathmatch = (netbuffer->ack & 0xc0) >> 6;
+  nomonsters = (netbuffer->ack & 0x20) > 0;
+  respawnparm = (netbuffer->ack & 0x10) > 0;
+  /*   startmap = netbuffer->starttic & 0x3f;   */
+  /*   startepisode = netbuffer->starttic >> 6;   */
+  startmap = netbuffer->starttic&15;
+  startepisode = netbuffer->starttic>>4;
+}
+
+/*
+  =====================
+  =
+  = RelayNetStart
+  =
+  = Joins a game at hereticd.  The settings we send only count if we
+  = are the first in: the server answers with the first player's, our
+  = player number and how many there are, once they are all in.
+  =  -session <n>: the game to join, of those waiting
+  =  -players <n>: the players a game we start is for
+  =
+  =====================
+*/
+
+static void RelayNetStart (void)
+{
+  unsigned        session = 0;
+  int             numplayers = 0;
+  int             i;
+  
+  i = M_CheckParm ("-session");
+  if (i && i < myargc-1)
+    session = atoi (myargv[i+1]);
+  i = M_CheckParm ("-players");
+  if (i && i < myargc-1)
+    numplayers = atoi (myargv[i+1]);
+  
+  printf ("joining game %u at the server...\n", session);
+  while (1)
+    {
+      SetupPacket ();
+      netbuffer->sack = session<<8 | (numplayers & 0xff);
+      HSendPacket (relaynode, NCMD_SETUP);
+      HFlushPackets ();
+      
+      CheckAbort ();
+      while (HGetPacket ())
+	if (doomcom->remotenode == relaynode
+	    && (netbuffer->flags & NCMD_SETUP))
+	  {
+	    ReadSetup ();
+	    doomcom->consoleplayer = netbuffer->sack & 0xff;
+	    doomcom->numplayers = netbuffer->sack >> 8 & 0xff;
+	    doomcom->numnodes = doomcom->numplayers;
+	    if (doomcom->consoleplayer >= doomcom->numplayers
+		|| doomcom->numplayers > MAXPLAYERS)
+	      I_Error ("RelayNetStart: bad start from the server");
+	    return;
+	  }
+	else if (doomcom->remotenode == relaynode
+		 && (netbuffer->flags & NCMD_KILL))
+	  I_Error ("The server has no room for another game");
+    }
+}
+
 /*
   =====================
   =
@@ -488,7 +877,9 @@ void D_ArbitrateNetStart (void)
   autostart = true;
   memset (gotinfo,0,sizeof(gotinfo));
   
-  if (doomcom->consoleplayer)
+  if (relaynode != -1)
+    RelayNetStart ();
+  else if (doomcom->consoleplayer)
     {       /* listen for setup info from key player */
       printf ("listening for network start info...\n");
       while (1)
@@ -496,18 +887,9 @@ void D_ArbitrateNetStart (void)
 	  CheckAbort ();
 	  if (!HGetPacket ())
 	    continue;
-	  if (netbuffer->checksum & NCMD_SETUP)
+	  if (netbuffer->flags & NCMD_SETUP)
 	    {
-	      if (netbuffer->player != VERSION)
-		I_Error ("Different Heretic versions cannot play a net game!");
-	      startskill = netbuffer->retransmitfrom & 15;
-	      deathmatch = (netbuffer->retransmitfrom & 0xc0) >> 6;
-	      nomonsters = (netbuffer->retransmitfrom & 0x20) > 0;
-	      respawnparm = (netbuffer->retransmitfrom & 0x10) > 0;
-				/*   startmap = netbuffer->starttic & 0x3f;   */
-				/*   startepisode = netbuffer->starttic >> 6;   */
-	      startmap = netbuffer->starttic&15;
-	      startepisode = netbuffer->starttic>>4;
+	      ReadSetup ();
 	      return;
 	    }
 	}
@@ -520,19 +902,10 @@ void D_ArbitrateNetStart (void)
 	  CheckAbort ();
 	  for (i=0 ; i<doomcom->numnodes ; i++)
 	    {
-	      netbuffer->retransmitfrom = startskill;
-	      if (deathmatch)
-		netbuffer->retransmitfrom |= (deathmatch<<6);
-	      if (nomonsters)
-		netbuffer->retransmitfrom |= 0x20;
-	      if (respawnparm)
-		netbuffer->retransmitfrom |= 0x10;
-				/*   netbuffer->starttic = startepisode * 64 + startmap;   */
-	      netbuffer->starttic = (startepisode<<4)+startmap;
-	      netbuffer->player = VERSION;
-	      netbuffer->numtics = 0;
+	      SetupPacket ();
 	      HSendPacket (i, NCMD_SETUP);
 	    }
+	  HFlushPackets ();
 	  
 #if 1
 	  for(i = 10 ; i  &&  HGetPacket(); --i)
@@ -573,18 +946,35 @@ void D_CheckNetGame (void)
     {
       nodeingame[i] = false;
       nettics[i] = 0;
-      remoteresend[i] = false;        /* set when local needs tics */
       resendto[i] = 0;                /* which tic to start sending */
+      nodeack[i] = 0;
+      nodesack[i] = 0;
     }
+  memset (netgot, 0, sizeof(netgot));
+  
+  /* -netwindow <tics>: how far ahead tics may be made, 4 to BACKUPTICS */
+  netwindow = NETWINDOW;
+  i = M_CheckParm ("-netwindow");
+  if (i && i < myargc-1)
+    netwindow = atoi (myargv[i+1]);
+  if (netwindow < 4)
+    netwindow = 4;
+  if (netwindow > BACKUPTICS)
+    netwindow = BACKUPTICS;
+  
+  i = M_CheckParm ("-netsoak");
+  if (i && i < myargc-1)
+    netsoak = atoi (myargv[i+1]);
+  netpredict = M_CheckParm ("-predict");
   
   /* I_InitNetwork sets doomcom and netgame */
   I_InitNetwork ();
   if (doomcom->id != DOOMCOM_ID)
     I_Error ("Doomcom buffer invalid!");
-  netbuffer = &doomcom->data;
-  consoleplayer = displayplayer = doomcom->consoleplayer;
+  netbuffer = &netpacket;
   if (netgame)
     D_ArbitrateNetStart ();
+  consoleplayer = displayplayer = doomcom->consoleplayer;
   printf ("startskill %i  deathmatch: %i  startmap: %i  startepisode: %i\n", startskill, deathmatch, startmap, startepisode);
   
   /* read values out of doomcom */
@@ -597,6 +987,9 @@ void D_CheckNetGame (void)
     playeringame[i] = true;
   for (i=0 ; i<doomcom->numnodes ; i++)
     nodeingame[i] = true;
+  if (relaynode != -1)
+    nodeingame[relaynode] = true;
+  soakseed = consoleplayer+1;
   
   printf ("player %i of %i (%i nodes)\n", consoleplayer+1, doomcom->numplayers, doomcom->numnodes);
   
@@ -622,6 +1015,8 @@ void D_QuitNetGame (void)
   
   if (!netgame || !usergame || consoleplayer == -1 || demoplayback)
     return;
+  if (netsoak)
+    return;             /* the others finish the test on their own */
   
   /* send a bunch of packets for security */
   netbuffer->player = consoleplayer;
@@ -629,8 +1024,11 @@ void D_QuitNetGame (void)
   for (i=0 ; i<4 ; i++)
     {
       for (j=0 ; j<doomcom->numnodes ; j++)
-	if (nodeingame[j])
+	if (nodeingame[j] && relaynode == -1)
 	  HSendPacket (j, NCMD_EXIT);
+      if (relaynode != -1)
+	HSendPacket (relaynode, NCMD_EXIT);
+      HFlushPackets ();
       I_WaitVBL (1);
     }
 }
@@ -659,6 +1057,15 @@ void TryRunTics (void)
   int             realtics, availabletics;
   int             counts;
   int             numplaying;
+  int             ready;
+  int             waited;
+  int             waitstart;
+  int             entermaketic;
+  static int      waitentertic = -1;  /* when the wait for the others began */
+  boolean         stuck;
+  
+  if (netsoak && gametic >= netsoak)
+    NetSoakEnd ();
   
   /*
    * get real tics
@@ -739,14 +1146,28 @@ void TryRunTics (void)
    *    wait for new tics if needed
    *
    */
+  waited = 0;
+  entermaketic = maketic;
+  stuck = false;
+  if (waitentertic == -1)
+    waitentertic = entertic;
   while (lowtic < gametic/ticdup + counts)
     {
-#ifdef HAVE_USLEEP
-      /* Busywaiting is evil! We sleep 1/8 tic for each iteration. */
-      usleep((1000000/TICRATE)/8);
-#endif
+      /* nothing to run yet: draw another frame instead of waiting */
+      if (uncapped && entertic - rantime < 20)
+	return;
+      
+      /* a stall when it is only the others' tics we wait for,
+	 past the tic it takes them anyway */
+      ready = nettics[doomcom->consoleplayer] >= gametic/ticdup + counts;
+      waitstart = I_GetTimeMS ();
+      
+      /* sleep until a packet comes in or the next tic starts */
+      I_NetWait ();
       
       NetUpdate ();
+      if (ready)
+	waited += I_GetTimeMS () - waitstart;
       lowtic = MAXINT;
       
       for (i=0 ; i<doomcom->numnodes ; i++)
@@ -757,16 +1178,39 @@ void TryRunTics (void)
 	I_Error ("TryRunTics: lowtic < gametic");
       
       /* don't stay in here forever -- give the menu a chance to work */
-      if (I_GetTime ()/ticdup - entertic >= 20)
+      if (I_GetTime ()/ticdup - waitentertic >= 20)
+	{
+	  stuck = true;
+	  break;
+	}
+      
+      /* a new tic of our own is a new frame to predict, and only that */
+      if (netpredict && maketic > entermaketic)
+	break;
+    }
+  waited -= 1000/TICRATE;
+  if (waited > 0)
+    {
+      stallms += waited;
+      stalls++;
+      if (waited > stallmax)
+	stallmax = waited;
+    }
+  if (lowtic < gametic/ticdup + counts)
+    {
+      if (stuck)
 	{
 	  MN_Ticker ();
-	  return;
+	  waitentertic = -1;
 	}
+      return;
     }
+  waitentertic = -1;
   
   /*
    * run the count * ticdup dics
    */
+  rantime = entertic;
   while (counts--)
     {
       for (i=0 ; i<ticdup ; i++)
@@ -775,6 +1219,8 @@ void TryRunTics (void)
 	    I_Error ("gametic>lowtic");
 	  if (advancedemo)
 	    D_DoAdvanceDemo ();
+	  if (relaynode != -1)
+	    RelayDrops (gametic/ticdup);
 	  MN_Ticker ();
 	  G_Ticker ();
 	  gametic++;
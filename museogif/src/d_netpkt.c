@@ -0,0 +1,240 @@
+
+/*
+ * d_netpkt.c
+ * The wire format of net packets, shared by d_net.c and hereticd.c.
+ *
+ *  0   CRC-32C of the rest
+ *  4   flags
+ *  5   player, or the player mask of a relay packet
+ *  6   ack, low 16 bits
+ *  8   sack
+ *  12  starttic, low 16 bits
+ *  14  numtics
+ *  15  present[] if NCMD_SPARSE, then the tics that are present
+ *
+ * A tic is a byte flagging the fields that differ from the tic before
+ *  it in the packet (from an all zero one for the first), then those
+ *  fields.  A relay packet (NCMD_RELAY) from hereticd has the tics of
+ *  every player in its mask, lowest first, each coded against the same
+ *  player's tic before; they are in cmds[tic*MAXPLAYERS+player].  Every
+ *  packet can be read on its own, whatever got lost.
+ */
+
+#include "doomdef.h"
+
+/*
+ * CRC-32C (Castagnoli) of length bytes.
+ */
+static unsigned NetCRC32C (byte *data, int length)
+{
+  static unsigned       table[256];
+  unsigned              crc;
+  int                   i, j;
+
+  if (!table[1])
+    for (i=0 ; i<256 ; i++)
+      {
+	crc = i;
+	for (j=0 ; j<8 ; j++)
+	  crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+	table[i] = crc;
+      }
+
+  crc = 0xffffffff;
+  while (length--)
+    crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static byte *EncodeCmd (byte *p, ticcmd_t *cmd, ticcmd_t *prev)
+{
+  int           mask;
+
+  mask = (cmd->forwardmove != prev->forwardmove)
+    | (cmd->sidemove != prev->sidemove) << 1
+    | (cmd->angleturn != prev->angleturn) << 2
+    | (cmd->consistancy != prev->consistancy) << 3
+    | (cmd->chatchar != prev->chatchar) << 4
+    | (cmd->buttons != prev->buttons) << 5
+    | (cmd->lookfly != prev->lookfly) << 6
+    | (cmd->arti != prev->arti) << 7;
+  *p++ = mask;
+  if (mask & 1)
+    *p++ = cmd->forwardmove;
+  if (mask & 2)
+    *p++ = cmd->sidemove;
+  if (mask & 4)
+    {
+      *p++ = cmd->angleturn;
+      *p++ = cmd->angleturn >> 8;
+    }
+  if (mask & 8)
+    {
+      *p++ = cmd->consistancy;
+      *p++ = cmd->consistancy >> 8;
+    }
+  if (mask & 16)
+    *p++ = cmd->chatchar;
+  if (mask & 32)
+    *p++ = cmd->buttons;
+  if (mask & 64)
+    *p++ = cmd->lookfly;
+  if (mask & 128)
+    *p++ = cmd->arti;
+  *prev = *cmd;
+  return p;
+}
+
+/*
+ * Returns the byte after the tic, NULL if the packet ends within it.
+ */
+static byte *DecodeCmd (byte *p, byte *end, ticcmd_t *cmd, ticcmd_t *prev)
+{
+  int           mask;
+  int           need;
+
+  if (p == end)
+    return NULL;
+  mask = *p++;
+  need = (mask&1) + (mask>>1&1) + (mask>>2&1)*2 + (mask>>3&1)*2
+    + (mask>>4&1) + (mask>>5&1) + (mask>>6&1) + (mask>>7&1);
+  if (end - p < need)
+    return NULL;
+  *cmd = *prev;
+  if (mask & 1)
+    cmd->forwardmove = *p++;
+  if (mask & 2)
+    cmd->sidemove = *p++;
+  if (mask & 4)
+    {
+      cmd->angleturn = p[0] | p[1] << 8;
+      p += 2;
+    }
+  if (mask & 8)
+    {
+      cmd->consistancy = p[0] | p[1] << 8;
+      p += 2;
+    }
+  if (mask & 16)
+    cmd->chatchar = *p++;
+  if (mask & 32)
+    cmd->buttons = *p++;
+  if (mask & 64)
+    cmd->lookfly = *p++;
+  if (mask & 128)
+    cmd->arti = *p++;
+  *prev = *cmd;
+  return p;
+}
+
+/*
+ * Packs packet into out, and returns the length.
+ */
+int NetEncode (doomdata_t *packet, byte *out)
+{
+  byte          *p;
+  ticcmd_t      prev[MAXPLAYERS];
+  int           i, j;
+
+  memset (prev, 0, sizeof(prev));
+
+  out[4] = packet->flags;
+  out[5] = packet->player;
+  out[6] = packet->ack;
+  out[7] = packet->ack >> 8;
+  for (i=0 ; i<4 ; i++)
+    out[8+i] = packet->sack >> (i*8);
+  out[12] = packet->starttic;
+  out[13] = packet->starttic >> 8;
+  out[14] = packet->numtics;
+  p = out+15;
+
+  for (i=0 ; i<packet->numtics ; i++)
+    if (!(packet->present[i>>3] & (1 << (i&7))))
+      break;
+  if (i < packet->numtics)
+    {
+      out[4] |= NCMD_SPARSE;
+      memcpy (p, packet->present, (packet->numtics+7)/8);
+      p += (packet->numtics+7)/8;
+    }
+
+  for (i=0 ; i<packet->numtics ; i++)
+    {
+      if (!(packet->present[i>>3] & (1 << (i&7))))
+	continue;
+      if (!(packet->flags & NCMD_RELAY))
+	{
+	  p = EncodeCmd (p, &packet->cmds[i], &prev[0]);
+	  continue;
+	}
+      for (j=0 ; j<MAXPLAYERS ; j++)
+	if (packet->player & (1 << j))
+	  p = EncodeCmd (p, &packet->cmds[i*MAXPLAYERS+j], &prev[j]);
+    }
+
+  i = NetCRC32C (out+4, p-out-4);
+  out[0] = i;
+  out[1] = i >> 8;
+  out[2] = i >> 16;
+  out[3] = i >> 24;
+  return p-out;
+}
+
+/*
+ * Unpacks a packet from NetEncode into packet.
+ * Returns false if it is damaged or not one of ours.
+ */
+boolean NetDecode (doomdata_t *packet, byte *in, int length)
+{
+  byte          *p;
+  byte          *end = in+length;
+  ticcmd_t      prev[MAXPLAYERS];
+  int           i, j;
+
+  if (length < 15
+      || NetCRC32C (in+4, length-4)
+      != (unsigned)(in[0] | in[1] << 8 | in[2] << 16 | in[3] << 24))
+    return false;
+
+  packet->flags = in[4] & ~NCMD_SPARSE;
+  packet->player = in[5];
+  packet->ack = in[6] | in[7] << 8;
+  packet->sack = in[8] | in[9] << 8 | in[10] << 16 | (unsigned)in[11] << 24;
+  packet->starttic = in[12] | in[13] << 8;
+  packet->numtics = in[14];
+  p = in+15;
+  if (packet->numtics > (packet->flags & NCMD_RELAY ? RELAYMAXTICS : BACKUPTICS))
+    return false;
+
+  memset (packet->present, 0xff, sizeof(packet->present));
+  if (in[4] & NCMD_SPARSE)
+    {
+      if (end - p < (packet->numtics+7)/8)
+	return false;
+      memcpy (packet->present, p, (packet->numtics+7)/8);
+      p += (packet->numtics+7)/8;
+    }
+
+  memset (prev, 0, sizeof(prev));
+  for (i=0 ; i<packet->numtics ; i++)
+    {
+      if (!(packet->present[i>>3] & (1 << (i&7))))
+	continue;
+      if (!(packet->flags & NCMD_RELAY))
+	{
+	  p = DecodeCmd (p, end, &packet->cmds[i], &prev[0]);
+	  if (!p)
+	    return false;
+	  continue;
+	}
+      for (j=0 ; j<MAXPLAYERS ; j++)
+	if (packet->player & (1 << j))
+	  {
+	    p = DecodeCmd (p, end, &packet->cmds[i*MAXPLAYERS+j], &prev[j]);
+	    if (!p)
+	      return false;
+	  }
+    }
+  return p == end;
+}
@@ -0,0 +1,589 @@
+/* demorunner.c */
+
+/*
+  Plays every .lmp in a directory through headless engine instances,
+  several at a time, and reports per-demo timing and final state hash.
+
+  Each demo runs as
+
+    <engine> -fastdemo <dir>/<name> -statehash <file> [engine args]
+
+  and the engine's "fastdemo:" and "statehash:" lines are picked out of its
+  output.  With -record <dir> the per-tic hash files are kept as
+  <dir>/<name>.hash; with -check <dir> each demo is verified against them
+  instead, so a sync regression names the demo and the first diverging tic.
+  With -shots <dir> each demo's last frame is saved as <dir>/<name>.pcx
+  with -drawfinal, and a demo that leaves no screenshot fails.
+
+  The exit status is nonzero if any demo failed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+
+#define MAXENGINEARGS	64
+
+typedef struct
+{
+  char *name;			/* file name, with .lmp */
+  char *path;			/* directory/name, without .lmp */
+  pid_t pid;
+  int fd;			/* read end of the engine's stdout/stderr */
+  char *out;
+  size_t outlen, outsize;
+  long started;			/* ms */
+  long wallms;
+  int killed;
+  int status;
+
+  /* parsed from the output */
+  int tics;
+  int ms;
+  double ticspersec;
+  int hashtics;
+  unsigned hash;
+  int hashed;
+  int matched;
+  char error[256];
+  int ok;
+} job_t;
+
+static job_t *jobs;
+static int numjobs;
+
+static char *engine = "./sdlheretic";
+static char *jsonfile = "demorunner.json";
+static char *hashdir;
+static char *shotdir;
+static int checkhashes;
+static int maxjobs;
+static int timeout;		/* seconds, 0 for none */
+static char *engineargs[MAXENGINEARGS];
+static int numengineargs;
+
+static long NowMS (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+static void Fatal (char *msg, char *arg)
+{
+  fprintf (stderr, "demorunner: %s%s%s\n", msg, arg ? ": " : "",
+	   arg ? arg : "");
+  exit (2);
+}
+
+static void Usage (void)
+{
+  fprintf (stderr,
+	   "usage: demorunner [-j jobs] [-engine path] [-json file]\n"
+	   "                  [-record hashdir | -check hashdir]"
+	   " [-timeout secs]\n"
+	   "                  [-shots dir]\n"
+	   "                  demodir [-- engine args]\n");
+  exit (2);
+}
+
+static int CompareJobs (const void *a, const void *b)
+{
+  return strcmp (((const job_t *) a)->name, ((const job_t *) b)->name);
+}
+
+/*
+  ====================
+  =
+  = ScanDemos
+  =
+  ====================
+*/
+
+static void ScanDemos (char *dir)
+{
+  DIR *d;
+  struct dirent *de;
+  int size = 0;
+  size_t len;
+
+  if ((d = opendir (dir)) == NULL)
+    Fatal ("can't open demo directory", dir);
+
+  while ((de = readdir (d)) != NULL)
+    {
+      len = strlen (de->d_name);
+      if (len <= 4 || strcasecmp (de->d_name + len - 4, ".lmp"))
+	continue;
+      if (numjobs == size)
+	{
+	  size = size ? size * 2 : 64;
+	  jobs = realloc (jobs, size * sizeof (*jobs));
+	  if (!jobs)
+	    Fatal ("out of memory", NULL);
+	}
+      memset (&jobs[numjobs], 0, sizeof (*jobs));
+      jobs[numjobs].name = strdup (de->d_name);
+      jobs[numjobs].path = malloc (strlen (dir) + len + 2);
+      sprintf (jobs[numjobs].path, "%s/%.*s", dir, (int) len - 4, de->d_name);
+      jobs[numjobs].fd = -1;
+      numjobs++;
+    }
+  closedir (d);
+
+  qsort (jobs, numjobs, sizeof (*jobs), CompareJobs);
+}
+
+static void ShotFile (job_t *job, char *file, size_t size)
+{
+  snprintf (file, size, "%s/%.*s.pcx", shotdir, (int) strlen (job->name) - 4,
+	    job->name);
+}
+
+/*
+  ====================
+  =
+  = StartJob
+  =
+  ====================
+*/
+
+static void StartJob (job_t *job)
+{
+  char *argv[MAXENGINEARGS + 8];
+  char hashfile[1024];
+  char shotfile[1024];
+  int pipefd[2];
+  int argc = 0;
+  int i, nul;
+
+  if (hashdir)
+    snprintf (hashfile, sizeof (hashfile), "%s/%.*s.hash", hashdir,
+	      (int) strlen (job->name) - 4, job->name);
+  else
+    strcpy (hashfile, "/dev/null");
+
+  argv[argc++] = engine;
+  argv[argc++] = "-fastdemo";
+  argv[argc++] = job->path;
+  argv[argc++] = checkhashes ? "-statecheck" : "-statehash";
+  argv[argc++] = hashfile;
+  if (shotdir)
+    {
+      ShotFile (job, shotfile, sizeof (shotfile));
+      unlink (shotfile);
+      argv[argc++] = "-drawfinal";
+      argv[argc++] = shotfile;
+    }
+  for (i = 0; i < numengineargs; i++)
+    argv[argc++] = engineargs[i];
+  argv[argc] = NULL;
+
+  if (pipe (pipefd) < 0)
+    Fatal ("pipe", strerror (errno));
+
+  job->started = NowMS ();
+  job->pid = fork ();
+  if (job->pid < 0)
+    Fatal ("fork", strerror (errno));
+
+  if (job->pid == 0)
+    {
+      nul = open ("/dev/null", O_RDONLY);
+      dup2 (nul, 0);
+      dup2 (pipefd[1], 1);
+      dup2 (pipefd[1], 2);
+      close (pipefd[0]);
+      close (pipefd[1]);
+      close (nul);
+      execv (engine, argv);
+      fprintf (stderr, "Error: can't run %s: %s\n", engine, strerror (errno));
+      _exit (127);
+    }
+
+  close (pipefd[1]);
+  job->fd = pipefd[0];
+}
+
+/*
+  ====================
+  =
+  = ParseOutput
+  =
+  = Picks the results out of the engine output and decides pass/fail.
+  =
+  ====================
+*/
+
+static void ParseOutput (job_t *job)
+{
+  char *line, *next, *e;
+  char shotfile[1024];
+  struct stat st;
+
+  job->out[job->outlen] = 0;
+  for (line = job->out; *line; line = next)
+    {
+      next = strchr (line, '\n');
+      if (next)
+	*next++ = 0;
+      else
+	next = line + strlen (line);
+
+      if (sscanf (line, "fastdemo: %i gametics in %i ms, %lf tics/sec",
+		  &job->tics, &job->ms, &job->ticspersec) == 3)
+	continue;
+      if (sscanf (line, "statehash: %i tics, final hash %x",
+		  &job->hashtics, &job->hash) == 2)
+	{
+	  job->hashed = 1;
+	  job->matched = strstr (line, "all match") != NULL;
+	  continue;
+	}
+      if (!strncmp (line, "Error: ", 7) && !job->error[0])
+	{
+	  snprintf (job->error, sizeof (job->error), "%s", line + 7);
+	  for (e = job->error; *e; e++)
+	    if (*e == '\r')
+	      *e = 0;
+	}
+    }
+
+  job->ok = job->tics > 0 && job->hashed
+    && (!checkhashes || job->matched) && !job->error[0];
+
+  /* a PCX is a 128 byte header and then the picture */
+  if (job->ok && shotdir)
+    {
+      ShotFile (job, shotfile, sizeof (shotfile));
+      if (stat (shotfile, &st) || st.st_size <= 128)
+	{
+	  job->ok = 0;
+	  snprintf (job->error, sizeof (job->error), "no -drawfinal screenshot");
+	}
+    }
+
+  if (job->ok)
+    return;
+  if (job->error[0])
+    return;
+  if (job->killed)
+    snprintf (job->error, sizeof (job->error), "timed out after %i s",
+	      timeout);
+  else if (WIFSIGNALED (job->status))
+    snprintf (job->error, sizeof (job->error), "killed by signal %i",
+	      WTERMSIG (job->status));
+  else if (WIFEXITED (job->status) && WEXITSTATUS (job->status))
+    snprintf (job->error, sizeof (job->error), "exit status %i",
+	      WEXITSTATUS (job->status));
+  else
+    snprintf (job->error, sizeof (job->error), "no results in output");
+}
+
+/*
+  ====================
+  =
+  = ReadJob
+  =
+  = Returns 0 once the engine has closed its output.
+  =
+  ====================
+*/
+
+static int ReadJob (job_t *job)
+{
+  ssize_t n;
+
+  if (job->outsize - job->outlen < 4096)
+    {
+      job->outsize = job->outsize ? job->outsize * 2 : 16384;
+      job->out = realloc (job->out, job->outsize + 1);
+      if (!job->out)
+	Fatal ("out of memory", NULL);
+    }
+
+  n = read (job->fd, job->out + job->outlen, job->outsize - job->outlen);
+  if (n < 0 && errno == EINTR)
+    return 1;
+  if (n > 0)
+    {
+      job->outlen += n;
+      return 1;
+    }
+  return 0;
+}
+
+static void FinishJob (job_t *job)
+{
+  close (job->fd);
+  job->fd = -1;
+  while (waitpid (job->pid, &job->status, 0) < 0 && errno == EINTR)
+    ;
+  job->wallms = NowMS () - job->started;
+  if (!job->out)
+    {
+      job->out = malloc (1);
+      job->outlen = 0;
+    }
+  ParseOutput (job);
+  free (job->out);
+  job->out = NULL;
+}
+
+/*
+  ====================
+  =
+  = RunJobs
+  =
+  ====================
+*/
+
+static void RunJobs (void)
+{
+  fd_set fds;
+  struct timeval tv;
+  int next = 0, running = 0, done = 0;
+  int i, maxfd;
+  long now;
+
+  while (done < numjobs)
+    {
+      while (running < maxjobs && next < numjobs)
+	{
+	  StartJob (&jobs[next++]);
+	  running++;
+	}
+
+      FD_ZERO (&fds);
+      maxfd = -1;
+      for (i = 0; i < next; i++)
+	if (jobs[i].fd >= 0)
+	  {
+	    FD_SET (jobs[i].fd, &fds);
+	    if (jobs[i].fd > maxfd)
+	      maxfd = jobs[i].fd;
+	  }
+
+      tv.tv_sec = 1;
+      tv.tv_usec = 0;
+      if (select (maxfd + 1, &fds, NULL, NULL, &tv) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  Fatal ("select", strerror (errno));
+	}
+
+      now = NowMS ();
+      for (i = 0; i < next; i++)
+	{
+	  if (jobs[i].fd < 0)
+	    continue;
+	  if (timeout && !jobs[i].killed
+	      && now - jobs[i].started > timeout * 1000L)
+	    {
+	      kill (jobs[i].pid, SIGKILL);
+	      jobs[i].killed = 1;
+	    }
+	  if (!FD_ISSET (jobs[i].fd, &fds) || ReadJob (&jobs[i]))
+	    continue;
+
+	  FinishJob (&jobs[i]);
+	  running--;
+	  done++;
+	  printf ("[%*i/%i] %-24s %s\n", (int) snprintf (NULL, 0, "%i", numjobs),
+		  done, numjobs, jobs[i].name, jobs[i].ok ? "ok" : jobs[i].error);
+	  fflush (stdout);
+	}
+    }
+}
+
+/*
+  ====================
+  =
+  = PrintSummary
+  =
+  ====================
+*/
+
+static void PrintSummary (long wallms)
+{
+  long tics = 0, ms = 0;
+  int failed = 0;
+  int i;
+
+  printf ("\n%-24s %8s %8s %10s %8s  %s\n", "demo", "tics", "ms", "tics/sec",
+	  "hash", "result");
+  for (i = 0; i < numjobs; i++)
+    {
+      job_t *job = &jobs[i];
+
+      if (job->hashed)
+	printf ("%-24s %8i %8i %10.1f %08x  %s\n", job->name, job->tics,
+		job->ms, job->ticspersec, job->hash,
+		job->ok ? "ok" : job->error);
+      else
+	printf ("%-24s %8i %8i %10.1f %8s  %s\n", job->name, job->tics,
+		job->ms, job->ticspersec, "-", job->ok ? "ok" : job->error);
+      tics += job->tics;
+      ms += job->ms;
+      if (!job->ok)
+	failed++;
+    }
+
+  printf ("\n%i demos, %i failed, %li tics in %li ms of engine time"
+	  " (%.1f tics/sec)\n", numjobs, failed, tics, ms,
+	  ms ? tics * 1000.0 / ms : 0.0);
+  printf ("%i jobs, %li ms wall time (%.1f tics/sec aggregate)\n", maxjobs,
+	  wallms, wallms ? tics * 1000.0 / wallms : 0.0);
+}
+
+static void JSONString (FILE *f, char *s)
+{
+  fputc ('"', f);
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+	fprintf (f, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+	fprintf (f, "\\u%04x", (unsigned char) *s);
+      else
+	fputc (*s, f);
+    }
+  fputc ('"', f);
+}
+
+/*
+  ====================
+  =
+  = WriteJSON
+  =
+  ====================
+*/
+
+static void WriteJSON (char *dir, long wallms)
+{
+  FILE *f;
+  int i;
+
+  if ((f = fopen (jsonfile, "w")) == NULL)
+    Fatal ("can't write report", jsonfile);
+
+  fprintf (f, "{\n  \"engine\": ");
+  JSONString (f, engine);
+  fprintf (f, ",\n  \"demodir\": ");
+  JSONString (f, dir);
+  fprintf (f, ",\n  \"mode\": \"%s\",\n  \"jobs\": %i,\n  \"wall_ms\": %li,\n"
+	   "  \"demos\": [", checkhashes ? "check" : hashdir ? "record" : "hash",
+	   maxjobs, wallms);
+
+  for (i = 0; i < numjobs; i++)
+    {
+      job_t *job = &jobs[i];
+
+      fprintf (f, "%s\n    {\"name\": ", i ? "," : "");
+      JSONString (f, job->name);
+      fprintf (f, ", \"ok\": %s, \"tics\": %i, \"ms\": %i, "
+	       "\"tics_per_sec\": %.1f, \"wall_ms\": %li, ",
+	       job->ok ? "true" : "false", job->tics, job->ms,
+	       job->ticspersec, job->wallms);
+      if (job->hashed)
+	fprintf (f, "\"hash\": \"%08x\", \"hash_tics\": %i", job->hash,
+		 job->hashtics);
+      else
+	fprintf (f, "\"hash\": null, \"hash_tics\": 0");
+      if (!job->ok)
+	{
+	  fprintf (f, ", \"error\": ");
+	  JSONString (f, job->error);
+	}
+      fprintf (f, "}");
+    }
+  fprintf (f, "\n  ]\n}\n");
+
+  if (fclose (f))
+    Fatal ("can't write report", jsonfile);
+}
+
+int main (int argc, char **argv)
+{
+  char *dir = NULL;
+  long wallms;
+  int i;
+
+  maxjobs = sysconf (_SC_NPROCESSORS_ONLN);
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp (argv[i], "--"))
+	{
+	  for (i++; i < argc; i++)
+	    {
+	      if (numengineargs == MAXENGINEARGS)
+		Fatal ("too many engine arguments", NULL);
+	      engineargs[numengineargs++] = argv[i];
+	    }
+	  break;
+	}
+      if (argv[i][0] != '-')
+	{
+	  if (dir)
+	    Usage ();
+	  dir = argv[i];
+	  continue;
+	}
+      if (i + 1 == argc)
+	Usage ();
+      if (!strcmp (argv[i], "-j"))
+	maxjobs = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-engine"))
+	engine = argv[++i];
+      else if (!strcmp (argv[i], "-json"))
+	jsonfile = argv[++i];
+      else if (!strcmp (argv[i], "-record"))
+	hashdir = argv[++i], checkhashes = 0;
+      else if (!strcmp (argv[i], "-check"))
+	hashdir = argv[++i], checkhashes = 1;
+      else if (!strcmp (argv[i], "-timeout"))
+	timeout = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-shots"))
+	shotdir = argv[++i];
+      else
+	Usage ();
+    }
+
+  if (!dir)
+    Usage ();
+  if (maxjobs < 1)
+    maxjobs = 1;
+  if (access (engine, X_OK))
+    Fatal ("can't run engine", engine);
+
+  ScanDemos (dir);
+  if (!numjobs)
+    Fatal ("no .lmp files in", dir);
+  if (maxjobs > numjobs)
+    maxjobs = numjobs;
+
+  wallms = NowMS ();
+  RunJobs ();
+  wallms = NowMS () - wallms;
+
+  PrintSummary (wallms);
+  WriteJSON (dir, wallms);
+
+  for (i = 0; i < numjobs; i++)
+    if (!jobs[i].ok)
+      return 1;
+  return 0;
+}
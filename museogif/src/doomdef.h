@@ -27,6 +27,13 @@ extern byte *destview, *destscreen;
 #define VERSION 130
 #define VERSION_TEXT "v1.3"
 
+/*
+ * Savegames store mobj_t as it is in memory, so this goes up whenever
+ * mobj_t changes: 131 added the -uncapped old positions, 132 moved the
+ * per-tic fields first.
+ */
+#define SAVEVERSION 132
+
 /*
  * most key data are simple ascii (lowercased)
  */
@@ -423,29 +430,37 @@ typedef struct mobj_s
 {
   thinker_t		thinker;       /* thinker links */
   
-  /* info for drawing */
+  /*
+   * what P_MobjThinker looks at every tic, next to the thinker links so
+   * a thing at rest costs it a cache line or two
+   * x,y,z come first, as in degenmobj_t
+   */
   fixed_t		x  __PACKED__ ,y  __PACKED__ ,z  __PACKED__ ;
-  struct mobj_s	*snext  __PACKED__ , *sprev  __PACKED__ ;	       /* links in sector (if needed) */
-  angle_t		angle  __PACKED__ ;
+  fixed_t		momx  __PACKED__ , momy  __PACKED__ , momz  __PACKED__ ; /* momentums */
+  int			flags  __PACKED__ ;
+  int			flags2  __PACKED__ ;		  /* Heretic flags */
+  fixed_t		floorz  __PACKED__ ;	  /* closest together of contacted secs */
+  int			tics  __PACKED__ ;		  /* state tic counter */
+  int		        health  __PACKED__ ;
+  
+  /* info for drawing */
+  state_t		*state  __PACKED__ ;
   spritenum_t		sprite  __PACKED__ ;	       /* used to find patch_t and flip value */
   int			frame  __PACKED__ ;	       /*  might be ord with FF_FULLBRIGHT */
+  angle_t		angle  __PACKED__ ;
+  struct mobj_s	*snext  __PACKED__ , *sprev  __PACKED__ ;	       /* links in sector (if needed) */
+  fixed_t		oldx  __PACKED__ , oldy  __PACKED__ , oldz  __PACKED__ ; /* before the last tic */
+  angle_t		oldangle  __PACKED__ ;	       /* for -uncapped frames */
 
   /* interaction info */
   struct mobj_s	*bnext  __PACKED__ , *bprev  __PACKED__ ;		/* links in blocks (if needed) */
   struct subsector_s	*subsector  __PACKED__ ;
-  fixed_t		floorz  __PACKED__ , ceilingz  __PACKED__ ; /* closest together of contacted secs */
+  fixed_t		ceilingz  __PACKED__ ;
   fixed_t		radius  __PACKED__ , height  __PACKED__ ;	  /* for movement checking */
-  fixed_t		momx  __PACKED__ , momy  __PACKED__ , momz  __PACKED__ ; /* momentums */
   
   int		        validcount  __PACKED__ ;	  /* if == validcount, already checked */
   
-  mobjtype_t		type  __PACKED__ ;
-  mobjinfo_t		*info  __PACKED__ ;		  /* &mobjinfo[mobj->type] */
-  int			tics  __PACKED__ ;		  /* state tic counter */
-  state_t		*state  __PACKED__ ;
   int			damage  __PACKED__ ;		  /* For missiles */
-  int			flags  __PACKED__ ;
-  int			flags2  __PACKED__ ;		  /* Heretic flags */
 #ifdef __64BIT__
   long			special1  __PACKED__ ;	  /* Special info */
   long			special2  __PACKED__ ;	  /* Special info */
@@ -453,7 +468,6 @@ typedef struct mobj_s
   int			special1  __PACKED__ ;	  /* Special info */
   int			special2  __PACKED__ ;	  /* Special info */
 #endif
-  int		        health  __PACKED__ ;
   int			movedir  __PACKED__ ;	  /* 0-7 */
   int		        movecount  __PACKED__ ;	  /* when 0, select a new dir */
   struct mobj_s *target  __PACKED__ ;		  /* thing being chased/attacked (or NULL) */
@@ -463,6 +477,10 @@ typedef struct mobj_s
   /* teleporting */
   int			threshold  __PACKED__ ;	  /* if >0, the target will be chased */
   /* no matter what (even if shot) */
+  
+  /* seldom looked at */
+  mobjtype_t		type  __PACKED__ ;
+  mobjinfo_t		*info  __PACKED__ ;		  /* &mobjinfo[mobj->type] */
   struct player_s	*player  __PACKED__ ;	  /* only valid if type == MT_PLAYER */
   int			lastlook  __PACKED__ ;	  /* player number last looked for */
   
@@ -651,16 +669,40 @@ typedef struct player_s
 #define	CF_GODMODE		2
 #define	CF_NOMOMENTUM	        4    /* not really a cheat, just a debug aid */
 
-#define	BACKUPTICS		12   /* CHANGED FROM 12 !?!? */
+/* tics held for the net game, and the largest -netwindow */
+#define	BACKUPTICS		128
+
+/* doomdata_t flags, and the flags byte on the wire */
+#define	NCMD_EXIT		0x80
+#define	NCMD_RELAY		0x40	     /* from hereticd: all players' tics */
+#define	NCMD_SETUP		0x20
+#define	NCMD_KILL		0x10	     /* kill game */
+#define	NCMD_SPARSE		0x08	     /* wire only: present[] follows */
 
+/* tics in a relay packet, so MAXPLAYERS of each fit cmds[] */
+#define	RELAYMAXTICS		(BACKUPTICS/MAXPLAYERS)
+
+/*
+ * A packet as d_net.c builds and reads it.  On the wire it is packed
+ *  by NetEncode (see d_netpkt.c) into at most NETPACKETSIZE bytes.
+ */
 typedef struct
 {
-  unsigned	checksum;	     /* high bit is retransmit request */
-  byte		retransmitfrom  __PACKED__ ;	     /* only valid if NCMD_RETRANSMIT */
-  byte		starttic  __PACKED__ ;
-  byte		player  __PACKED__ , numtics  __PACKED__ ;
-  ticcmd_t	cmds[BACKUPTICS]  __PACKED__ ;
-}  __PACKED__  doomdata_t;
+  unsigned	flags;		     /* NCMD_* */
+  byte		player;		     /* NCMD_RELAY: the players in cmds */
+  int		ack;		     /* the receiver's tics we have all of below */
+  unsigned	sack;		     /* bit n: we also have tic ack+1+n */
+  int		starttic;	     /* first tic in cmds */
+  int		numtics;	     /* tics spanned by cmds */
+  byte		present[BACKUPTICS/8]; /* bit per tic actually in the packet */
+  ticcmd_t	cmds[BACKUPTICS];
+} doomdata_t;
+
+int NetEncode (doomdata_t *packet, byte *out);
+boolean NetDecode (doomdata_t *packet, byte *in, int length);
+
+/* an Ethernet frame less the IP and UDP headers */
+#define	NETPACKETSIZE		1472
 
 typedef struct
 {
@@ -668,9 +710,9 @@ typedef struct
   short	intnum  __PACKED__ ;			     /* DOOM executes an int to execute commands */
   
   /* communication between DOOM and the driver */
-  short	command  __PACKED__ ;		     /* CMD_SEND or CMD_GET */
+  short	command  __PACKED__ ;		     /* CMD_SEND, CMD_GET or CMD_FLUSH */
   short	remotenode  __PACKED__ ;		     /* dest for send, set by get (-1 = no packet) */
-  short	datalength  __PACKED__ ;		     /* bytes in doomdata to be sent */
+  short	datalength  __PACKED__ ;		     /* bytes in data to be sent */
 
   /* info common to all nodes */
   short	numnodes  __PACKED__ ;		     /* console is allways node 0 */
@@ -688,19 +730,20 @@ typedef struct
   short	angleoffset  __PACKED__ ;	             /* 1 = left, 0 = center, -1 = right */
   short	drone  __PACKED__ ;			     /* 1 = drone */
   
-  /* packet data to be sent */
-  doomdata_t	data  __PACKED__ ;
+  /* packet data to be sent, as NetEncode packed it */
+  byte	data[NETPACKETSIZE]  __PACKED__ ;
 }  __PACKED__  doomcom_t;
 
 #define	DOOMCOM_ID	0x12345678l
 
 extern	doomcom_t	*doomcom;
-extern	doomdata_t	*netbuffer;  /* points inside doomcom */
+extern	doomdata_t	*netbuffer;  /* the packet being built or read */
 
 #define	MAXNETNODES	8	     /* max computers in a game */
 
 #define	CMD_SEND	1
 #define	CMD_GET		2
+#define	CMD_FLUSH	3	     /* send what the driver held back */
 
 #define	SBARHEIGHT	42	     /* status bar height at bottom of screen */
 
@@ -763,12 +806,22 @@ extern int viewangleoffset; /* ANG90 = left side, ANG270 = right */
 extern player_t players[MAXPLAYERS];
 
 extern	boolean		singletics;   /* debug flag to cancel adaptiveness */
+extern	boolean		nodraw;       /* -nodraw: run tics flat out, no sound */
+extern	int		drawevery;    /* -nodraw N: still draw every Nth tic */
+extern	boolean		drawfinal;    /* -drawfinal: screenshot the last frame */
+extern	char		*drawfinalname; /* -drawfinal <file> */
+extern	boolean		novideo;      /* nothing is ever shown, no video init */
+extern	boolean		wavout;       /* -wavout: sound goes to a file, per tic */
+extern	boolean		uncapped;     /* -uncapped: frames between the tics */
 
 extern boolean DebugSound;  /* debug flag for displaying sound info */
 
 extern	int		maxammo[NUMAMMO];
 
 extern	boolean		demoplayback;
+extern	boolean		demorecording;
+extern	int		starttime;	  /* for comparative timing purposes */
+extern	int		starttimems;
 extern	int		skytexture;
 
 extern	gamestate_t	gamestate;
@@ -783,6 +836,7 @@ extern	int		leveltime;	  /* tics in game play for par */
 
 extern	ticcmd_t	netcmds[MAXPLAYERS][BACKUPTICS];
 extern int ticdup;
+extern int netsoak;		/* -netsoak <tics>: last tic of the test game */
 
 #define	MAXNETNODES		8
 extern	ticcmd_t		localcmds[BACKUPTICS];
@@ -972,6 +1026,13 @@ void D_QuitNetGame (void);
 
 void TryRunTics (void);
 
+void D_StartPrediction (void);
+void D_EndPrediction (void);
+/* -predict: move the console player ahead for the frame, and back */
+
+fixed_t D_TicFrac (void);
+/* -uncapped: how far the frame is into the tic after the last one run */
+
 
 /*
  * ---------
@@ -1043,6 +1104,10 @@ byte *I_ZoneBase (size_t *size);
  */
 
 int I_GetTime (void);
+int I_GetTimeMS (void);
+/* milliseconds, for benchmarks */
+int I_GetTimeFrac (fixed_t *frac);
+/* I_GetTime, and how far into that tic it is */
 /*
  * called by D_DoomLoop
  * returns current time in tics
@@ -1077,6 +1142,8 @@ void I_InitGraphics (void);
 
 void I_InitNetwork (void);
 void I_NetCmd (void);
+void I_NetWait (void);
+void I_InitUDP (void);
 
 void I_Error (char *error, ...);
 /*
@@ -1149,6 +1216,12 @@ void SV_WriteByte(byte val);
 void SV_WriteWord(unsigned short val);
 void SV_WriteLong(unsigned int val);
 
+void G_InitAutoSave (int minutes);
+void G_WaitAutoSave (void);
+void G_ReserveAutoSave (void);
+void G_CheckAutoSave (void);
+/* -autosave: periodic background saves to slot 'a' */
+
 void G_RecordDemo (skill_t skill, int numplayers, int episode
 		   ,int map, char *name);
 /* only called by startup code */
@@ -1156,6 +1229,26 @@ void G_RecordDemo (skill_t skill, int numplayers, int episode
 void G_PlayDemo (char *name);
 void G_TimeDemo (char *name);
 
+boolean G_OpenDemoRead (char *name);
+void G_OpenDemoWrite (char *name);
+int G_DemoReadByte (void);
+void G_DemoWriteByte (byte b);
+long G_DemoTell (void);
+void G_DemoSeek (long offset);
+int G_DemoTic (void);
+void G_CloseDemo (void);
+/* buffered demo streams, g_demo.c */
+
+void G_StartDemoKeyframes (void);
+void G_CheckDemoKeyframe (void);
+void G_StopDemoKeyframes (void);
+/* -demokeyframes / -demoseek */
+
+void G_InitStateHash (void);
+void G_CheckStateHash (void);
+void G_StopStateHash (void);
+/* -statehash / -statecheck */
+
 boolean G_CheckDemoStatus (void);
 
 void G_ExitLevel (void);
@@ -1221,6 +1314,9 @@ extern int UpdateState;
 void R_RenderPlayerView (player_t *player);
 /* called by G_Drawer */
 
+extern fixed_t interpfrac;
+/* how far R_RenderPlayerView draws the world from the tic before to the last */
+
 void R_Init (void);
 /* called by startup code */
 
@@ -1281,6 +1377,7 @@ boolean M_WriteFile (char const *name, void *source, int length);
 int M_ReadFile (char const *name, byte **buffer);
 
 void M_ScreenShot (void);
+void M_WriteScreenShot (char *name);
 
 void M_LoadDefaults (void);
 
@@ -1367,13 +1464,23 @@ int MN_TextBWidth(char *text);
  * ------
  */
 extern byte* screens[5];
-extern int dirtybox[4];
+
+/* drawn since the last I_FinishUpdate, x2 and y2 exclusive */
+#define MAXDIRTYRECTS	32
+typedef struct
+{
+  int		x1, y1, x2, y2;
+} dirtyrect_t;
+extern dirtyrect_t dirtyrects[MAXDIRTYRECTS];
+extern int numdirtyrects;
+
 extern byte gammatable[5][256];
 extern long usegamma;
 extern int bilifilter;
 extern int lifilter;
 
 void V_Init(void); /* Allocates buffer screens, call before R_Init */
+void V_MarkRect(int x, int y, int width, int height);
 void V_DrawPatch(int x, int y, patch_t *patch);
 void V_DrawFuzzPatch(int x, int y, patch_t *patch);
 void V_DrawShadowedPatch(int x, int y, patch_t *patch);
@@ -69,6 +69,8 @@ void F_StartFinale (void)
   finalestage = 0;
   finalecount = 0;
   FontABaseLump = W_GetNumForName("FONTA_S")+1;
+  
+  S_StartSong(mus_cptd, true);
 }
 
 
@@ -418,6 +420,7 @@ void F_Cast (void)
   void F_Drawer(void)
     {
       /* UpdateState |= I_FULLSCRN; */
+      V_MarkRect (0, 0, screenwidth, screenheight);
       if (!finalestage)
 	F_TextWrite ();
       else
@@ -0,0 +1,685 @@
+/* G_demo.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "doomdef.h"
+#include "p_local.h"
+
+/*
+  ==============================================================================
+
+  DEMO STREAMS
+
+  Demos are read and written through a small buffer instead of being held
+  in memory whole, so recordings have no length limit.  A demo given on the
+  command line is read from <name>.lmp (or <name>) if that file exists,
+  otherwise from the WAD lump <name>, which is streamed from the lump cache.
+
+  ==============================================================================
+*/
+
+#define DEMOBUFSIZE 4096
+#define DEMOHEADERSIZE (3+MAXPLAYERS) /* skill, episode, map, playeringame */
+#define DEMOTICSIZE 6                 /* bytes per player per tic */
+
+extern char *homedir;
+
+static FILE *demofp;        /* NULL while streaming a lump */
+static int demolump = -1;
+static byte demobuf[DEMOBUFSIZE];
+static byte *demodata;      /* demobuf, or the cached lump */
+static int demopos, demolen;
+static long demobase;       /* stream offset of demodata[0] */
+static boolean demowriting;
+static char demopath[256];  /* where the demo came from, for the keyframes */
+
+/*
+  ====================
+  =
+  = G_OpenDemoRead
+  =
+  ====================
+*/
+
+boolean G_OpenDemoRead (char *name)
+{
+  G_CloseDemo ();
+  sprintf (demopath, "%s.lmp", name);
+  demofp = fopen (demopath, "rb");
+  if (!demofp)
+    {
+      strcpy (demopath, name);
+      demofp = fopen (demopath, "rb");
+    }
+  demobase = demopos = demolen = 0;
+  demowriting = false;
+  if (demofp)
+    {
+      demodata = demobuf;
+      return true;
+    }
+
+  demolump = W_CheckNumForName (name);
+  if (demolump == -1)
+    return false;
+  demodata = W_CacheLumpNum (demolump, PU_STATIC);
+  demolen = W_LumpLength (demolump);
+  sprintf (demopath, "%s%s", homedir, name);
+  return true;
+}
+
+/*
+  ====================
+  =
+  = G_OpenDemoWrite
+  =
+  ====================
+*/
+
+void G_OpenDemoWrite (char *name)
+{
+  G_CloseDemo ();
+  demofp = fopen (name, "wb");
+  if (!demofp)
+    I_Error ("G_OpenDemoWrite: couldn't create %s", name);
+  strcpy (demopath, name);
+  demodata = demobuf;
+  demobase = demopos = demolen = 0;
+  demowriting = true;
+}
+
+static void G_FlushDemo (void)
+{
+  if (demopos && fwrite (demobuf, demopos, 1, demofp) != 1)
+    I_Error ("G_FlushDemo: write error");
+  demobase += demopos;
+  demopos = 0;
+}
+
+/*
+  ====================
+  =
+  = G_DemoReadByte
+  =
+  = Returns -1 at the end of the stream
+  =
+  ====================
+*/
+
+int G_DemoReadByte (void)
+{
+  if (demopos == demolen)
+    {
+      if (!demofp)
+	return -1;
+      demobase += demolen;
+      demopos = 0;
+      demolen = fread (demobuf, 1, DEMOBUFSIZE, demofp);
+      if (!demolen)
+	return -1;
+    }
+  return demodata[demopos++];
+}
+
+void G_DemoWriteByte (byte b)
+{
+  if (demopos == DEMOBUFSIZE)
+    G_FlushDemo ();
+  demobuf[demopos++] = b;
+}
+
+long G_DemoTell (void)
+{
+  return demobase+demopos;
+}
+
+/*
+  ====================
+  =
+  = G_DemoSeek
+  =
+  = Only for streams opened with G_OpenDemoRead
+  =
+  ====================
+*/
+
+void G_DemoSeek (long offset)
+{
+  if (!demofp)
+    {
+      demopos = offset < demolen ? offset : demolen;
+      return;
+    }
+  if (fseek (demofp, offset, SEEK_SET) == -1)
+    I_Error ("G_DemoSeek: can't seek to %li", offset);
+  demobase = offset;
+  demopos = demolen = 0;
+}
+
+/*
+  ====================
+  =
+  = G_DemoTic
+  =
+  = Number of tics read or written so far
+  =
+  ====================
+*/
+
+int G_DemoTic (void)
+{
+  int i, n;
+
+  for (i=n=0 ; i<MAXPLAYERS ; i++)
+    if (playeringame[i])
+      n++;
+  if (!n || G_DemoTell () < DEMOHEADERSIZE)
+    return 0;
+  return (G_DemoTell ()-DEMOHEADERSIZE)/(DEMOTICSIZE*n);
+}
+
+void G_CloseDemo (void)
+{
+  if (demofp)
+    {
+      if (demowriting)
+	G_FlushDemo ();
+      fclose (demofp);
+      demofp = NULL;
+    }
+  if (demolump != -1)
+    {
+      Z_ChangeTag (demodata, PU_CACHE);
+      demolump = -1;
+    }
+  demodata = NULL;
+  demopos = demolen = 0;
+}
+
+
+/*
+  ==============================================================================
+
+  DEMO KEYFRAMES
+
+  -demokeyframes [tics] stores an exact world snapshot (see p_snap.c) every
+  <tics> demo tics (default 350) in <demo>.dkf, while playing back or
+  recording.  -demoseek <tic> then restores the last keyframe at or before
+  <tic> and runs the remaining tics without drawing, so a long demo can be
+  played or timed from any point without replaying it from the start.
+
+  The keyframe file is a header (KEYFRAMEMAGIC, skill, episode, map)
+  followed by records of (tic, demo offset, length, snapshot).
+
+  ==============================================================================
+*/
+
+#define KEYFRAMEMAGIC 0x31464b48 /* "HKF1" */
+
+static FILE *keyframefp;
+static int keyframeinterval;
+static snapshot_t keyframe;
+
+static void G_KeyframeName (char *name)
+{
+  char *ext;
+
+  strcpy (name, demopath);
+  ext = strrchr (name, '.');
+  if (ext && !strcmp (ext, ".lmp"))
+    *ext = 0;
+  strcat (name, ".dkf");
+}
+
+static void G_WriteKeyframeInt (int val)
+{
+  fwrite (&val, sizeof(int), 1, keyframefp);
+}
+
+static int G_ReadKeyframeInt (FILE *fp)
+{
+  int val;
+
+  if (fread (&val, sizeof(int), 1, fp) != 1)
+    return -1;
+  return val;
+}
+
+/*
+  ====================
+  =
+  = G_SeekDemoKeyframe
+  =
+  ====================
+*/
+
+static void G_SeekDemoKeyframe (int tic)
+{
+  char name[280];
+  FILE *fp;
+  int kftic, offset, length;
+  int besttic, bestoffset, bestlength;
+  long bestpos;
+
+  G_KeyframeName (name);
+  fp = fopen (name, "rb");
+  if (!fp)
+    I_Error ("G_SeekDemoKeyframe: no keyframes in %s (use -demokeyframes)"
+	     , name);
+  if (G_ReadKeyframeInt (fp) != KEYFRAMEMAGIC
+      || G_ReadKeyframeInt (fp) != (int)gameskill
+      || G_ReadKeyframeInt (fp) != gameepisode
+      || G_ReadKeyframeInt (fp) != gamemap)
+    I_Error ("G_SeekDemoKeyframe: %s doesn't belong to this demo", name);
+
+  besttic = -1;
+  bestpos = 0;
+  bestoffset = bestlength = 0;
+  while ((kftic = G_ReadKeyframeInt (fp)) != -1)
+    {
+      offset = G_ReadKeyframeInt (fp);
+      length = G_ReadKeyframeInt (fp);
+      if (kftic <= tic && kftic > besttic)
+	{
+	  besttic = kftic;
+	  bestoffset = offset;
+	  bestlength = length;
+	  bestpos = ftell (fp);
+	}
+      fseek (fp, length, SEEK_CUR);
+    }
+
+  if (besttic != -1)
+    {
+      if ((size_t)bestlength > keyframe.size)
+	{
+	  keyframe.size = bestlength;
+	  keyframe.data = realloc (keyframe.data, keyframe.size);
+	  if (!keyframe.data)
+	    I_Error ("G_SeekDemoKeyframe: no memory");
+	}
+      fseek (fp, bestpos, SEEK_SET);
+      if (fread (keyframe.data, bestlength, 1, fp) != 1)
+	I_Error ("G_SeekDemoKeyframe: %s is truncated", name);
+      keyframe.length = bestlength;
+      P_RestoreWorld (&keyframe);
+      G_DemoSeek (bestoffset);
+    }
+  fclose (fp);
+  printf ("Demo keyframe at tic %i, running %i tics to %i.\n"
+	  , besttic == -1 ? 0 : besttic, tic-G_DemoTic(), tic);
+
+  while (demoplayback && G_DemoTic () < tic)
+    G_Ticker ();
+  starttime = I_GetTime ();
+  starttimems = I_GetTimeMS ();
+}
+
+/*
+  ====================
+  =
+  = G_StartDemoKeyframes
+  =
+  = Called once the demo's level is loaded
+  =
+  ====================
+*/
+
+void G_StartDemoKeyframes (void)
+{
+  char name[280];
+  int p;
+
+  p = M_CheckParm ("-demoseek");
+  if (p && p < myargc-1 && demoplayback)
+    {
+      G_SeekDemoKeyframe (atoi (myargv[p+1]));
+      return;
+    }
+
+  p = M_CheckParm ("-demokeyframes");
+  if (!p)
+    return;
+  keyframeinterval = p < myargc-1 ? atoi (myargv[p+1]) : 0;
+  if (keyframeinterval <= 0)
+    keyframeinterval = 10*TICRATE;
+  if (keyframefp)
+    fclose (keyframefp);
+  G_KeyframeName (name);
+  keyframefp = fopen (name, "wb");
+  if (!keyframefp)
+    I_Error ("G_StartDemoKeyframes: couldn't create %s", name);
+  G_WriteKeyframeInt (KEYFRAMEMAGIC);
+  G_WriteKeyframeInt (gameskill);
+  G_WriteKeyframeInt (gameepisode);
+  G_WriteKeyframeInt (gamemap);
+}
+
+/*
+  ====================
+  =
+  = G_CheckDemoKeyframe
+  =
+  = Called by G_Ticker at the end of a level tic
+  =
+  ====================
+*/
+
+void G_CheckDemoKeyframe (void)
+{
+  int tic;
+
+  if (!keyframefp || (!demoplayback && !demorecording)
+      || gameaction != ga_nothing)
+    return;
+  tic = G_DemoTic ();
+  if (tic % keyframeinterval)
+    return;
+  P_SnapshotWorld (&keyframe);
+  G_WriteKeyframeInt (tic);
+  G_WriteKeyframeInt (G_DemoTell ());
+  G_WriteKeyframeInt (keyframe.length);
+  if (fwrite (keyframe.data, keyframe.length, 1, keyframefp) != 1)
+    I_Error ("G_CheckDemoKeyframe: write error");
+}
+
+void G_StopDemoKeyframes (void)
+{
+  if (keyframefp)
+    {
+      fclose (keyframefp);
+      keyframefp = NULL;
+    }
+}
+
+
+/*
+  ==============================================================================
+
+  STATE HASHES
+
+  -statehash <file> hashes the world at the end of every level tic and
+  writes one record per tic to <file>.  -statecheck <file> computes the
+  same hashes and compares them with <file>, stopping at the first tic
+  that differs and naming the mobj or sector that diverged.  Record a
+  reference with an unmodified binary, then check every playsim change
+  against it by playing the same demos.
+
+  A record is (tic, hash, prndindex, number of mobjs, number of moving
+  sectors), then a hash per mobj in thinker order and a (sector, hash)
+  pair per sector with an active mover.  The tic-wide hash covers all of
+  that plus the heights of every sector.
+
+  ==============================================================================
+*/
+
+extern int prndindex;
+
+#define HASHMIX(h,v) ((h) = ((h)^(unsigned)(v))*16777619u)
+
+typedef struct
+{
+  int tic;
+  unsigned hash;
+  int rng;
+  int nummobjs;
+  int nummovers;
+} hashrecord_t;
+
+static FILE *statehashfp;
+static boolean statecheck;
+static int statetic;
+static hashrecord_t staterec;
+static unsigned *statemobjs;      /* per mobj hashes of this tic */
+static int *statemovers;          /* sector, hash pairs */
+static int statesize;             /* room in both, in entries */
+static unsigned *refmobjs;        /* the same, read from the reference */
+static int *refmovers;
+static int refsize;
+
+static void G_ReadStateHash (hashrecord_t *ref);
+
+/*
+  ====================
+  =
+  = G_InitStateHash
+  =
+  ====================
+*/
+
+void G_InitStateHash (void)
+{
+  int p;
+
+  p = M_CheckParm ("-statehash");
+  if (!p)
+    {
+      p = M_CheckParm ("-statecheck");
+      statecheck = true;
+    }
+  if (!p || p >= myargc-1)
+    {
+      statecheck = false;
+      return;
+    }
+  statehashfp = fopen (myargv[p+1], statecheck ? "rb" : "wb");
+  if (!statehashfp)
+    I_Error ("G_InitStateHash: couldn't open %s", myargv[p+1]);
+}
+
+static void G_GrowStateHash (int count)
+{
+  if (count <= statesize)
+    return;
+  statesize = count*2;
+  statemobjs = realloc (statemobjs, statesize*sizeof(*statemobjs));
+  statemovers = realloc (statemovers, statesize*2*sizeof(*statemovers));
+  if (!statemobjs || !statemovers)
+    I_Error ("G_GrowStateHash: no memory");
+}
+
+static unsigned G_HashMobj (mobj_t *mo)
+{
+  unsigned h;
+
+  h = 2166136261u;
+  HASHMIX (h, mo->type);
+  HASHMIX (h, mo->x);
+  HASHMIX (h, mo->y);
+  HASHMIX (h, mo->z);
+  HASHMIX (h, mo->momx);
+  HASHMIX (h, mo->momy);
+  HASHMIX (h, mo->momz);
+  HASHMIX (h, mo->angle);
+  HASHMIX (h, mo->health);
+  HASHMIX (h, mo->state-states);
+  return h;
+}
+
+/*
+  ====================
+  =
+  = G_HashWorld
+  =
+  = Fills staterec, statemobjs and statemovers for this tic
+  =
+  ====================
+*/
+
+static void G_HashWorld (void)
+{
+  thinker_t *th;
+  sector_t *sec;
+  unsigned h, sh;
+  int i, n;
+
+  n = 0;
+  for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    n++;
+  if (numsectors > n)
+    n = numsectors;
+  G_GrowStateHash (n);
+
+  h = 2166136261u;
+  HASHMIX (h, prndindex);
+  staterec.nummobjs = 0;
+  for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+      if (th->function.acp1 != (actionf_p1)P_MobjThinker
+	  && th->function.acp1 != (actionf_p1)P_BlasterMobjThinker)
+	continue;
+      statemobjs[staterec.nummobjs] = G_HashMobj ((mobj_t *)th);
+      HASHMIX (h, statemobjs[staterec.nummobjs]);
+      staterec.nummobjs++;
+    }
+  staterec.nummovers = 0;
+  for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+      HASHMIX (h, sec->floorheight);
+      HASHMIX (h, sec->ceilingheight);
+      if (!sec->specialdata)
+	continue;
+      sh = 2166136261u;
+      HASHMIX (sh, sec->floorheight);
+      HASHMIX (sh, sec->ceilingheight);
+      statemovers[staterec.nummovers*2] = i;
+      statemovers[staterec.nummovers*2+1] = sh;
+      staterec.nummovers++;
+    }
+  staterec.tic = statetic;
+  staterec.hash = h;
+  staterec.rng = prndindex;
+}
+
+/*
+  ====================
+  =
+  = G_StateDivergence
+  =
+  = Names the first thing that differs from the reference record <ref>
+  =
+  ====================
+*/
+
+static void G_StateDivergence (hashrecord_t *ref)
+{
+  thinker_t *th;
+  mobj_t *mo;
+  int i;
+
+  if (ref->rng != staterec.rng)
+    I_Error ("statecheck: tic %i diverged: prndindex %i should be %i"
+	     , statetic, staterec.rng, ref->rng);
+  i = 0;
+  for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+      if (th->function.acp1 != (actionf_p1)P_MobjThinker
+	  && th->function.acp1 != (actionf_p1)P_BlasterMobjThinker)
+	continue;
+      if (i >= ref->nummobjs || statemobjs[i] != refmobjs[i])
+	{
+	  mo = (mobj_t *)th;
+	  I_Error ("statecheck: tic %i diverged: mobj %i (type %i at %i,%i,"
+		   "health %i)%s", statetic, i, mo->type, mo->x>>FRACBITS
+		   , mo->y>>FRACBITS, mo->health
+		   , i >= ref->nummobjs ? " doesn't exist in the reference" : "");
+	}
+      i++;
+    }
+  if (i != ref->nummobjs)
+    I_Error ("statecheck: tic %i diverged: %i mobjs, reference has %i"
+	     , statetic, i, ref->nummobjs);
+  for (i=0 ; i<staterec.nummovers && i<ref->nummovers ; i++)
+    if (statemovers[i*2] != refmovers[i*2]
+	|| statemovers[i*2+1] != refmovers[i*2+1])
+      break;
+  if (i < staterec.nummovers || i < ref->nummovers)
+    I_Error ("statecheck: tic %i diverged: sector %i", statetic
+	     , i < staterec.nummovers ? statemovers[i*2] : refmovers[i*2]);
+  I_Error ("statecheck: tic %i diverged: sector heights", statetic);
+}
+
+/*
+  ====================
+  =
+  = G_CheckStateHash
+  =
+  = Called by G_Ticker at the end of a level tic
+  =
+  ====================
+*/
+
+void G_CheckStateHash (void)
+{
+  hashrecord_t ref;
+
+  if (!statehashfp)
+    return;
+  /* Demo tics, so a check can start from a keyframe */
+  statetic = demoplayback || demorecording ? G_DemoTic () : statetic+1;
+  G_HashWorld ();
+  if (!statecheck)
+    {
+      fwrite (&staterec, sizeof(staterec), 1, statehashfp);
+      fwrite (statemobjs, sizeof(*statemobjs), staterec.nummobjs, statehashfp);
+      fwrite (statemovers, 2*sizeof(*statemovers), staterec.nummovers
+	      , statehashfp);
+      return;
+    }
+
+  do
+    G_ReadStateHash (&ref);
+  while (ref.tic < statetic);
+  if (ref.tic != statetic)
+    I_Error ("statecheck: reference is out of step at tic %i", statetic);
+  if (ref.hash != staterec.hash)
+    G_StateDivergence (&ref);
+}
+
+/*
+  ====================
+  =
+  = G_ReadStateHash
+  =
+  ====================
+*/
+
+static void G_ReadStateHash (hashrecord_t *ref)
+{
+  if (fread (ref, sizeof(*ref), 1, statehashfp) != 1)
+    I_Error ("statecheck: reference ends before tic %i", statetic);
+  if (ref->nummobjs > refsize || ref->nummovers > refsize)
+    {
+      refsize = ref->nummobjs > ref->nummovers ? ref->nummobjs
+	: ref->nummovers;
+      refsize *= 2;
+      refmobjs = realloc (refmobjs, refsize*sizeof(*refmobjs));
+      refmovers = realloc (refmovers, refsize*2*sizeof(*refmovers));
+      if (!refmobjs || !refmovers)
+	I_Error ("G_CheckStateHash: no memory");
+    }
+  if (fread (refmobjs, sizeof(*refmobjs), ref->nummobjs, statehashfp)
+      != (size_t)ref->nummobjs
+      || fread (refmovers, 2*sizeof(*refmovers), ref->nummovers, statehashfp)
+      != (size_t)ref->nummovers)
+    I_Error ("statecheck: reference is truncated at tic %i", statetic);
+}
+
+/*
+  ====================
+  =
+  = G_StopStateHash
+  =
+  ====================
+*/
+
+void G_StopStateHash (void)
+{
+  if (!statehashfp)
+    return;
+  printf ("statehash: %i tics, final hash %08x%s\n", statetic, staterec.hash
+	  , statecheck ? ", all match" : "");
+  fclose (statehashfp);
+  statehashfp = NULL;
+}
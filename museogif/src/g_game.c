@@ -2,7 +2,9 @@
 /* G_game.c */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "doomdef.h"
 #include "p_local.h"
 #include "soundst.h"
@@ -32,9 +34,12 @@ void G_DoCompleted (void);
 void G_DoVictory (void);
 void G_DoWorldDone (void);
 void G_DoSaveGame (void);
+static void G_ArchiveHeader(char *description);
 
 void D_PageTicker(void);
 void D_AdvanceDemo(void);
+void D_StartTitle(void);
+void D_Display(void);
 
 struct
 {
@@ -77,6 +82,7 @@ boolean         usergame;               /* ok to save / end game */
 
 boolean         timingdemo;             /* if true, exit with report on completion */
 int             starttime;              /* for comparative timing purposes */
+int             starttimems;            /* the same for -fastdemo */
 
 boolean         viewactive;
 
@@ -94,7 +100,6 @@ int             totalkills, totalitems, totalsecret;    /* for intermission */
 char            demoname[32];
 boolean         demorecording;
 boolean         demoplayback;
-byte            *demobuffer, *demo_p;
 boolean         singledemo;             /* quit after playing a demo from cmdline */
 
 boolean         precache = true;        /* if true, load all graphics at start */
@@ -102,6 +107,8 @@ boolean         precache = true;        /* if true, load all graphics at start *
 short            consistancy[MAXPLAYERS][BACKUPTICS];
 
 byte            *savebuffer, *save_p;
+static byte     *saveend;               /* end of savebuffer with SVG_RAM */
+static boolean  saveoverrun;            /* a write didn't fit, and was dropped */
 
 extern char* homedir;
 
@@ -539,9 +546,12 @@ void G_DoLoadLevel (void)
       memset (players[i].frags,0,sizeof(players[i].frags));
     }
   
+  G_WaitAutoSave ();
   P_SetupLevel (gameepisode, gamemap, 0, gameskill);
+  G_ReserveAutoSave ();
   displayplayer = consoleplayer;  /* view the guy you are playing */
   starttime = I_GetTime ();
+  starttimems = I_GetTimeMS ();
   gameaction = ga_nothing;
   Z_CheckHeap ();
   
@@ -859,6 +869,9 @@ void G_Ticker (void)
       P_Ticker ();
       SB_Ticker ();
       AM_Ticker ();
+      G_CheckAutoSave ();
+      G_CheckDemoKeyframe ();
+      G_CheckStateHash ();
       break;
     case GS_INTERMISSION:
       IN_Ticker ();
@@ -1286,14 +1299,22 @@ void G_DoLoadGame(void)
   char vcheck[VERSIONSIZE];
   
   gameaction = ga_nothing;
+  G_WaitAutoSave();
   
   /*length = */M_ReadFile(savename, &savebuffer);
   save_p = savebuffer+SAVESTRINGSIZE;
   /* Skip the description field */
   memset(vcheck, 0, sizeof(vcheck));
-  sprintf(vcheck, "version %i", VERSION);
+  sprintf(vcheck, "version %i", SAVEVERSION);
   if (strcmp ((char*)save_p, vcheck))
     { /* Bad version */
+      fprintf(stderr, "G_DoLoadGame: %s is from another version\n", savename);
+      Z_Free(savebuffer);
+      if(!usergame && !demoplayback)
+	{ /* -loadgame at startup, nothing to go back to */
+	  gamestate = GS_DEMOSCREEN;
+	  D_StartTitle();
+	}
       return;
     }
   save_p += VERSIONSIZE;
@@ -1318,6 +1339,7 @@ void G_DoLoadGame(void)
   P_UnArchiveWorld();
   P_UnArchiveThinkers();
   P_UnArchiveSpecials();
+  P_ScheduleSpecials();
   
   if(*save_p != SAVE_GAME_TERMINATOR)
     { /* Missing savegame termination marker */
@@ -1457,31 +1479,34 @@ void G_InitNew(skill_t skill, int episode, int map)
 
 void G_ReadDemoTiccmd (ticcmd_t *cmd)
 {
-  if (*demo_p == DEMOMARKER)
+  int             c;
+  
+  c = G_DemoReadByte ();
+  if (c == DEMOMARKER || c == -1)
     {       /* end of demo data stream */
       G_CheckDemoStatus ();
       return;
     }
-  cmd->forwardmove = ((signed char)*demo_p++);
-  cmd->sidemove = ((signed char)*demo_p++);
-  cmd->angleturn = ((unsigned char)*demo_p++)<<8;
-  cmd->buttons = (unsigned char)*demo_p++;
-  cmd->lookfly = (unsigned char)*demo_p++;
-  cmd->arti = (unsigned char)*demo_p++;
+  cmd->forwardmove = (signed char)c;
+  cmd->sidemove = (signed char)G_DemoReadByte ();
+  cmd->angleturn = ((unsigned char)G_DemoReadByte ())<<8;
+  cmd->buttons = (unsigned char)G_DemoReadByte ();
+  cmd->lookfly = (unsigned char)G_DemoReadByte ();
+  cmd->arti = (unsigned char)G_DemoReadByte ();
 }
 
 void G_WriteDemoTiccmd (ticcmd_t *cmd)
 {
   if (gamekeydown['q'])           /* press q to end demo recording */
     G_CheckDemoStatus ();
-  *demo_p++ = cmd->forwardmove;
-  *demo_p++ = cmd->sidemove;
-  *demo_p++ = cmd->angleturn>>8;
-  *demo_p++ = cmd->buttons;
-  *demo_p++ = cmd->lookfly;
-  *demo_p++ = cmd->arti;
-  demo_p -= 6;
-  G_ReadDemoTiccmd (cmd);         /* make SURE it is exactly the same */
+  G_DemoWriteByte (cmd->forwardmove);
+  G_DemoWriteByte (cmd->sidemove);
+  G_DemoWriteByte (cmd->angleturn>>8);
+  G_DemoWriteByte (cmd->buttons);
+  G_DemoWriteByte (cmd->lookfly);
+  G_DemoWriteByte (cmd->arti);
+  /* make SURE it is exactly what playback will read */
+  cmd->angleturn = ((unsigned char)(cmd->angleturn>>8))<<8;
 }
 
 
@@ -1502,15 +1527,16 @@ void G_RecordDemo (skill_t skill, int __attribute__((unused)) numplayers, int ep
   usergame = false;
   strcpy (demoname, name);
   strcat (demoname, ".lmp");
-  demobuffer = demo_p = Z_Malloc (0x20000,PU_STATIC,NULL);
-  *demo_p++ = skill;
-  *demo_p++ = episode;
-  *demo_p++ = map;
+  G_OpenDemoWrite (demoname);
+  G_DemoWriteByte (skill);
+  G_DemoWriteByte (episode);
+  G_DemoWriteByte (map);
   
   for (i=0 ; i<MAXPLAYERS ; i++)
-    *demo_p++ = playeringame[i];
+    G_DemoWriteByte (playeringame[i]);
   
   demorecording = true;
+  G_StartDemoKeyframes ();
 }
 
 
@@ -1536,19 +1562,21 @@ void G_DoPlayDemo (void)
   int             i, episode, map;
   
   gameaction = ga_nothing;
-  demobuffer = demo_p = W_CacheLumpName (defdemoname, PU_STATIC);
-  skill = *demo_p++;
-  episode = *demo_p++;
-  map = *demo_p++;
+  if (!G_OpenDemoRead (defdemoname))
+    I_Error ("G_DoPlayDemo: demo %s not found", defdemoname);
+  skill = G_DemoReadByte ();
+  episode = G_DemoReadByte ();
+  map = G_DemoReadByte ();
   
   for (i=0 ; i<MAXPLAYERS ; i++)
-    playeringame[i] = *demo_p++;
+    playeringame[i] = G_DemoReadByte ();
   
   precache = false;               /* don't spend a lot of time in loadlevel */
   G_InitNew (skill, episode, map);
   precache = true;
   usergame = false;
   demoplayback = true;
+  G_StartDemoKeyframes ();
 }
 
 
@@ -1563,17 +1591,23 @@ void G_DoPlayDemo (void)
 void G_TimeDemo (char *name)
 {
   skill_t         skill;
-  int             episode, map;
+  int             i, episode, map;
+  
+  if (!G_OpenDemoRead (name))
+    I_Error ("G_TimeDemo: demo %s not found", name);
+  skill = G_DemoReadByte ();
+  episode = G_DemoReadByte ();
+  map = G_DemoReadByte ();
+  
+  for (i=0 ; i<MAXPLAYERS ; i++)
+    playeringame[i] = G_DemoReadByte ();
   
-  demobuffer = demo_p = W_CacheLumpName (name, PU_STATIC);
-  skill = *demo_p++;
-  episode = *demo_p++;
-  map = *demo_p++;
   G_InitNew (skill, episode, map);
   usergame = false;
   demoplayback = true;
   timingdemo = true;
   singletics = true;
+  G_StartDemoKeyframes ();
 }
 
 
@@ -1591,9 +1625,26 @@ boolean G_CheckDemoStatus (void)
 {
   int             endtime;
   
+  G_StopDemoKeyframes ();
+  G_StopStateHash ();
+  if (drawfinal && demoplayback && (timingdemo || singledemo))
+    {
+      D_Display ();
+      if (drawfinalname)
+	M_WriteScreenShot (drawfinalname);
+      else
+	M_ScreenShot ();
+    }
   if (timingdemo)
     {
       endtime = I_GetTime ();
+      if (nodraw)
+	{
+	  endtime = I_GetTimeMS ()-starttimems;
+	  printf ("fastdemo: %i gametics in %i ms, %.1f tics/sec\n", gametic
+		  , endtime, endtime ? gametic*1000.0/endtime : 0.0);
+	  I_Quit ();
+	}
       I_Error ("timed %i gametics in %i realtics",gametic
 	       , endtime-starttime);
     }
@@ -1603,7 +1654,7 @@ boolean G_CheckDemoStatus (void)
       if (singledemo)
 	I_Quit ();
       
-      Z_ChangeTag (demobuffer, PU_CACHE);
+      G_CloseDemo ();
       demoplayback = false;
       D_AdvanceDemo ();
       return true;
@@ -1611,9 +1662,8 @@ boolean G_CheckDemoStatus (void)
   
   if (demorecording)
     {
-      *demo_p++ = DEMOMARKER;
-      M_WriteFile (demoname, demobuffer, demo_p - demobuffer);
-      Z_Free (demobuffer);
+      G_DemoWriteByte (DEMOMARKER);
+      G_CloseDemo ();
       demorecording = false;
       I_Error ("Demo %s recorded",demoname);
     }
@@ -1653,11 +1703,10 @@ void G_SaveGame(int slot, char *description)
 */
 void G_DoSaveGame(void)
 {
-  int i;
   char name[100];
-  char verString[VERSIONSIZE];
   char *description;
   
+  G_WaitAutoSave();
   if(cdrom)
     {
       sprintf(name, SAVEGAMENAMECD"%d.hsg", savegameslot);
@@ -1669,9 +1718,36 @@ void G_DoSaveGame(void)
   description = savedescription;
   
   SV_Open(name);
+  G_ArchiveHeader(description);
+  P_ArchivePlayers();
+  P_ArchiveWorld();
+  P_ArchiveThinkers();
+  P_ArchiveSpecials();
+  SV_Close(name);
+  
+  gameaction = ga_nothing;
+  savedescription[0] = 0;
+  P_SetMessage(&players[consoleplayer], TXT_GAMESAVED, true);
+}
+
+
+/*
+  //==========================================================================
+  //
+  // G_ArchiveHeader
+  //
+  // Writes the description, version and level header of a savegame.
+  //
+  //==========================================================================
+*/
+static void G_ArchiveHeader(char *description)
+{
+  int i;
+  char verString[VERSIONSIZE];
+  
   SV_Write(description, SAVESTRINGSIZE);
   memset(verString, 0, sizeof(verString));
-  sprintf(verString, "version %i", VERSION);
+  sprintf(verString, "version %i", SAVEVERSION);
   SV_Write(verString, VERSIONSIZE);
   SV_WriteByte(gameskill);
   SV_WriteByte(gameepisode);
@@ -1683,15 +1759,6 @@ void G_DoSaveGame(void)
   SV_WriteByte(leveltime>>16);
   SV_WriteByte(leveltime>>8);
   SV_WriteByte(leveltime);
-  P_ArchivePlayers();
-  P_ArchiveWorld();
-  P_ArchiveThinkers();
-  P_ArchiveSpecials();
-  SV_Close(name);
-  
-  gameaction = ga_nothing;
-  savedescription[0] = 0;
-  P_SetMessage(&players[consoleplayer], TXT_GAMESAVED, true);
 }
 
 
@@ -1715,6 +1782,8 @@ void SV_Open(char *fileName)
   else
     {
       SaveGameType = SVG_RAM;
+      saveend = savebuffer+SAVEGAMESIZE;
+      saveoverrun = false;
     }
 }
 
@@ -1733,11 +1802,11 @@ void SV_Close(char *fileName)
   SV_WriteByte(SAVE_GAME_TERMINATOR);
   if(SaveGameType == SVG_RAM)
     {
-      length = save_p-savebuffer;
-      if(length > SAVEGAMESIZE)
+      if(saveoverrun)
 	{
 	  I_Error("Savegame buffer overrun");
 	}
+      length = save_p-savebuffer;
       M_WriteFile(fileName, savebuffer, length);
       Z_Free(savebuffer);
     }
@@ -1753,12 +1822,20 @@ void SV_Close(char *fileName)
   //
   // SV_Write
   //
+  // In RAM a write past saveend is dropped and sets saveoverrun, for the
+  // caller to check once it's done.
+  //
   //==========================================================================
 */
 void SV_Write(void *buffer, size_t size)
 {
   if(SaveGameType == SVG_RAM)
     {
+      if(size > (size_t)(saveend-save_p))
+	{
+	  saveoverrun = true;
+	  return;
+	}
       memcpy(save_p, buffer, size);
       save_p += size;
     }
@@ -1784,4 +1861,346 @@ void SV_WriteLong(unsigned int val)
 }
 
 
+/*
+  //==========================================================================
+  //
+  // AUTOSAVE
+  //
+  // With -autosave the level is saved every few minutes without a hitch.
+  // At a tic boundary G_CheckAutoSave copies the level into a preallocated
+  // arena: the savegame header, players and thinkers in their archived
+  // form, and the sector, line and side arrays as raw copies.  A worker
+  // thread then archives the world from those copies and writes the file,
+  // so the game thread only pays for the memcpy.
+  //
+  // The worker borrows savebuffer/save_p, so everything else that uses
+  // the SV_ routines calls G_WaitAutoSave first.  The worker never touches
+  // the zone or the live level.
+  //
+  //==========================================================================
+*/
+
+#define AUTOSAVESLOT 'a' /* -loadgame a */
+
+static int autosaveinterval;       /* tics between saves, 0 = disabled */
+static int autosavenext;           /* gametic of the next save */
+static char autosavename[256];
+
+static byte *autosavearena;        /* snapshot taken by the game thread */
+static size_t autosavearenasize;
+static byte *autosaveout;          /* finished savegame, built by the worker */
+static size_t autosaveoutsize;
+static size_t autosavehead;        /* header + players, at arena start */
+static sector_t *autosavesectors;  /* raw copies inside the arena */
+static line_t *autosavelines;
+static side_t *autosavesides;
+static int autosavenumsectors, autosavenumlines;
+static byte *autosavetail;         /* thinkers + specials + terminator */
+static size_t autosavetaillen;
+
+static pthread_t autosavethread;
+static pthread_mutex_t autosavelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t autosavecond = PTHREAD_COND_INITIALIZER;
+static boolean autosavebusy;
 
+/*
+  //==========================================================================
+  //
+  // G_WriteAutoSave
+  //
+  // Runs on the worker thread.
+  //
+  //==========================================================================
+*/
+static void G_WriteAutoSave(void)
+{
+  char tempname[260];
+  int length;
+  
+  SaveGameType = SVG_RAM;
+  save_p = savebuffer = autosaveout;
+  saveend = autosaveout+autosaveoutsize;
+  saveoverrun = false;
+  SV_Write(autosavearena, autosavehead);
+  P_ArchiveWorldFrom(autosavesectors, autosavenumsectors,
+		     autosavelines, autosavenumlines, autosavesides);
+  SV_Write(autosavetail, autosavetaillen);
+  length = save_p-savebuffer;
+  save_p = savebuffer = NULL;
+  if(saveoverrun)
+    {
+      fprintf(stderr, "G_WriteAutoSave: savegame too big, not written\n");
+      return;
+    }
+  
+  /* Write beside the old save and rename, so a crash keeps the last one */
+  sprintf(tempname, "%s.tmp", autosavename);
+  if(!M_WriteFile(tempname, autosaveout, length)
+     || rename(tempname, autosavename) == -1)
+    {
+      fprintf(stderr, "G_WriteAutoSave: couldn't write %s\n", autosavename);
+    }
+}
+
+static void *G_AutoSaveThread(void __attribute__((unused)) *arg)
+{
+  pthread_mutex_lock(&autosavelock);
+  for(;;)
+    {
+      while(!autosavebusy)
+	{
+	  pthread_cond_wait(&autosavecond, &autosavelock);
+	}
+      pthread_mutex_unlock(&autosavelock);
+      G_WriteAutoSave();
+      pthread_mutex_lock(&autosavelock);
+      autosavebusy = false;
+      pthread_cond_broadcast(&autosavecond);
+    }
+  return NULL;
+}
+
+/*
+  //==========================================================================
+  //
+  // G_InitAutoSave
+  //
+  // Called by the startup code for -autosave [minutes].
+  //
+  //==========================================================================
+*/
+void G_InitAutoSave(int minutes)
+{
+  if(minutes <= 0)
+    {
+      minutes = 5;
+    }
+  if(cdrom)
+    {
+      sprintf(autosavename, SAVEGAMENAMECD"%c.hsg", AUTOSAVESLOT);
+    }
+  else
+    {
+      sprintf(autosavename, "%s"SAVEGAMENAME"%c.hsg", homedir, AUTOSAVESLOT);
+    }
+  if(pthread_create(&autosavethread, NULL, G_AutoSaveThread, NULL))
+    {
+      fprintf(stderr, "G_InitAutoSave: no thread, autosave disabled\n");
+      return;
+    }
+  autosaveinterval = minutes*60*TICRATE;
+  autosavenext = gametic+autosaveinterval;
+}
+
+/*
+  //==========================================================================
+  //
+  // G_WaitAutoSave
+  //
+  // Blocks until the worker is idle.
+  //
+  //==========================================================================
+*/
+void G_WaitAutoSave(void)
+{
+  if(!autosaveinterval)
+    {
+      return;
+    }
+  pthread_mutex_lock(&autosavelock);
+  while(autosavebusy)
+    {
+      pthread_cond_wait(&autosavecond, &autosavelock);
+    }
+  pthread_mutex_unlock(&autosavelock);
+}
+
+/*
+  //==========================================================================
+  //
+  // G_AutoSaveSizes
+  //
+  // Upper bounds of the arena and output buffer for thinkers that
+  // archive to <thinkerbytes>.
+  //
+  //==========================================================================
+*/
+static void G_AutoSaveSizes(size_t thinkerbytes, size_t *arena, size_t *out)
+{
+  size_t head, tail;
+  
+  head = SAVESTRINGSIZE+VERSIONSIZE+3+MAXPLAYERS+3
+    +MAXPLAYERS*sizeof(player_t);
+  tail = thinkerbytes+3;
+  *arena = head+7+tail+numsectors*sizeof(sector_t)
+    +numlines*sizeof(line_t)+numsides*sizeof(side_t);
+  *out = head+tail+numsectors*7*2+numlines*13*2;
+}
+
+static void G_GrowAutoSave(size_t arena, size_t out)
+{
+  if(arena > autosavearenasize)
+    {
+      free(autosavearena);
+      autosavearena = malloc(arena);
+      autosavearenasize = arena;
+    }
+  if(out > autosaveoutsize)
+    {
+      free(autosaveout);
+      autosaveout = malloc(out);
+      autosaveoutsize = out;
+    }
+  if(!autosavearena || !autosaveout)
+    {
+      I_Error("G_GrowAutoSave: couldn't allocate %lu bytes",
+	      (unsigned long)(arena+out));
+    }
+}
+
+/*
+ * Upper bound of what the thinkers archive to.  A light batch writes a
+ * record per effect, and mobj_t is the largest of the other thinkers.
+ */
+static size_t G_ThinkerBytes(void)
+{
+  thinker_t *th;
+  lightbatch_t *batch;
+  size_t bytes;
+  
+  bytes = 0;
+  for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+      if(th->function.acp1 == (actionf_p1)T_LightBatch)
+	{
+	  batch = (lightbatch_t *)th;
+	  bytes += batch->numflashes*(1+sizeof(lightflash_t))
+	    +batch->numstrobes*(1+sizeof(strobe_t))
+	    +batch->numglows*(1+sizeof(glow_t));
+	}
+      else
+	{
+	  bytes += 1+sizeof(mobj_t);
+	}
+    }
+  return bytes;
+}
+
+/*
+  //==========================================================================
+  //
+  // G_ReserveAutoSave
+  //
+  // Called at level load, allocates room for twice the starting thinkers
+  // so the arena rarely has to grow during play.
+  //
+  //==========================================================================
+*/
+void G_ReserveAutoSave(void)
+{
+  size_t arena, out;
+  
+  if(!autosaveinterval)
+    {
+      return;
+    }
+  G_AutoSaveSizes(2*G_ThinkerBytes(), &arena, &out);
+  G_GrowAutoSave(arena, out);
+}
+
+/*
+  //==========================================================================
+  //
+  // G_SnapshotAutoSave
+  //
+  // Copies the level into the arena.  False if it didn't fit.
+  //
+  //==========================================================================
+*/
+static boolean G_SnapshotAutoSave(void)
+{
+  byte *p;
+  char description[SAVESTRINGSIZE];
+  
+  SaveGameType = SVG_RAM;
+  save_p = savebuffer = autosavearena;
+  saveend = autosavearena+autosavearenasize;
+  saveoverrun = false;
+  memset(description, 0, sizeof(description));
+  strcpy(description, "AUTOSAVE");
+  G_ArchiveHeader(description);
+  P_ArchivePlayers();
+  autosavehead = save_p-savebuffer;
+  
+  p = autosavearena+((autosavehead+7)&~7);
+  autosavesectors = (sector_t *)p;
+  memcpy(p, sectors, numsectors*sizeof(sector_t));
+  p += numsectors*sizeof(sector_t);
+  autosavelines = (line_t *)p;
+  memcpy(p, lines, numlines*sizeof(line_t));
+  p += numlines*sizeof(line_t);
+  autosavesides = (side_t *)p;
+  memcpy(p, sides, numsides*sizeof(side_t));
+  p += numsides*sizeof(side_t);
+  autosavenumsectors = numsectors;
+  autosavenumlines = numlines;
+  
+  save_p = autosavetail = p;
+  P_ArchiveThinkers();
+  P_ArchiveSpecials();
+  SV_WriteByte(SAVE_GAME_TERMINATOR);
+  autosavetaillen = save_p-autosavetail;
+  save_p = savebuffer = NULL;
+  return !saveoverrun;
+}
+
+/*
+  //==========================================================================
+  //
+  // G_CheckAutoSave
+  //
+  // Called by G_Ticker at the end of a level tic.
+  //
+  //==========================================================================
+*/
+void G_CheckAutoSave(void)
+{
+  size_t arena, out;
+  boolean busy;
+  
+  if(!autosaveinterval || gametic < autosavenext
+     || !usergame || demoplayback || netgame || paused
+     || gameaction != ga_nothing || players[consoleplayer].health <= 0)
+    {
+      return;
+    }
+  pthread_mutex_lock(&autosavelock);
+  busy = autosavebusy;
+  pthread_mutex_unlock(&autosavelock);
+  if(busy)
+    { /* Still writing the last one, try again next tic */
+      return;
+    }
+  autosavenext = gametic+autosaveinterval;
+  
+  G_AutoSaveSizes(G_ThinkerBytes(), &arena, &out);
+  if(arena > autosavearenasize || out > autosaveoutsize)
+    {
+      G_AutoSaveSizes(2*G_ThinkerBytes(), &arena, &out);
+      G_GrowAutoSave(arena, out);
+    }
+  
+  /* The thinkers may outgrow the estimate, then grow and take it again */
+  while(!G_SnapshotAutoSave())
+    {
+      G_GrowAutoSave(2*autosavearenasize, 0);
+    }
+  out = autosavehead+autosavenumsectors*7*2+autosavenumlines*13*2
+    +autosavetaillen;
+  G_GrowAutoSave(0, out);
+  
+  pthread_mutex_lock(&autosavelock);
+  autosavebusy = true;
+  pthread_cond_signal(&autosavecond);
+  pthread_mutex_unlock(&autosavelock);
+}
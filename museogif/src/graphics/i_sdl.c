@@ -18,6 +18,15 @@ static int ticcount;
 SDL_Surface* sdl_screen;
 int grabMouse;
 
+/*
+ * What the display shows.  I_FinishUpdate compares the dirty rects
+ *  against it and hands SDL only the rows and columns that really
+ *  changed, so a menu, the intermission or a paused game redrawn with
+ *  the same pixels costs no conversion or upload at all.
+ */
+static byte *lastframe;
+static boolean fullupdate;
+
 /*
  *--------------------------------------------------------------------------
  *
@@ -34,6 +43,8 @@ void I_SetPalette(byte *palette)
     SDL_Color* cend;
     SDL_Color cmap[ 256 ];
     
+    if(novideo)
+	return;
     I_WaitVBL(1);
     
     c = cmap;
@@ -45,6 +56,8 @@ void I_SetPalette(byte *palette)
 	    c->b = gammatable[usegamma][*palette++];
 	}
     SDL_SetColors( sdl_screen, cmap, 0, 256 );
+    /* every pixel on the display changes, whatever screen[] holds */
+    fullupdate = true;
 }
 
 /*
@@ -68,12 +81,56 @@ byte *destview;
 int UpdateState;
 extern int screenblocks;
 
+#define MAXUPDATERECTS	64
+static SDL_Rect updaterects[MAXUPDATERECTS];
+
+/*
+ * Adds the span x1..x2-1 of row y to the update rects, growing the last
+ *  one if it overlaps the row above.  With the list full, the last one
+ *  takes everything.
+ */
+static int AddUpdateRow (int numrects, int x1, int x2, int y)
+{
+    SDL_Rect *r;
+    int y1, y2;
+
+    if(numrects) {
+	r = &updaterects[numrects-1];
+	if(numrects == MAXUPDATERECTS
+	   || (y == r->y+r->h && x1 <= r->x+r->w && x2 >= r->x)) {
+	    y1 = y < r->y ? y : r->y;
+	    y2 = y+1 > r->y+r->h ? y+1 : r->y+r->h;
+	    if(x2 < r->x+r->w) {
+		x2 = r->x+r->w;
+	    }
+	    if(x1 > r->x) {
+		x1 = r->x;
+	    }
+	    r->x = x1;
+	    r->y = y1;
+	    r->w = x2-x1;
+	    r->h = y2-y1;
+	    return numrects;
+	}
+    }
+    r = &updaterects[numrects];
+    r->x = x1;
+    r->y = y;
+    r->w = x2-x1;
+    r->h = 1;
+    return numrects+1;
+}
+
 void I_FinishUpdate (void)
 {
     int i;
     byte *dest;
     int tics;
     static int lasttic;
+    dirtyrect_t *d;
+    byte *src;
+    int x1, x2, y;
+    int numrects;
 
     /*
      * blit screen to video
@@ -94,8 +151,42 @@ void I_FinishUpdate (void)
 	    *dest = 0x00;
 	    dest += 2;
 	}
+	V_MarkRect(0, 0, 40, 1);
+    }
+
+    if(fullupdate) {
+	memcpy(lastframe, screen, screenwidth*screenheight);
+	SDL_UpdateRect( sdl_screen, 0, 0, screenwidth, screenheight );
+	fullupdate = false;
+	numdirtyrects = 0;
+	return;
+    }
+
+    numrects = 0;
+    for(d = dirtyrects; d < dirtyrects+numdirtyrects; d++) {
+	for(y = d->y1; y < d->y2; y++) {
+	    src = screen+y*screenwidth;
+	    dest = lastframe+y*screenwidth;
+	    x1 = d->x1;
+	    x2 = d->x2;
+	    while(x1 < x2 && src[x1] == dest[x1]) {
+		x1++;
+	    }
+	    if(x1 == x2) {
+		continue;
+	    }
+	    while(src[x2-1] == dest[x2-1]) {
+		x2--;
+	    }
+	    memcpy(dest+x1, src+x1, x2-x1);
+	    numrects = AddUpdateRow(numrects, x1, x2, y);
+	}
+    }
+    numdirtyrects = 0;
+
+    if(numrects) {
+	SDL_UpdateRects( sdl_screen, numrects, updaterects );
     }
-    SDL_UpdateRect( sdl_screen, 0, 0, screenwidth, screenheight );
 }
 
 void InitGraphLib(void) {
@@ -153,6 +244,12 @@ void I_InitGraphics(void) {
 	I_Error("Couldn't allocate space for screenmemory !\n");
     }
     sdl_screen->pixels = screen;
+
+    lastframe = malloc(screenheight*screenwidth);
+    if (!lastframe) {
+	I_Error("Couldn't allocate space for screenmemory !\n");
+    }
+    fullupdate = true;
 }
 
 /*
@@ -314,6 +411,8 @@ void I_StartTic (void)
 {
     SDL_Event Event;
     
+    if(novideo)
+	return;
     while ( SDL_PollEvent(&Event) )
         I_GetEvent(&Event);
 }
@@ -92,6 +92,9 @@ static channel_t*	channels;
  */
 int 		snd_SfxVolume = 15;
 
+/* Music volume, 0-15; GSI plays no music. */
+long 		snd_MusicVolume = 10;
+
 
 /* whether songs are mus_paused */
 static boolean		mus_paused;	
@@ -693,3 +696,22 @@ int S_getChannel( void* origin, sfxinfo_t* sfxinfo )
     
     return cnum;
 }
+
+
+/* GSI plays no music. */
+void S_StartSong(int song, boolean loop)
+{
+    (void)song;
+    (void)loop;
+}
+
+
+void S_StopSong(void)
+{
+}
+
+
+void S_SetMusicVolume(int volume)
+{
+    snd_MusicVolume = volume;
+}
@@ -4,6 +4,7 @@
 
 
 extern int snd_SfxVolume;
+extern long snd_MusicVolume;
 
 
 /*
@@ -49,5 +50,10 @@ void S_UpdateSounds(void* listener);
 
 void S_SetSfxVolume(int volume);
 
+/* Start music using <song> from sounds.h; stop it again. */
+void S_StartSong(int song, boolean loop);
+void S_StopSong(void);
+void S_SetMusicVolume(int volume);
+
 
 #endif /* __SOUNDSTH__ */
@@ -0,0 +1,759 @@
+/* hereticd.c */
+
+/*
+  Relay server for UDP net games.  The players start with
+
+    sdlheretic -server <host>[:port] [-session n] [-players n]
+
+  instead of -net <player> <hosts>, and send their tics to the server
+  alone.  It sends each of them relay packets (NCMD_RELAY, see
+  d_netpkt.c) with the other players' tics, a tic as soon as it has it
+  from everyone, so a player sends one packet per update however many
+  play, and the server is the only host the players have to reach.
+
+  A game starts once as many players have joined it as the first one
+  asked for (-players, or the server's -players), with the first one's
+  settings, like the key player's in a -net game.  A player who quits
+  or says nothing for -timeout seconds is dropped: the tics it sent are
+  still relayed, the ones after that go out without it, and the others
+  take it out of the game at the first of those.  Any number of games
+  up to MAXSESSIONS run side by side on the one socket, each getting
+  its packets through a hash of the player addresses.
+
+  usage: hereticd [-port n] [-players n] [-timeout secs]
+*/
+
+#define _GNU_SOURCE		/* recvmmsg, sendmmsg */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "doomdef.h"
+
+#define DOOMPORT	5029
+#define MAXSESSIONS	256
+#define CLIENTHASH	1024		/* a power of two */
+#define UDP_BATCH	64		/* datagrams moved by one syscall */
+
+enum
+{
+  SS_FREE,
+  SS_JOINING,
+  SS_PLAYING
+};
+
+typedef struct client_s
+{
+  struct sockaddr_in address;
+  struct session_s *session;
+  int player;
+  int active;			/* false once dropped */
+  long long heard;		/* ms */
+
+  /* what we have of its tics */
+  int nettics;			/* all below */
+  int lefttic;			/* when dropped: nettics then */
+  byte got[BACKUPTICS];		/* past nettics */
+
+  /* what it has of the relayed tics */
+  int ack;
+  unsigned sack;
+
+  int reply;			/* sent us a packet since we sent it one */
+  struct client_s *hashnext;
+} client_t;
+
+typedef struct session_s
+{
+  int state;
+  unsigned id;
+  int number;			/* for the log */
+  int numplayers;
+  int joined;
+  int version, settings, map;	/* from the first player's setup */
+  long long started;
+
+  client_t clients[MAXPLAYERS];
+  ticcmd_t cmds[MAXPLAYERS][BACKUPTICS];
+  byte mask[BACKUPTICS];	/* the players in a relayed tic */
+  int fulltic;			/* tics below are relayed */
+  int sentfull;			/* fulltic as last sent to everyone */
+  int dirty;
+  int packetsin, packetsout;
+} session_t;
+
+static session_t sessions[MAXSESSIONS];
+static session_t *dirty[MAXSESSIONS];
+static int numdirty;
+static int numsessions;		/* ever started, for the log */
+
+static client_t *clienthash[CLIENTHASH];
+
+static int udpsocket;
+static long long now;		/* ms */
+
+static int defaultplayers = 2;
+static int timeout = 10;	/* seconds */
+
+static doomdata_t packet;	/* the one being read or built */
+
+/* read by the last recvmmsg() */
+static byte recvbuffers[UDP_BATCH][NETPACKETSIZE];
+static struct sockaddr_in recvaddress[UDP_BATCH];
+static struct iovec recviov[UDP_BATCH];
+static struct mmsghdr recvmsgs[UDP_BATCH];
+
+/* queued for the next sendmmsg() */
+static byte sendbuffers[UDP_BATCH][NETPACKETSIZE];
+static struct sockaddr_in sendaddress[UDP_BATCH];
+static struct iovec sendiov[UDP_BATCH];
+static struct mmsghdr sendmsgs[UDP_BATCH];
+static int sendcount;
+
+static int packetsin, packetsout, packetsbad;
+static volatile sig_atomic_t quit;
+
+static long long NowMS (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void Fatal (char *msg, char *arg)
+{
+  fprintf (stderr, "hereticd: %s%s%s\n", msg, arg ? ": " : "",
+	   arg ? arg : "");
+  exit (1);
+}
+
+static void Usage (void)
+{
+  fprintf (stderr,
+	   "usage: hereticd [-port n] [-players n] [-timeout secs]\n");
+  exit (1);
+}
+
+static void Quit (int sig)
+{
+  quit = sig;
+}
+
+/*
+ * Tic numbers go out as their low 16 bits, near is one they are near.
+ */
+static int ExpandTic (int low, int near)
+{
+  int delta = low - (near & 0xffff);
+
+  if (delta >= 0x8000)
+    delta -= 0x10000;
+  else if (delta < -0x8000)
+    delta += 0x10000;
+  return near + delta;
+}
+
+static char *AddressName (struct sockaddr_in *address)
+{
+  static char name[32];
+
+  snprintf (name, sizeof (name), "%s:%i", inet_ntoa (address->sin_addr),
+	    ntohs (address->sin_port));
+  return name;
+}
+
+/* ========================================================================= */
+
+static unsigned HashAddress (struct sockaddr_in *address)
+{
+  unsigned h = address->sin_addr.s_addr * 2654435761u ^ address->sin_port;
+
+  return (h ^ h >> 16) & (CLIENTHASH - 1);
+}
+
+static client_t *FindClient (struct sockaddr_in *address)
+{
+  client_t *c;
+
+  for (c = clienthash[HashAddress (address)]; c; c = c->hashnext)
+    if (c->address.sin_addr.s_addr == address->sin_addr.s_addr
+	&& c->address.sin_port == address->sin_port)
+      return c;
+  return NULL;
+}
+
+static void HashClient (client_t *c)
+{
+  client_t **link = &clienthash[HashAddress (&c->address)];
+
+  c->hashnext = *link;
+  *link = c;
+}
+
+static void UnhashClient (client_t *c)
+{
+  client_t **link;
+
+  for (link = &clienthash[HashAddress (&c->address)]; *link;
+       link = &(*link)->hashnext)
+    if (*link == c)
+      {
+	*link = c->hashnext;
+	return;
+      }
+}
+
+/* ========================================================================= */
+
+static void FlushPackets (void)
+{
+  int sent, c;
+
+  for (sent = 0; sent < sendcount; sent += c)
+    {
+      c = sendmmsg (udpsocket, sendmsgs + sent, sendcount - sent, 0);
+      if (c >= 0)
+	continue;
+      if (errno == EINTR)
+	c = 0;
+      else if (errno == EAGAIN || errno == EWOULDBLOCK)
+	break;			/* socket buffer full: they send again */
+      else
+	c = 1;			/* unreachable host, skip it */
+    }
+  sendcount = 0;
+}
+
+/*
+ * Queues packet for address.
+ */
+static void SendPacket (struct sockaddr_in *address, int flags)
+{
+  packet.flags = flags;
+  if (sendcount == UDP_BATCH)
+    FlushPackets ();
+  sendaddress[sendcount] = *address;
+  sendiov[sendcount].iov_len = NetEncode (&packet, sendbuffers[sendcount]);
+  sendcount++;
+  packetsout++;
+}
+
+static void SendStart (client_t *c)
+{
+  session_t *s = c->session;
+
+  packet.player = s->version;
+  packet.ack = s->settings;
+  packet.starttic = s->map;
+  packet.sack = c->player | s->numplayers << 8;
+  packet.numtics = 0;
+  SendPacket (&c->address, NCMD_SETUP);
+}
+
+static void SendKill (struct sockaddr_in *address)
+{
+  memset (&packet, 0, sizeof (packet));
+  SendPacket (address, NCMD_KILL);
+}
+
+/*
+  ====================
+  =
+  = SendTics
+  =
+  = Sends c the relayed tics it hasn't acknowledged, oldest first, as
+  = many as go in one packet with the same players in each
+  =
+  ====================
+*/
+
+static void SendTics (client_t *c)
+{
+  session_t *s = c->session;
+  int first = -1;
+  int mask = 0;
+  int tic, slot, tmask;
+  int n, j;
+
+  packet.ack = c->nettics;
+  packet.sack = 0;
+  for (n = 0; n < 32; n++)
+    if (c->got[(c->nettics + 1 + n) % BACKUPTICS])
+      packet.sack |= 1u << n;
+
+  memset (packet.present, 0, sizeof (packet.present));
+  packet.numtics = 0;
+  for (tic = c->ack; tic < s->fulltic; tic++)
+    {
+      n = tic - c->ack - 1;
+      if (n >= 0 && n < 32 && (c->sack & (1u << n)))
+	continue;		/* it has that one */
+      slot = tic % BACKUPTICS;
+      tmask = s->mask[slot] & ~(1 << c->player);
+      if (first == -1)
+	{
+	  first = tic;
+	  mask = tmask;
+	}
+      else if (tic - first == RELAYMAXTICS || tmask != mask)
+	break;
+
+      packet.present[(tic - first) >> 3] |= 1 << ((tic - first) & 7);
+      for (j = 0; j < MAXPLAYERS; j++)
+	if (mask & (1 << j))
+	  packet.cmds[(tic - first) * MAXPLAYERS + j] = s->cmds[j][slot];
+      packet.numtics = tic - first + 1;
+    }
+  packet.player = mask;
+  packet.starttic = first == -1 ? s->fulltic : first;
+  SendPacket (&c->address, NCMD_RELAY);
+  s->packetsout++;
+  c->reply = 0;
+}
+
+/* ========================================================================= */
+
+static void MarkDirty (session_t *s)
+{
+  if (!s->dirty)
+    {
+      s->dirty = 1;
+      dirty[numdirty++] = s;
+    }
+}
+
+static void EndSession (session_t *s)
+{
+  printf ("game %i ended: %i tics, %i packets in, %i out, %.1f s\n",
+	  s->number, s->fulltic, s->packetsin, s->packetsout,
+	  (now - s->started) / 1000.0);
+  s->state = SS_FREE;
+}
+
+/*
+  ====================
+  =
+  = DropClient
+  =
+  ====================
+*/
+
+static void DropClient (client_t *c, char *why)
+{
+  session_t *s = c->session;
+  int i;
+
+  UnhashClient (c);
+  if (s->state == SS_JOINING)
+    {				/* not numbered yet: close the gap */
+      printf ("game %i: %s left while joining (%s)\n", s->number,
+	      AddressName (&c->address), why);
+      for (i = 0; i < s->joined; i++)
+	UnhashClient (&s->clients[i]);
+      for (i = c->player + 1; i < s->joined; i++)
+	s->clients[i - 1] = s->clients[i];
+      if (!--s->joined)
+	s->state = SS_FREE;
+      for (i = 0; i < s->joined; i++)
+	{
+	  s->clients[i].player = i;
+	  HashClient (&s->clients[i]);
+	}
+      return;
+    }
+
+  printf ("game %i: player %i left at tic %i (%s)\n", s->number,
+	  c->player + 1, c->nettics, why);
+  c->active = 0;
+  c->lefttic = c->nettics;
+  for (i = 0; i < s->numplayers; i++)
+    if (s->clients[i].active)
+      break;
+  if (i == s->numplayers)
+    EndSession (s);
+  else
+    MarkDirty (s);
+}
+
+/*
+  ====================
+  =
+  = JoinSession
+  =
+  = A setup packet from a host not in a game: puts it in the waiting
+  = game it asks for, or opens one
+  =
+  ====================
+*/
+
+static void JoinSession (struct sockaddr_in *from)
+{
+  session_t *s, *freesession = NULL;
+  client_t *c;
+  unsigned id = packet.sack >> 8;
+  int i;
+
+  for (i = 0, s = sessions; i < MAXSESSIONS; i++, s++)
+    {
+      if (s->state == SS_JOINING && s->id == id)
+	break;
+      if (s->state == SS_FREE && !freesession)
+	freesession = s;
+    }
+  if (i == MAXSESSIONS)
+    {
+      s = freesession;
+      if (!s)
+	{
+	  SendKill (from);
+	  return;
+	}
+      memset (s, 0, sizeof (*s));
+      s->state = SS_JOINING;
+      s->id = id;
+      s->number = ++numsessions;
+      s->numplayers = packet.sack & 0xff ? packet.sack & 0xff
+	: defaultplayers;
+      if (s->numplayers > MAXPLAYERS)
+	s->numplayers = MAXPLAYERS;
+      s->version = packet.player;
+      s->settings = packet.ack;
+      s->map = packet.starttic;
+    }
+
+  c = &s->clients[s->joined];
+  memset (c, 0, sizeof (*c));
+  c->address = *from;
+  c->session = s;
+  c->player = s->joined++;
+  c->active = 1;
+  c->heard = now;
+  HashClient (c);
+  printf ("game %i (%u): %s joined, %i of %i\n", s->number, s->id,
+	  AddressName (from), s->joined, s->numplayers);
+
+  if (s->joined < s->numplayers)
+    return;
+  s->state = SS_PLAYING;
+  s->started = now;
+  printf ("game %i started\n", s->number);
+  for (i = 0; i < s->numplayers; i++)
+    SendStart (&s->clients[i]);
+}
+
+/*
+  ====================
+  =
+  = GetTics
+  =
+  = Takes note of the ack and the tics in a game packet from c
+  =
+  ====================
+*/
+
+static void GetTics (client_t *c)
+{
+  session_t *s = c->session;
+  int ack, lowack, start, tic, slot;
+  int i;
+
+  ack = ExpandTic (packet.ack, s->fulltic);
+  if (ack == c->ack)
+    c->sack |= packet.sack;
+  else if (ack > c->ack && ack <= s->fulltic)
+    {
+      c->ack = ack;
+      c->sack = packet.sack;
+    }
+
+  /* a tic's slot is free once everyone has the tic relayed from it */
+  lowack = s->fulltic;
+  for (i = 0; i < s->numplayers; i++)
+    if (s->clients[i].active && s->clients[i].ack < lowack)
+      lowack = s->clients[i].ack;
+
+  start = ExpandTic (packet.starttic, c->nettics);
+  for (i = 0; i < packet.numtics; i++)
+    {
+      if (!(packet.present[i >> 3] & (1 << (i & 7))))
+	continue;
+      tic = start + i;
+      slot = tic % BACKUPTICS;
+      if (tic < c->nettics || tic - lowack >= BACKUPTICS || c->got[slot])
+	continue;
+      s->cmds[c->player][slot] = packet.cmds[i];
+      c->got[slot] = 1;
+    }
+  while (c->got[c->nettics % BACKUPTICS])
+    {
+      c->got[c->nettics % BACKUPTICS] = 0;
+      c->nettics++;
+    }
+
+  c->reply = 1;
+  MarkDirty (s);
+}
+
+/*
+  ====================
+  =
+  = ReadPacket
+  =
+  ====================
+*/
+
+static void ReadPacket (byte *data, int length, struct sockaddr_in *from)
+{
+  client_t *c;
+
+  packetsin++;
+  if (!NetDecode (&packet, data, length) || packet.flags & NCMD_RELAY)
+    {
+      packetsbad++;
+      return;
+    }
+
+  c = FindClient (from);
+  if (!c)
+    {
+      if (packet.flags & NCMD_SETUP)
+	JoinSession (from);
+      else if (!(packet.flags & NCMD_EXIT))
+	SendKill (from);	/* dropped, or from a game long gone */
+      return;
+    }
+
+  c->heard = now;
+  c->session->packetsin++;
+  if (packet.flags & NCMD_SETUP)
+    {				/* our start got lost */
+      if (c->session->state == SS_PLAYING)
+	SendStart (c);
+      return;
+    }
+  if (c->session->state != SS_PLAYING)
+    return;
+  if (packet.flags & NCMD_EXIT)
+    DropClient (c, "quit");
+  else
+    GetTics (c);
+}
+
+/*
+  ====================
+  =
+  = RelayTics
+  =
+  = Moves on the tics of the games packets came in for.  Everyone gets
+  = the new ones; the players who only sent, their ack.
+  =
+  ====================
+*/
+
+static void RelayTics (void)
+{
+  session_t *s;
+  client_t *c;
+  int all, mask;
+  int i, j;
+
+  for (i = 0; i < numdirty; i++)
+    {
+      s = dirty[i];
+      s->dirty = 0;
+      if (s->state != SS_PLAYING)
+	continue;
+
+      while (1)
+	{
+	  mask = 0;
+	  for (j = 0; j < s->numplayers; j++)
+	    {
+	      c = &s->clients[j];
+	      if (c->active)
+		{
+		  if (c->nettics <= s->fulltic)
+		    break;
+		  mask |= 1 << j;
+		}
+	      else if (s->fulltic < c->lefttic)
+		mask |= 1 << j;
+	    }
+	  if (j < s->numplayers)
+	    break;
+	  s->mask[s->fulltic % BACKUPTICS] = mask;
+	  s->fulltic++;
+	}
+
+      all = s->fulltic > s->sentfull;
+      s->sentfull = s->fulltic;
+      for (j = 0; j < s->numplayers; j++)
+	{
+	  c = &s->clients[j];
+	  if (c->active && (all || c->reply))
+	    SendTics (c);
+	}
+    }
+  numdirty = 0;
+  FlushPackets ();
+}
+
+/*
+  ====================
+  =
+  = CheckTimeouts
+  =
+  ====================
+*/
+
+static void CheckTimeouts (void)
+{
+  session_t *s;
+  client_t *c;
+  int i, j;
+
+  for (i = 0, s = sessions; i < MAXSESSIONS; i++, s++)
+    for (j = 0; j < s->joined && s->state != SS_FREE; j++)
+      {
+	c = &s->clients[j];
+	if (c->active && now - c->heard > timeout * 1000LL)
+	  {
+	    DropClient (c, "timed out");
+	    if (s->state == SS_JOINING)
+	      j--;		/* the next one moved down */
+	  }
+      }
+  RelayTics ();
+}
+
+/* ========================================================================= */
+
+static void OpenSocket (int port)
+{
+  struct sockaddr_in local;
+  int i;
+
+  udpsocket = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (udpsocket == -1)
+    Fatal ("can't create socket", strerror (errno));
+  fcntl (udpsocket, F_SETFL, fcntl (udpsocket, F_GETFL) | O_NONBLOCK);
+
+  memset (&local, 0, sizeof (local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl (INADDR_ANY);
+  local.sin_port = htons (port);
+  if (bind (udpsocket, (struct sockaddr *) &local, sizeof (local)) == -1)
+    Fatal ("can't bind", strerror (errno));
+
+  for (i = 0; i < UDP_BATCH; i++)
+    {
+      recviov[i].iov_base = recvbuffers[i];
+      recviov[i].iov_len = sizeof (recvbuffers[i]);
+      recvmsgs[i].msg_hdr.msg_name = &recvaddress[i];
+      recvmsgs[i].msg_hdr.msg_iov = &recviov[i];
+      recvmsgs[i].msg_hdr.msg_iovlen = 1;
+
+      sendiov[i].iov_base = sendbuffers[i];
+      sendmsgs[i].msg_hdr.msg_name = &sendaddress[i];
+      sendmsgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+      sendmsgs[i].msg_hdr.msg_iov = &sendiov[i];
+      sendmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+/*
+ * Reads everything the socket has, a batch at a time, relaying after
+ *  each batch.
+ */
+static void ReadSocket (void)
+{
+  int count, i;
+
+  while (1)
+    {
+      for (i = 0; i < UDP_BATCH; i++)
+	recvmsgs[i].msg_hdr.msg_namelen = sizeof (recvaddress[i]);
+      count = recvmmsg (udpsocket, recvmsgs, UDP_BATCH, 0, NULL);
+      if (count <= 0)
+	{
+	  if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK
+	      && errno != EINTR && errno != ECONNREFUSED)
+	    Fatal ("recvmmsg", strerror (errno));
+	  return;
+	}
+      now = NowMS ();
+      for (i = 0; i < count; i++)
+	if (!(recvmsgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+	  ReadPacket (recvbuffers[i], recvmsgs[i].msg_len, &recvaddress[i]);
+      RelayTics ();
+    }
+}
+
+int main (int argc, char **argv)
+{
+  struct pollfd fds;
+  struct rusage usage;
+  long long checked = 0;
+  int port = DOOMPORT;
+  int i;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (argv[i][0] != '-' || i + 1 == argc)
+	Usage ();
+      if (!strcmp (argv[i], "-port"))
+	port = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-players"))
+	defaultplayers = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-timeout"))
+	timeout = atoi (argv[++i]);
+      else
+	Usage ();
+    }
+  if (defaultplayers < 1 || defaultplayers > MAXPLAYERS)
+    Fatal ("-players must be 1 to 4", NULL);
+  if (timeout < 1)
+    timeout = 1;
+
+  setvbuf (stdout, NULL, _IOLBF, 0);
+  signal (SIGINT, Quit);
+  signal (SIGTERM, Quit);
+  OpenSocket (port);
+  printf ("hereticd: listening on port %i\n", port);
+
+  fds.fd = udpsocket;
+  fds.events = POLLIN;
+  while (!quit)
+    {
+      if (poll (&fds, 1, 250) < 0 && errno != EINTR)
+	Fatal ("poll", strerror (errno));
+      ReadSocket ();
+      now = NowMS ();
+      if (now - checked >= 250)
+	{
+	  CheckTimeouts ();
+	  checked = now;
+	}
+    }
+
+  getrusage (RUSAGE_SELF, &usage);
+  printf ("hereticd: %i games, %i packets in, %i out, %i bad, "
+	  "%.2f s cpu\n", numsessions, packetsin, packetsout, packetsbad,
+	  usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+	  + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6);
+  return 0;
+}
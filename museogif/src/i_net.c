@@ -1,12 +1,24 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/time.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
 
 #include "doomdef.h"
 
 
 void (* netget)(void);
 void (* netsend)(void);
+/* sends what netsend held back, for drivers that batch */
+void (* netflush)(void);
+
+/* the driver's socket, for I_NetWait; -1 without one */
+int netsocket = -1;
 
 /*
  * I_InitNetwork
@@ -18,7 +30,6 @@ void I_InitNetwork (void)
   doomcom = malloc (sizeof (*doomcom) );
   assert(doomcom);
   memset (doomcom, 0, sizeof(*doomcom) );
-  netbuffer = &doomcom->data;
   
   /*  
    * shared parameters (IPX/UDP)
@@ -42,9 +53,19 @@ void I_InitNetwork (void)
     doomcom-> extratics = 0;
   /* shared parameters end */
   
+  doomcom->id = DOOMCOM_ID;
+  
+#ifdef UDP_PROTOCOL
+  /* -net <player> <hosts> or -server <host>: UDP game, see i_udp.c */
+  if (M_CheckParm ("-net") || M_CheckParm ("-server"))
+    {
+      I_InitUDP ();
+      return;
+    }
+#endif
+
   /* single player game */
   netgame = false;
-  doomcom->id = DOOMCOM_ID;
   doomcom->numplayers = doomcom->numnodes = 1;
   doomcom->deathmatch = false;
   doomcom->consoleplayer = 0;
@@ -68,7 +89,61 @@ void I_NetCmd (void)
     {
       netget ();
     }
+  else if (doomcom->command == CMD_FLUSH)
+    {
+      if (netflush)
+	netflush ();
+    }
   else
     I_Error ("Bad net cmd: %i\n",doomcom->command);
 }
 
+
+
+/*
+ * I_NetWait
+ * Sleeps until a packet comes in on the net socket or the next tic
+ *  of I_GetTime starts, whichever is first.  The tic boundary is a
+ *  timer fd deadline, so the wakeup is neither early nor late.
+ */
+void I_NetWait (void)
+{
+  struct pollfd		fds[2];
+  struct timeval	now;
+  long			next;
+#ifdef __linux__
+  static int		timerfd = -2;
+  struct itimerspec	deadline;
+  unsigned long long	expirations;
+#endif
+
+  /* I_GetTime counts tics from a whole second on */
+  gettimeofday (&now, NULL);
+  next = ((now.tv_usec*TICRATE/1000000 + 1) * 1000000 + TICRATE-1) / TICRATE;
+
+  fds[0].fd = netsocket;
+  fds[0].events = POLLIN;
+  fds[0].revents = 0;
+
+#ifdef __linux__
+  if (timerfd == -2)
+    timerfd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timerfd >= 0)
+    {
+      memset (&deadline, 0, sizeof(deadline));
+      deadline.it_value.tv_nsec = (next - now.tv_usec) * 1000;
+      timerfd_settime (timerfd, 0, &deadline, NULL);
+
+      fds[1].fd = timerfd;
+      fds[1].events = POLLIN;
+      fds[1].revents = 0;
+      poll (fds, 2, -1);
+      if (fds[1].revents & POLLIN)
+	read (timerfd, &expirations, sizeof(expirations));
+      return;
+    }
+#endif
+
+  /* no timer fd: poll's own timeout, to the millisecond */
+  poll (fds, 1, (next - now.tv_usec + 999) / 1000);
+}
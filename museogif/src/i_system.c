@@ -51,23 +51,49 @@ byte *I_ZoneBase (size_t *size)
 }
 
 
+/*
+ * I_GetTimeFrac
+ * returns I_GetTime, and in frac how far into that tic the clock is,
+ *  to the microsecond
+ */
+int I_GetTimeFrac (fixed_t *frac)
+{
+  struct timeval	tp;
+  static int		basetime=0;
+  long long		usec;
+  
+  gettimeofday(&tp, NULL);
+  if (!basetime)
+    basetime = tp.tv_sec;
+  usec = (long long)tp.tv_usec*TICRATE;
+  *frac = (usec%1000000 << FRACBITS)/1000000;
+  return (tp.tv_sec-basetime)*TICRATE + usec/1000000;
+}
+
 /*
  * I_GetTime
- * returns time in 1/70th second tics
+ * returns time in 1/35th second tics
  */
 int  I_GetTime (void)
+{
+  fixed_t		frac;
+  
+  return I_GetTimeFrac (&frac);
+}
+
+/*
+ * I_GetTimeMS
+ * returns time in milliseconds
+ */
+int I_GetTimeMS (void)
 {
   struct timeval	tp;
-  struct timezone	tzp;
-  int			newtics;
   static int		basetime=0;
   
-  gettimeofday(&tp, &tzp);
+  gettimeofday(&tp, NULL);
   if (!basetime)
     basetime = tp.tv_sec;
-  newtics = (tp.tv_sec-basetime)*TICRATE + tp.tv_usec*TICRATE/1000000;
-  /* printf("Newtics: %d\n",newtics); */
-  return newtics;
+  return (tp.tv_sec-basetime)*1000 + tp.tv_usec/1000;
 }
 
 
@@ -103,7 +129,7 @@ void I_GetHomeDirectory(void)
  */
 void I_Init (void)
 {
-  if (! M_CheckParm("-nosound"))
+  if (! M_CheckParm("-nosound") && (!nodraw || wavout))
     {
 #ifdef __DOSOUND__
       I_InitSound();
@@ -153,8 +179,13 @@ void I_Quit (void)
   fprintf(stderr, "FIXME, Calling I_ShutdownMusic...\n");
 #endif
   
-  M_SaveDefaults ();
-  I_ShutdownGraphics();
+  /* headless test and benchmark runs leave the config alone */
+  if (!netsoak && !novideo)
+    M_SaveDefaults ();
+  if (!novideo)
+    I_ShutdownGraphics();
+  G_WaitAutoSave ();
+  G_StopStateHash ();
   
   free(homedir); free(basedefault);
   exit(0);
@@ -226,7 +257,8 @@ void I_Error (char *error, ...)
   fprintf(stderr, "FIXME, Calling I_ShutdownMusic...\n");
 #endif
   
-  I_ShutdownGraphics();
+  if (!novideo)
+    I_ShutdownGraphics();
 
   free(homedir); free(basedefault);
   
@@ -0,0 +1,290 @@
+/*
+ * i_udp.c
+ * UDP network driver, behind the netsend/netget hooks of i_net.c.
+ *
+ * -net <player> <host> <host> ... names the hosts of all players in
+ *  player order, the own one included, the same on every machine.
+ *  A host is a name or address with an optional :port, by default the
+ *  one given with -port (5029).  Node i is player i+1, and the socket
+ *  is bound to the own host's address, so a game of four can run on
+ *  one machine as 127.0.0.1 to 127.0.0.4.
+ *
+ * The socket never blocks.  Sends are queued and go out together with
+ *  one sendmmsg(); a get reads everything the socket has with
+ *  recvmmsg() and hands it out one packet per call, so GetPackets()
+ *  drains the socket in a few syscalls.
+ *
+ * -server <host> instead of -net plays through hereticd at host[:port]:
+ *  the socket is bound to -port if given, any port otherwise, and the
+ *  server is relaynode, the only node we talk to.  d_net learns the
+ *  player number and the number of players from the server.
+ */
+
+#ifdef UDP_PROTOCOL
+
+#define _GNU_SOURCE		/* recvmmsg, sendmmsg */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "doomdef.h"
+
+/* IPPORT_USERRESERVED + 0x1d, as Doom used */
+#define DOOMPORT	5029
+
+/* most datagrams moved by one syscall */
+#define UDP_BATCH	16
+
+extern void (* netget)(void);
+extern void (* netsend)(void);
+extern void (* netflush)(void);
+extern int netsocket;
+extern int relaynode;
+
+static int			udpsocket = -1;
+static struct sockaddr_in	nodeaddress[MAXNETNODES];
+
+/* read by the last recvmmsg(), handed out from recvnext on */
+static byte			recvbuffers[UDP_BATCH][NETPACKETSIZE];
+static struct sockaddr_in	recvaddress[UDP_BATCH];
+static struct iovec		recviov[UDP_BATCH];
+static struct mmsghdr		recvmsgs[UDP_BATCH];
+static int			recvcount;
+static int			recvnext;
+
+/* queued by PacketSend, one per node at most */
+static byte			sendbuffers[UDP_BATCH][NETPACKETSIZE];
+static struct iovec		sendiov[UDP_BATCH];
+static struct mmsghdr		sendmsgs[UDP_BATCH];
+static int			sendcount;
+static unsigned			sendnodes;
+
+
+/*
+ * The node a packet came from, -1 for a host not in the game.
+ */
+static int UDP_NodeForAddress (struct sockaddr_in *address)
+{
+  int		i;
+
+  if (relaynode != -1)
+    return address->sin_addr.s_addr == nodeaddress[relaynode].sin_addr.s_addr
+      && address->sin_port == nodeaddress[relaynode].sin_port ? relaynode : -1;
+  for (i=0 ; i<doomcom->numnodes ; i++)
+    if (address->sin_addr.s_addr == nodeaddress[i].sin_addr.s_addr
+	&& address->sin_port == nodeaddress[i].sin_port)
+      return i;
+  return -1;
+}
+
+
+/*
+ * Sends everything PacketSend queued.  A packet that can't go out is
+ *  dropped: d_net sends the tics again until they are acknowledged.
+ */
+static void PacketFlush (void)
+{
+  int		sent;
+  int		c;
+
+  for (sent = 0 ; sent < sendcount ; sent += c)
+    {
+      c = sendmmsg (udpsocket, sendmsgs+sent, sendcount-sent, 0);
+      if (c >= 0)
+	continue;
+      if (errno == EINTR)
+	c = 0;
+      else if (errno == EAGAIN || errno == EWOULDBLOCK)
+	break;			/* socket buffer full, drop the rest */
+      else
+	c = 1;			/* unreachable host, skip it */
+    }
+  sendcount = 0;
+  sendnodes = 0;
+}
+
+
+static void PacketSend (void)
+{
+  int		node = doomcom->remotenode;
+
+  if (sendcount == UDP_BATCH || (sendnodes & (1<<node)))
+    PacketFlush ();
+
+  memcpy (sendbuffers[sendcount], doomcom->data, doomcom->datalength);
+  sendiov[sendcount].iov_len = doomcom->datalength;
+  sendmsgs[sendcount].msg_hdr.msg_name = &nodeaddress[node];
+  sendcount++;
+  sendnodes |= 1<<node;
+}
+
+
+static void PacketGet (void)
+{
+  int		i;
+  int		node;
+
+  /* whatever was sent until now goes out before we listen */
+  PacketFlush ();
+
+  while (1)
+    {
+      if (recvnext == recvcount)
+	{
+	  for (i=0 ; i<UDP_BATCH ; i++)
+	    recvmsgs[i].msg_hdr.msg_namelen = sizeof(recvaddress[i]);
+	  recvnext = 0;
+	  recvcount = recvmmsg (udpsocket, recvmsgs, UDP_BATCH, 0, NULL);
+	  if (recvcount <= 0)
+	    {
+	      if (recvcount < 0 && errno != EAGAIN && errno != EWOULDBLOCK
+		  && errno != EINTR && errno != ECONNREFUSED)
+		I_Error ("PacketGet: %s", strerror (errno));
+	      recvcount = 0;
+	      doomcom->remotenode = -1;	/* no packet */
+	      return;
+	    }
+	}
+
+      i = recvnext++;
+      node = UDP_NodeForAddress (&recvaddress[i]);
+      if (node == -1 || (recvmsgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+	continue;		/* not from a player, or not ours */
+
+      memcpy (doomcom->data, recvbuffers[i], recvmsgs[i].msg_len);
+      doomcom->remotenode = node;
+      doomcom->datalength = recvmsgs[i].msg_len;
+      return;
+    }
+}
+
+
+/*
+ * Fills in address for host[:port].
+ */
+static void UDP_ResolveHost (char *name, int port, struct sockaddr_in *address)
+{
+  char			host[256];
+  char			*colon;
+  struct hostent	*hostentry;
+
+  strncpy (host, name, sizeof(host)-1);
+  host[sizeof(host)-1] = 0;
+  colon = strchr (host, ':');
+  if (colon)
+    {
+      *colon = 0;
+      port = atoi (colon+1);
+    }
+
+  memset (address, 0, sizeof(*address));
+  address->sin_family = AF_INET;
+  address->sin_port = htons (port);
+  if (!inet_aton (host, &address->sin_addr))
+    {
+      hostentry = gethostbyname (host);
+      if (!hostentry)
+	I_Error ("I_InitUDP: couldn't find %s", host);
+      address->sin_addr = *(struct in_addr *)hostentry->h_addr_list[0];
+    }
+}
+
+
+/*
+ * I_InitUDP
+ * Sets doomcom up from the -net arguments and opens the socket.
+ */
+void I_InitUDP (void)
+{
+  struct sockaddr_in	local;
+  int			numnodes;
+  int			player;
+  int			port;
+  int			p;
+  int			i;
+
+  p = M_CheckParm ("-port");
+  port = p && p < myargc-1 ? atoi (myargv[p+1]) : DOOMPORT;
+
+  p = M_CheckParm ("-server");
+  if (p)
+    {
+      if (p == myargc-1)
+	I_Error ("usage: -server <host>[:port]");
+      relaynode = MAXPLAYERS;
+      UDP_ResolveHost (myargv[p+1], DOOMPORT, &nodeaddress[relaynode]);
+      memset (&local, 0, sizeof(local));
+      local.sin_family = AF_INET;
+      local.sin_addr.s_addr = htonl (INADDR_ANY);
+      local.sin_port = htons (M_CheckParm ("-port") ? port : 0);
+      player = 1;		/* until the server says */
+      numnodes = 1;
+    }
+  else
+    {
+      p = M_CheckParm ("-net");
+      player = p < myargc-1 ? atoi (myargv[p+1]) : 0;
+      numnodes = 0;
+      for (i=p+2 ; i<myargc && myargv[i][0] != '-' ; i++)
+	{
+	  if (numnodes == MAXPLAYERS)
+	    I_Error ("I_InitUDP: no more than %i players", MAXPLAYERS);
+	  UDP_ResolveHost (myargv[i], port, &nodeaddress[numnodes++]);
+	}
+      if (player < 1 || player > numnodes)
+	I_Error ("usage: -net <player> <host of player 1> <host of player 2> ...");
+      local = nodeaddress[player-1];
+    }
+
+  udpsocket = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (udpsocket == -1)
+    I_Error ("I_InitUDP: can't create socket: %s", strerror (errno));
+  fcntl (udpsocket, F_SETFL, fcntl (udpsocket, F_GETFL) | O_NONBLOCK);
+  fcntl (udpsocket, F_SETFD, FD_CLOEXEC);
+
+  /*
+   * Our own address, so the others see the packets come from the host
+   *  they know us by; behind NAT that address isn't ours, so any.
+   */
+  if (bind (udpsocket, (struct sockaddr *)&local, sizeof(local)) == -1)
+    {
+      local.sin_addr.s_addr = htonl (INADDR_ANY);
+      if (bind (udpsocket, (struct sockaddr *)&local, sizeof(local)) == -1)
+	I_Error ("I_InitUDP: can't bind port %i: %s", ntohs (local.sin_port)
+		 , strerror (errno));
+    }
+
+  for (i=0 ; i<UDP_BATCH ; i++)
+    {
+      recviov[i].iov_base = recvbuffers[i];
+      recviov[i].iov_len = sizeof(recvbuffers[i]);
+      recvmsgs[i].msg_hdr.msg_name = &recvaddress[i];
+      recvmsgs[i].msg_hdr.msg_iov = &recviov[i];
+      recvmsgs[i].msg_hdr.msg_iovlen = 1;
+
+      sendiov[i].iov_base = sendbuffers[i];
+      sendmsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      sendmsgs[i].msg_hdr.msg_iov = &sendiov[i];
+      sendmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+  netsend = PacketSend;
+  netget = PacketGet;
+  netflush = PacketFlush;
+  netsocket = udpsocket;
+  netgame = true;
+
+  doomcom->consoleplayer = player-1;
+  doomcom->numplayers = doomcom->numnodes = numnodes;
+}
+
+#endif /* UDP_PROTOCOL */
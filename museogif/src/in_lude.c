@@ -148,6 +148,7 @@ void IN_Start(void)
   intertime = 0;
   oldintertime = 0;
   AM_Stop();
+  S_StartSong(mus_intr, true);
 }
 
 
@@ -555,6 +556,7 @@ void IN_DrawStatBack(void)
   
   src = W_CacheLumpName ("FLOOR16", PU_CACHE);
   dest = screen;
+  V_MarkRect (0, 0, screenwidth, screenheight);
   
   for (y=0 ; y<screenheight ; y++)
     {
@@ -431,6 +431,7 @@ default_t defaults[] =
   /*{ "mouse_look", &mouseLook, 1 },
     { "mouse_invert", &mouseInvert, 1 },*/
   { "sfx_volume", &snd_SfxVolume, 10, 0/*scantranslate*/, 0/*untranslated*/},
+  { "music_volume", &snd_MusicVolume, 10, 0/*scantranslate*/, 0/*untranslated*/},
 
 #ifdef UNIX
   { "key_right", &key_right, KEY_RIGHTARROW, 0/*scantranslate*/, 0/*untranslated*/ },
@@ -713,6 +714,27 @@ void WritePCXfile (char *filename, byte *data, int width, int height, byte *pale
 
 /* ============================================================================== */
 
+/*
+  ==================
+  =
+  = M_WriteScreenShot
+  =
+  = Saves screen as the PCX file name
+  =
+  ==================
+*/
+
+void M_WriteScreenShot (char *name)
+{
+  byte    *pal;
+  
+  pal = (byte *)W_CacheLumpName("PLAYPAL", PU_CACHE);
+  
+  WritePCXfile (name, screen, screenwidth, screenheight
+		, pal);
+}
+
+
 /*
   ==================
   =
@@ -724,17 +746,9 @@ void WritePCXfile (char *filename, byte *data, int width, int height, byte *pale
 void M_ScreenShot (void)
 {
   int     i;
-  byte    *linear;
   char    lbmname[12];
-  byte    *pal;
 
 
-  /*
-   * munge planar buffer to linear
-   */
-
-  linear = screen;
-  
   /*
    * find a file name to save it to
    */
@@ -750,14 +764,7 @@ void M_ScreenShot (void)
   if (i==100)
     I_Error ("M_ScreenShot: Couldn't create a PCX");
   
-  /*
-   * save the pcx file
-   */
-  
-  pal = (byte *)W_CacheLumpName("PLAYPAL", PU_CACHE);
-  
-  WritePCXfile (lbmname, linear, screenwidth, screenheight
-		, pal);
+  M_WriteScreenShot (lbmname);
   
   players[consoleplayer].message = "SCREEN SHOT";  
 }
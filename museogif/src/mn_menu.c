@@ -68,6 +68,7 @@ static boolean SCMouseYSensi(int option);
 static boolean SCMouseLook(int option);
 static boolean SCMouseInvert(int option);
 static boolean SCSfxVolume(int option);
+static boolean SCMusicVolume(int option);
 static boolean SCScreenSize(int option);
 static boolean SCLoadGame(int option);
 static boolean SCSaveGame(int option);
@@ -153,6 +154,8 @@ static MenuItem_t Options2Items[] =
   { ITT_LRFUNC, "SCREEN SIZE", SCScreenSize, 0, MENU_NONE },
   { ITT_EMPTY, NULL, NULL, 0, MENU_NONE },
   { ITT_LRFUNC, "SFX VOLUME", SCSfxVolume, 0, MENU_NONE },
+  { ITT_EMPTY, NULL, NULL, 0, MENU_NONE },
+  { ITT_LRFUNC, "MUSIC VOLUME", SCMusicVolume, 0, MENU_NONE },
   { ITT_EMPTY, NULL, NULL, 0, MENU_NONE }
 };
 
@@ -160,7 +163,7 @@ static Menu_t Options2Menu =
 {
   90, 20,
   DrawOptions2Menu,
-  4, Options2Items,
+  6, Options2Items,
   0,
   MENU_OPTIONS
 };
@@ -528,6 +531,7 @@ static void DrawOptions2Menu(void)
   int diff = minblocks-1;
   DrawSlider(&Options2Menu, 1, maxblocks-(diff), screenblocks-(diff+1));
   DrawSlider(&Options2Menu, 3, 16, snd_SfxVolume);
+  DrawSlider(&Options2Menu, 5, 16, snd_MusicVolume);
 }
 
 
@@ -823,6 +827,31 @@ static boolean SCSfxVolume(int option)
 }
 
 
+/*
+  //---------------------------------------------------------------------------
+  //
+  // PROC SCMusicVolume
+  //
+  //---------------------------------------------------------------------------
+*/
+static boolean SCMusicVolume(int option)
+{
+  if(option == RIGHT_DIR)
+    {
+      if(snd_MusicVolume < 15)
+	{
+	  snd_MusicVolume++;
+	}
+    }
+  else if(snd_MusicVolume)
+    {
+      snd_MusicVolume--;
+    }
+  S_SetMusicVolume(snd_MusicVolume);
+  return true;
+}
+
+
 /*
   //---------------------------------------------------------------------------
   //
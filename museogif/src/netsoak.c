@@ -0,0 +1,917 @@
+/* netsoak.c */
+
+/*
+  Soak test for the net code.  Starts a net game of headless engine nodes
+  on the loopback interface with every packet going through a relay that
+  delays, jitters, reorders, duplicates, damages and drops them, and
+  reports what that cost each node and whether they all still played the
+  same game.
+
+  Node k runs as
+
+    <engine> -net <k> <hosts> -novideo -nosound -netsoak <tics>
+	     -statehash <dir>/node<k>.hash [engine args]
+
+  where its own host is its address and every other host is a relay
+  socket standing in for that player, so nothing goes node to node.  With
+  -hereticd <path> (or -server <port> for one already running) the nodes
+  play through hereticd instead,
+
+    <engine> -server <relay> -port <own port> -players <n> -session <port>
+	     -novideo -nosound -netsoak <tics> -statehash ...
+
+  and the relay stands between each node and the server.  With
+  -netsoak the console player plays made up input, and at the last tic the
+  node waits for its tics to be acknowledged and prints a "netstats:" line
+  (see d_net.c) before it quits.  The per-tic state hashes of all nodes
+  are compared at the end.
+
+  The exit status is nonzero if a node failed or the nodes disagree.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAXNODES	4		/* MAXPLAYERS */
+#define MAXENGINEARGS	64
+#define MAXPACKET	1500
+#define TICRATE		35
+
+#define SERVER		MAXNODES	/* packet from or to hereticd */
+
+typedef struct
+{
+  pid_t pid;
+  int fd;			/* read end of the engine's stdout/stderr */
+  char *out;
+  size_t outlen, outsize;
+  int status;
+  int killed;
+  struct sockaddr_in address;
+  char hashfile[1024];
+
+  /* parsed from the output */
+  int tics, sent, bytes, got, bad, ticssent, repeated;
+  int stallms, stalls, stallmax;
+  int acked;
+  int stated;			/* has a netstats: line */
+  int hashtics;
+  unsigned hash;
+  char error[256];
+  int ok;
+} node_t;
+
+typedef struct
+{
+  long long due;		/* us */
+  unsigned seq;			/* keeps packets due together in order */
+  int from, to;
+  int length;
+  unsigned char data[MAXPACKET];
+} packet_t;
+
+/* the per-tic record of -statehash, see g_demo.c */
+typedef struct
+{
+  int tic;
+  unsigned hash;
+  int rng;
+  int nummobjs;
+  int nummovers;
+} hashrecord_t;
+
+static node_t nodes[MAXNODES];
+static int numnodes = 4;
+
+/* relay[j][k] is player j as node k sees it; relay[k][k] the server */
+static int relay[MAXNODES][MAXNODES];
+
+/* with a server: upstream[k] is node k as the server sees it */
+static int upstream[MAXNODES];
+static struct sockaddr_in serveraddress;
+static int serverport;
+static char *hereticd;
+static pid_t serverpid;
+static char serverstats[256];	/* the last line hereticd printed */
+
+static packet_t *queue;
+static int queued, queuesize;
+static unsigned queueseq;
+
+static char *engine = "./sdlheretic";
+static char *dir = ".";
+static int tics = 30 * TICRATE;
+static int baseport = 5200;
+static int timeout;		/* seconds */
+static double latency = 50, jitter = 10, reorderdelay = 40;
+static double loss, reorder, duplicate, corrupt;	/* percent */
+static unsigned seed = 1;
+static char *engineargs[MAXENGINEARGS];
+static int numengineargs;
+
+/* relay totals */
+static int relayed, dropped, duplicated, reordered, corrupted;
+static double delaysum;
+
+static long long NowUS (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void Fatal (char *msg, char *arg)
+{
+  fprintf (stderr, "netsoak: %s%s%s\n", msg, arg ? ": " : "",
+	   arg ? arg : "");
+  exit (2);
+}
+
+static void Usage (void)
+{
+  fprintf (stderr,
+	   "usage: netsoak [-engine path] [-nodes n] [-tics n] [-dir hashdir]\n"
+	   "               [-latency ms] [-jitter ms] [-reorder %%]"
+	   " [-reorderdelay ms]\n"
+	   "               [-loss %%] [-dup %%] [-corrupt %%] [-seed n]"
+	   " [-port n]\n"
+	   "               [-timeout secs] [-hereticd path | -server port]\n"
+	   "               [-- engine args]\n");
+  exit (2);
+}
+
+/*
+ * The relay's own random numbers, so a -seed repeats the same weather.
+ */
+static double Random (void)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed / 4294967296.0;
+}
+
+static void LoopbackAddress (struct sockaddr_in *address, int port)
+{
+  memset (address, 0, sizeof (*address));
+  address->sin_family = AF_INET;
+  address->sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  address->sin_port = htons (port);
+}
+
+static int RelayPort (int j, int k)
+{
+  return baseport + MAXNODES + j * MAXNODES + k;
+}
+
+static int OpenSocket (int port)
+{
+  struct sockaddr_in address;
+  char name[16];
+  int s;
+
+  s = socket (AF_INET, SOCK_DGRAM, 0);
+  if (s < 0)
+    Fatal ("socket", strerror (errno));
+  LoopbackAddress (&address, port);
+  if (bind (s, (struct sockaddr *) &address, sizeof (address)) < 0)
+    {
+      sprintf (name, "%i", port);
+      Fatal ("can't bind relay port", name);
+    }
+  fcntl (s, F_SETFL, fcntl (s, F_GETFL) | O_NONBLOCK);
+  fcntl (s, F_SETFD, FD_CLOEXEC);
+  return s;
+}
+
+/*
+  ====================
+  =
+  = OpenRelay
+  =
+  ====================
+*/
+
+static void OpenRelay (void)
+{
+  int j, k;
+
+  for (k = 0; k < numnodes; k++)
+    LoopbackAddress (&nodes[k].address, baseport + k);
+  LoopbackAddress (&serveraddress, serverport);
+
+  for (j = 0; j < numnodes; j++)
+    for (k = 0; k < numnodes; k++)
+      {
+	relay[j][k] = -1;
+	if ((j == k) == !serverport)
+	  continue;
+	relay[j][k] = OpenSocket (RelayPort (j, k));
+      }
+  for (k = 0; k < numnodes; k++)
+    upstream[k] = serverport ? OpenSocket (0) : -1;
+}
+
+/*
+  ====================
+  =
+  = QueuePacket
+  =
+  = Decides the fate of a packet from node from to node to.
+  =
+  ====================
+*/
+
+static void QueuePacket (int from, int to, unsigned char *data, int length)
+{
+  packet_t *p;
+  double delay;
+  int copies, bit;
+
+  relayed++;
+  if (Random () * 100 < loss)
+    {
+      dropped++;
+      return;
+    }
+  copies = 1;
+  if (Random () * 100 < duplicate)
+    {
+      duplicated++;
+      copies = 2;
+    }
+
+  while (copies--)
+    {
+      if (queued == queuesize)
+	{
+	  queuesize = queuesize ? queuesize * 2 : 256;
+	  queue = realloc (queue, queuesize * sizeof (*queue));
+	  if (!queue)
+	    Fatal ("out of memory", NULL);
+	}
+      p = &queue[queued++];
+
+      delay = latency + (Random () * 2 - 1) * jitter;
+      if (Random () * 100 < reorder)
+	{
+	  reordered++;
+	  delay += reorderdelay;
+	}
+      if (delay < 0)
+	delay = 0;
+      delaysum += delay;
+
+      p->due = NowUS () + (long long) (delay * 1000);
+      p->seq = queueseq++;
+      p->from = from;
+      p->to = to;
+      p->length = length;
+      memcpy (p->data, data, length);
+      if (Random () * 100 < corrupt)
+	{
+	  corrupted++;
+	  bit = Random () * length * 8;
+	  p->data[bit >> 3] ^= 1 << (bit & 7);
+	}
+    }
+}
+
+/*
+  ====================
+  =
+  = DeliverPackets
+  =
+  = Sends what is due, and returns the ms until the next one is,
+  = -1 for none.
+  =
+  ====================
+*/
+
+static int DeliverPackets (void)
+{
+  long long now = NowUS ();
+  packet_t *p;
+  int first, i;
+
+  while (queued)
+    {
+      first = 0;
+      for (i = 1; i < queued; i++)
+	if (queue[i].due < queue[first].due
+	    || (queue[i].due == queue[first].due
+		&& queue[i].seq < queue[first].seq))
+	  first = i;
+      p = &queue[first];
+      if (p->due > now)
+	return (p->due - now + 999) / 1000;
+
+      /* it comes from the socket that stands in for the sender */
+      if (p->to == SERVER)
+	sendto (upstream[p->from], p->data, p->length, 0,
+		(struct sockaddr *) &serveraddress, sizeof (serveraddress));
+      else
+	sendto (relay[p->from == SERVER ? p->to : p->from][p->to], p->data,
+		p->length, 0, (struct sockaddr *) &nodes[p->to].address,
+		sizeof (nodes[p->to].address));
+      *p = queue[--queued];
+    }
+  return -1;
+}
+
+static void ReadRelay (int j, int k)
+{
+  unsigned char data[MAXPACKET];
+  struct sockaddr_in from;
+  socklen_t fromlen;
+  ssize_t n;
+
+  while (1)
+    {
+      fromlen = sizeof (from);
+      n = recvfrom (relay[j][k], data, sizeof (data), 0,
+		    (struct sockaddr *) &from, &fromlen);
+      if (n < 0)
+	return;
+      if (from.sin_addr.s_addr != nodes[k].address.sin_addr.s_addr
+	  || from.sin_port != nodes[k].address.sin_port)
+	continue;		/* not the node this socket serves */
+      QueuePacket (k, j == k ? SERVER : j, data, n);
+    }
+}
+
+static void ReadUpstream (int k)
+{
+  unsigned char data[MAXPACKET];
+  struct sockaddr_in from;
+  socklen_t fromlen;
+  ssize_t n;
+
+  while (1)
+    {
+      fromlen = sizeof (from);
+      n = recvfrom (upstream[k], data, sizeof (data), 0,
+		    (struct sockaddr *) &from, &fromlen);
+      if (n < 0)
+	return;
+      if (from.sin_port == serveraddress.sin_port)
+	QueuePacket (SERVER, k, data, n);
+    }
+}
+
+/*
+  ====================
+  =
+  = StartServer
+  =
+  = Runs hereticd on the port after the relay's, its output going to
+  = <dir>/hereticd.log
+  =
+  ====================
+*/
+
+static void StartServer (void)
+{
+  char port[16], players[8], log[1024];
+  int fd;
+
+  sprintf (port, "%i", serverport);
+  sprintf (players, "%i", numnodes);
+  snprintf (log, sizeof (log), "%s/hereticd.log", dir);
+
+  serverpid = fork ();
+  if (serverpid < 0)
+    Fatal ("fork", strerror (errno));
+  if (serverpid == 0)
+    {
+      fd = open (log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd >= 0)
+	{
+	  dup2 (fd, 1);
+	  dup2 (fd, 2);
+	}
+      execl (hereticd, hereticd, "-port", port, "-players", players,
+	     (char *) NULL);
+      fprintf (stderr, "can't run %s: %s\n", hereticd, strerror (errno));
+      _exit (127);
+    }
+  usleep (200000);		/* until it listens */
+}
+
+static void StopServer (void)
+{
+  char log[1024], line[256];
+  FILE *f;
+
+  kill (serverpid, SIGTERM);
+  while (waitpid (serverpid, NULL, 0) < 0 && errno == EINTR)
+    ;
+  snprintf (log, sizeof (log), "%s/hereticd.log", dir);
+  f = fopen (log, "r");
+  if (!f)
+    return;
+  while (fgets (line, sizeof (line), f))
+    strcpy (serverstats, line);
+  fclose (f);
+}
+
+/*
+  ====================
+  =
+  = StartNode
+  =
+  ====================
+*/
+
+static void StartNode (int k)
+{
+  node_t *node = &nodes[k];
+  char *argv[MAXENGINEARGS + 16 + MAXNODES];
+  char hosts[MAXNODES][32];
+  char player[8], soaktics[16], port[16], session[16];
+  int pipefd[2];
+  int argc = 0;
+  int i, nul;
+
+  snprintf (node->hashfile, sizeof (node->hashfile), "%s/node%i.hash", dir,
+	    k + 1);
+  sprintf (player, "%i", k + 1);
+  sprintf (soaktics, "%i", tics);
+
+  argv[argc++] = engine;
+  if (serverport)
+    {
+      sprintf (hosts[0], "127.0.0.1:%i", RelayPort (k, k));
+      sprintf (port, "%i", baseport + k);
+      sprintf (player, "%i", numnodes);
+      sprintf (session, "%i", baseport);
+      argv[argc++] = "-server";
+      argv[argc++] = hosts[0];
+      argv[argc++] = "-port";
+      argv[argc++] = port;
+      argv[argc++] = "-players";
+      argv[argc++] = player;
+      argv[argc++] = "-session";
+      argv[argc++] = session;
+    }
+  else
+    {
+      argv[argc++] = "-net";
+      argv[argc++] = player;
+      for (i = 0; i < numnodes; i++)
+	{
+	  sprintf (hosts[i], "127.0.0.1:%i",
+		   i == k ? baseport + k : RelayPort (i, k));
+	  argv[argc++] = hosts[i];
+	}
+    }
+  argv[argc++] = "-novideo";
+  argv[argc++] = "-nosound";
+  argv[argc++] = "-netsoak";
+  argv[argc++] = soaktics;
+  argv[argc++] = "-statehash";
+  argv[argc++] = node->hashfile;
+  for (i = 0; i < numengineargs; i++)
+    argv[argc++] = engineargs[i];
+  argv[argc] = NULL;
+
+  if (pipe (pipefd) < 0)
+    Fatal ("pipe", strerror (errno));
+
+  node->pid = fork ();
+  if (node->pid < 0)
+    Fatal ("fork", strerror (errno));
+
+  if (node->pid == 0)
+    {
+      nul = open ("/dev/null", O_RDONLY);
+      dup2 (nul, 0);
+      dup2 (pipefd[1], 1);
+      dup2 (pipefd[1], 2);
+      close (pipefd[0]);
+      close (pipefd[1]);
+      close (nul);
+      execv (engine, argv);
+      fprintf (stderr, "Error: can't run %s: %s\n", engine, strerror (errno));
+      _exit (127);
+    }
+
+  close (pipefd[1]);
+  node->fd = pipefd[0];
+}
+
+/*
+  ====================
+  =
+  = ParseOutput
+  =
+  ====================
+*/
+
+static void ParseOutput (node_t *node)
+{
+  char *line, *next, *e;
+
+  node->out[node->outlen] = 0;
+  for (line = node->out; *line; line = next)
+    {
+      next = strchr (line, '\n');
+      if (next)
+	*next++ = 0;
+      else
+	next = line + strlen (line);
+
+      if (sscanf (line, "netstats: %i tics, %i packets sent, %i bytes, %i got, "
+		  "%i bad, %i tics sent, %i repeated, %i ms stalled in %i waits, "
+		  "longest %i ms", &node->tics, &node->sent, &node->bytes,
+		  &node->got, &node->bad, &node->ticssent, &node->repeated,
+		  &node->stallms, &node->stalls, &node->stallmax) == 10)
+	{
+	  node->stated = 1;
+	  node->acked = strstr (line, "not all acknowledged") == NULL;
+	  continue;
+	}
+      if (sscanf (line, "statehash: %i tics, final hash %x",
+		  &node->hashtics, &node->hash) == 2)
+	continue;
+      if (!strncmp (line, "Error: ", 7) && !node->error[0])
+	{
+	  snprintf (node->error, sizeof (node->error), "%s", line + 7);
+	  for (e = node->error; *e; e++)
+	    if (*e == '\r')
+	      *e = 0;
+	}
+    }
+
+  node->ok = node->stated && node->tics == tics && !node->error[0];
+
+  if (node->ok || node->error[0])
+    return;
+  if (node->killed)
+    snprintf (node->error, sizeof (node->error), "timed out after %i s",
+	      timeout);
+  else if (WIFSIGNALED (node->status))
+    snprintf (node->error, sizeof (node->error), "killed by signal %i",
+	      WTERMSIG (node->status));
+  else if (WIFEXITED (node->status) && WEXITSTATUS (node->status))
+    snprintf (node->error, sizeof (node->error), "exit status %i",
+	      WEXITSTATUS (node->status));
+  else
+    snprintf (node->error, sizeof (node->error), "no netstats in output");
+}
+
+/*
+ * Returns 0 once the engine has closed its output.
+ */
+static int ReadNode (node_t *node)
+{
+  ssize_t n;
+
+  if (node->outsize - node->outlen < 4096)
+    {
+      node->outsize = node->outsize ? node->outsize * 2 : 16384;
+      node->out = realloc (node->out, node->outsize + 1);
+      if (!node->out)
+	Fatal ("out of memory", NULL);
+    }
+
+  n = read (node->fd, node->out + node->outlen, node->outsize - node->outlen);
+  if (n < 0 && errno == EINTR)
+    return 1;
+  if (n > 0)
+    {
+      node->outlen += n;
+      return 1;
+    }
+  return 0;
+}
+
+static void FinishNode (node_t *node)
+{
+  close (node->fd);
+  node->fd = -1;
+  while (waitpid (node->pid, &node->status, 0) < 0 && errno == EINTR)
+    ;
+  if (!node->out)
+    {
+      node->out = malloc (1);
+      node->outlen = 0;
+    }
+  ParseOutput (node);
+}
+
+/*
+  ====================
+  =
+  = RunGame
+  =
+  = Relays packets until every node has quit.
+  =
+  ====================
+*/
+
+static void RunGame (void)
+{
+  struct pollfd fds[MAXNODES * MAXNODES + 2 * MAXNODES];
+  int owner[MAXNODES * MAXNODES + 2 * MAXNODES];
+  long long started = NowUS ();
+  int running = numnodes;
+  int n, i, j, k, wait;
+
+  for (k = 0; k < numnodes; k++)
+    StartNode (k);
+
+  while (running)
+    {
+      wait = DeliverPackets ();
+      if (wait < 0 || wait > 100)
+	wait = 100;
+
+      n = 0;
+      for (j = 0; j < numnodes; j++)
+	for (k = 0; k < numnodes; k++)
+	  if (relay[j][k] >= 0)
+	    {
+	      fds[n].fd = relay[j][k];
+	      fds[n].events = POLLIN;
+	      owner[n++] = j * MAXNODES + k;
+	    }
+      for (k = 0; k < numnodes; k++)
+	if (upstream[k] >= 0)
+	  {
+	    fds[n].fd = upstream[k];
+	    fds[n].events = POLLIN;
+	    owner[n++] = MAXNODES * MAXNODES + k;
+	  }
+      for (k = 0; k < numnodes; k++)
+	if (nodes[k].fd >= 0)
+	  {
+	    fds[n].fd = nodes[k].fd;
+	    fds[n].events = POLLIN;
+	    owner[n++] = -1 - k;
+	  }
+
+      if (poll (fds, n, wait) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  Fatal ("poll", strerror (errno));
+	}
+
+      for (i = 0; i < n; i++)
+	{
+	  if (!fds[i].revents)
+	    continue;
+	  if (owner[i] >= MAXNODES * MAXNODES)
+	    {
+	      ReadUpstream (owner[i] - MAXNODES * MAXNODES);
+	      continue;
+	    }
+	  if (owner[i] >= 0)
+	    {
+	      ReadRelay (owner[i] / MAXNODES, owner[i] % MAXNODES);
+	      continue;
+	    }
+	  k = -1 - owner[i];
+	  if (ReadNode (&nodes[k]))
+	    continue;
+	  FinishNode (&nodes[k]);
+	  running--;
+	}
+
+      if (NowUS () - started > timeout * 1000000LL)
+	for (k = 0; k < numnodes; k++)
+	  if (nodes[k].fd >= 0 && !nodes[k].killed)
+	    {
+	      kill (nodes[k].pid, SIGKILL);
+	      nodes[k].killed = 1;
+	    }
+    }
+}
+
+/*
+ * Reads the (tic, hash) pairs out of a -statehash file.
+ * Returns the number of records, -1 if the file can't be read.
+ */
+static int ReadHashes (char *file, hashrecord_t **records)
+{
+  FILE *f;
+  hashrecord_t rec;
+  int count = 0, size = 0;
+
+  *records = NULL;
+  if ((f = fopen (file, "rb")) == NULL)
+    return -1;
+  while (fread (&rec, sizeof (rec), 1, f) == 1)
+    {
+      if (rec.nummobjs < 0 || rec.nummovers < 0
+	  || fseek (f, rec.nummobjs * 4L + rec.nummovers * 8L, SEEK_CUR))
+	break;
+      if (count == size)
+	{
+	  size = size ? size * 2 : 1024;
+	  *records = realloc (*records, size * sizeof (**records));
+	  if (!*records)
+	    Fatal ("out of memory", NULL);
+	}
+      (*records)[count++] = rec;
+    }
+  fclose (f);
+  return count;
+}
+
+/*
+  ====================
+  =
+  = CompareStates
+  =
+  = Returns 1 if every node played the same game as the first.
+  =
+  ====================
+*/
+
+static int CompareStates (void)
+{
+  hashrecord_t *ref, *recs;
+  int numref, num;
+  int agree = 1;
+  int i, k;
+
+  numref = ReadHashes (nodes[0].hashfile, &ref);
+  if (numref <= 0)
+    {
+      printf ("state: no hashes from node 1\n");
+      free (ref);
+      return 0;
+    }
+
+  for (k = 1; k < numnodes; k++)
+    {
+      num = ReadHashes (nodes[k].hashfile, &recs);
+      for (i = 0; i < num && i < numref; i++)
+	if (recs[i].tic != ref[i].tic || recs[i].hash != ref[i].hash)
+	  break;
+      if (num < 0)
+	printf ("state: no hashes from node %i\n", k + 1);
+      else if (i < num && i < numref)
+	printf ("state: node %i differs from node 1 at tic %i\n", k + 1,
+		ref[i].tic);
+      else if (num != numref)
+	printf ("state: node %i has %i tics, node 1 has %i\n", k + 1, num,
+		numref);
+      else
+	{
+	  free (recs);
+	  continue;
+	}
+      agree = 0;
+      free (recs);
+    }
+
+  if (agree)
+    printf ("state: all %i nodes agree on %i tics, final hash %08x\n",
+	    numnodes, numref, ref[numref - 1].hash);
+  free (ref);
+  return agree;
+}
+
+/*
+  ====================
+  =
+  = PrintSummary
+  =
+  ====================
+*/
+
+static int PrintSummary (void)
+{
+  int failed = 0;
+  int k;
+
+  printf ("%i nodes, %i tics; latency %g ms, jitter %g ms, reorder %g%%, "
+	  "loss %g%%, dup %g%%, corrupt %g%%\n\n", numnodes, tics, latency,
+	  jitter, reorder, loss, duplicate, corrupt);
+  printf ("node  packets  bytes/packet    got  bad  tics  repeated  stall ms"
+	  "  waits  longest  result\n");
+  for (k = 0; k < numnodes; k++)
+    {
+      node_t *node = &nodes[k];
+
+      printf ("%4i  %7i  %12.1f  %5i  %3i  %4i  %8i  %8i  %5i  %7i  %s\n",
+	      k + 1, node->sent,
+	      node->sent ? (double) node->bytes / node->sent : 0.0, node->got,
+	      node->bad, node->ticssent, node->repeated, node->stallms,
+	      node->stalls, node->stallmax, !node->ok ? node->error
+	      : node->acked ? "ok" : "ok, not all acknowledged");
+      if (!node->ok)
+	failed++;
+    }
+
+  printf ("\nrelay: %i packets, %i dropped, %i duplicated, %i reordered, "
+	  "%i corrupted, %.1f ms mean delay\n", relayed, dropped, duplicated,
+	  reordered, corrupted,
+	  relayed - dropped ? delaysum / (relayed - dropped + duplicated) : 0);
+  if (serverstats[0])
+    printf ("%s", serverstats);
+
+  return failed;
+}
+
+static double Percent (char *arg)
+{
+  double p = atof (arg);
+
+  return p < 0 ? 0 : p > 100 ? 100 : p;
+}
+
+int main (int argc, char **argv)
+{
+  int failed, agree;
+  int i;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp (argv[i], "--"))
+	{
+	  for (i++; i < argc; i++)
+	    {
+	      if (numengineargs == MAXENGINEARGS)
+		Fatal ("too many engine arguments", NULL);
+	      engineargs[numengineargs++] = argv[i];
+	    }
+	  break;
+	}
+      if (argv[i][0] != '-' || i + 1 == argc)
+	Usage ();
+      if (!strcmp (argv[i], "-engine"))
+	engine = argv[++i];
+      else if (!strcmp (argv[i], "-nodes"))
+	numnodes = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-tics"))
+	tics = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-dir"))
+	dir = argv[++i];
+      else if (!strcmp (argv[i], "-latency"))
+	latency = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-jitter"))
+	jitter = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-reorder"))
+	reorder = Percent (argv[++i]);
+      else if (!strcmp (argv[i], "-reorderdelay"))
+	reorderdelay = atof (argv[++i]);
+      else if (!strcmp (argv[i], "-loss"))
+	loss = Percent (argv[++i]);
+      else if (!strcmp (argv[i], "-dup"))
+	duplicate = Percent (argv[++i]);
+      else if (!strcmp (argv[i], "-corrupt"))
+	corrupt = Percent (argv[++i]);
+      else if (!strcmp (argv[i], "-seed"))
+	seed = strtoul (argv[++i], NULL, 0);
+      else if (!strcmp (argv[i], "-port"))
+	baseport = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-timeout"))
+	timeout = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "-hereticd"))
+	hereticd = argv[++i];
+      else if (!strcmp (argv[i], "-server"))
+	serverport = atoi (argv[++i]);
+      else
+	Usage ();
+    }
+  if (numnodes < 2 || numnodes > MAXNODES)
+    Fatal ("-nodes must be 2 to 4", NULL);
+  if (tics < 1)
+    Fatal ("-tics must be positive", NULL);
+  if (!seed)
+    seed = 1;
+  if (!timeout)
+    timeout = tics / TICRATE * 3 + 30;
+
+  if (hereticd && !serverport)
+    serverport = RelayPort (MAXNODES, 0);
+
+  signal (SIGPIPE, SIG_IGN);
+  OpenRelay ();
+  if (hereticd)
+    StartServer ();
+  RunGame ();
+  if (hereticd)
+    StopServer ();
+
+  failed = PrintSummary ();
+  agree = CompareStates ();
+  return failed || !agree;
+}
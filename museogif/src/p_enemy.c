@@ -1437,6 +1437,7 @@ void P_DSparilTeleport(mobj_t *actor)
       actor->z = actor->floorz;
       actor->angle = BossSpots[i%BossSpotCount].angle;
       actor->momx = actor->momy = actor->momz = 0;
+      P_StopInterpolation(actor);
     }
 }
 
@@ -25,6 +25,16 @@ result_e   T_MovePlane(sector_t *sector,fixed_t speed,
   boolean	flag;
   fixed_t	lastpos;
   
+  /* the heights before this tic, for -uncapped frames */
+  if(sector->movedtic != leveltime+1)
+    {
+      sector->movedtic = leveltime+1;
+      sector->oldfloorheight = sector->floorheight;
+      sector->oldceilingheight = sector->ceilingheight;
+      sector->nextmoved = movedsectors;
+      movedsectors = sector;
+    }
+  
   switch(floorOrCeiling)
     {
     case 0:		/* FLOOR */
@@ -1078,6 +1078,7 @@ boolean P_ChickenMorphPlayer(player_t *player)
   chicken = P_SpawnMobj(x, y, z, MT_CHICPLAYER);
   chicken->special1 = player->readyweapon;
   chicken->angle = angle;
+  P_StopInterpolation(chicken);
   chicken->player = player;
   player->health = chicken->health = MAXCHICKENHEALTH;
   player->mo = chicken;
@@ -1,11 +1,32 @@
 #include "doomdef.h"
 #include "p_local.h"
 
+sector_t	*changedlights;
+
+/*
+  //==================================================================
+  //
+  //	P_LightChanged
+  //
+  //	Puts a sector whose lightlevel was just set on changedlights,
+  //	so the renderer redoes its light
+  //
+  //==================================================================
+*/
+void P_LightChanged (sector_t *sector)
+{
+  if (sector->lightchanged)
+    return;
+  sector->lightchanged = true;
+  sector->nextchanged = changedlights;
+  changedlights = sector;
+}
+
 /*
   //==================================================================
   //==================================================================
   //
-  //							BROKEN LIGHT FLASHING
+  //							LIGHT BATCHES
   //
   //==================================================================
   //==================================================================
@@ -14,100 +35,223 @@
 /*
   //==================================================================
   //
-  //	T_LightFlash
+  //	T_LightBatch
   //
-  //	After the map has been loaded, scan each sector for specials
-  //	that spawn thinkers
+  //	Runs the flashes, then the strobes, then the glows of a batch,
+  //	each in the order they were added
   //
   //==================================================================
 */
-void T_LightFlash (lightflash_t *flash)
+void T_LightBatch (lightbatch_t *batch)
 {
-  if (--flash->count)
-    return;
+  int		i;
+  int		n;
+  int		level;
+  sector_t	*sec;
   
-  if (flash->sector->lightlevel == flash->maxlight)
+  /*
+   * broken light flashing: most tics only count down
+   */
+  n = batch->numflashes;
+  for (i=0 ; i<n ; i++)
+    batch->flashcount[i]--;
+  for (i=0 ; i<n ; i++)
     {
-      flash-> sector->lightlevel = flash->minlight;
-      flash->count = (P_Random()&flash->mintime)+1;
+      if (batch->flashcount[i])
+	continue;
+      sec = &sectors[batch->flashsector[i]];
+      if (sec->lightlevel == batch->flashmaxlight[i])
+	{
+	  sec->lightlevel = batch->flashminlight[i];
+	  batch->flashcount[i] = (P_Random()&batch->flashmintime[i])+1;
+	}
+      else
+	{
+	  sec->lightlevel = batch->flashmaxlight[i];
+	  batch->flashcount[i] = (P_Random()&batch->flashmaxtime[i])+1;
+	}
+      P_LightChanged (sec);
     }
-  else
+  
+  /*
+   * strobe light flashing
+   */
+  n = batch->numstrobes;
+  for (i=0 ; i<n ; i++)
+    batch->strobecount[i]--;
+  for (i=0 ; i<n ; i++)
     {
-      flash-> sector->lightlevel = flash->maxlight;
-      flash->count = (P_Random()&flash->maxtime)+1;
+      if (batch->strobecount[i])
+	continue;
+      sec = &sectors[batch->strobesector[i]];
+      if (sec->lightlevel == batch->strobeminlight[i])
+	{
+	  sec->lightlevel = batch->strobemaxlight[i];
+	  batch->strobecount[i] = batch->strobebrighttime[i];
+	}
+      else
+	{
+	  sec->lightlevel = batch->strobeminlight[i];
+	  batch->strobecount[i] = batch->strobedarktime[i];
+	}
+      P_LightChanged (sec);
     }
   
+  /*
+   * glowing light, turning at the ends
+   */
+  n = batch->numglows;
+  for (i=0 ; i<n ; i++)
+    {
+      sec = &sectors[batch->glowsector[i]];
+      level = sec->lightlevel + GLOWSPEED*batch->glowdirection[i];
+      if (batch->glowdirection[i] == -1 && level <= batch->glowminlight[i])
+	batch->glowdirection[i] = 1;
+      else if (batch->glowdirection[i] == 1 && level >= batch->glowmaxlight[i])
+	batch->glowdirection[i] = -1;
+      else if (level != sec->lightlevel)
+	{
+	  sec->lightlevel = level;
+	  P_LightChanged (sec);
+	}
+    }
 }
 
+/*
+ * True if one of count effects in secnums lights secnum.
+ */
+static boolean P_LightsSector (int *secnums, int count, int secnum)
+{
+  int		i;
+  
+  for (i=0 ; i<count ; i++)
+    if (secnums[i] == secnum)
+      return true;
+  return false;
+}
 
 /*
   //==================================================================
   //
-  //	P_SpawnLightFlash
+  //	P_LastLightBatch
   //
-  //	After the map has been loaded, scan each sector for specials 
-  //     that spawn thinkers
+  //	An effect can join the batch at the end of the thinker list
+  //	unless it is full or an effect of another kind lights the
+  //	same sector there, as the kinds run one after the other.
+  //	Otherwise it starts a new batch
   //
   //==================================================================
 */
-void P_SpawnLightFlash (sector_t *sector)
+static lightbatch_t *P_LastLightBatch (void)
+{
+  if (thinkercap.prev->function.acp1 != (actionf_p1)T_LightBatch)
+    return NULL;
+  return (lightbatch_t *)thinkercap.prev;
+}
+
+static lightbatch_t *P_NewLightBatch (void)
 {
-  lightflash_t	*flash;
+  lightbatch_t	*batch;
   
-  sector->special = 0;		/* nothing special about it during gameplay */
+  batch = Z_Malloc (sizeof(*batch), PU_LEVSPEC, 0);
+  P_AddThinker (&batch->thinker);
+  batch->thinker.function.acp1 = (actionf_p1)T_LightBatch;
+  batch->numflashes = batch->numstrobes = batch->numglows = 0;
+  return batch;
+}
+
+/*
+ * The P_Add functions put one effect, as the spawn functions and
+ * savegames make them, into a batch.
+ */
+void P_AddLightFlash (lightflash_t *flash)
+{
+  lightbatch_t	*batch;
+  int		secnum = flash->sector-sectors;
+  int		i;
   
-  flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
-  P_AddThinker (&flash->thinker);
-  flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
-  flash->sector = sector;
-  flash->maxlight = sector->lightlevel;
+  batch = P_LastLightBatch ();
+  if (!batch || batch->numflashes == LIGHTBATCH
+      || P_LightsSector (batch->strobesector, batch->numstrobes, secnum)
+      || P_LightsSector (batch->glowsector, batch->numglows, secnum))
+    batch = P_NewLightBatch ();
+  i = batch->numflashes++;
+  batch->flashsector[i] = secnum;
+  batch->flashcount[i] = flash->count;
+  batch->flashmaxlight[i] = flash->maxlight;
+  batch->flashminlight[i] = flash->minlight;
+  batch->flashmaxtime[i] = flash->maxtime;
+  batch->flashmintime[i] = flash->mintime;
+}
+
+void P_AddStrobeFlash (strobe_t *flash)
+{
+  lightbatch_t	*batch;
+  int		secnum = flash->sector-sectors;
+  int		i;
   
-  flash->minlight = P_FindMinSurroundingLight(sector,sector->lightlevel);
-  flash->maxtime = 64;
-  flash->mintime = 7;
-  flash->count = (P_Random()&flash->maxtime)+1;
+  batch = P_LastLightBatch ();
+  if (!batch || batch->numstrobes == LIGHTBATCH
+      || P_LightsSector (batch->flashsector, batch->numflashes, secnum)
+      || P_LightsSector (batch->glowsector, batch->numglows, secnum))
+    batch = P_NewLightBatch ();
+  i = batch->numstrobes++;
+  batch->strobesector[i] = secnum;
+  batch->strobecount[i] = flash->count;
+  batch->strobeminlight[i] = flash->minlight;
+  batch->strobemaxlight[i] = flash->maxlight;
+  batch->strobedarktime[i] = flash->darktime;
+  batch->strobebrighttime[i] = flash->brighttime;
 }
 
-/*
-  //==================================================================
-  //
-  //			   STROBE LIGHT FLASHING
-  //
-  //==================================================================
-*/
+void P_AddGlowingLight (glow_t *g)
+{
+  lightbatch_t	*batch;
+  int		secnum = g->sector-sectors;
+  int		i;
+  
+  batch = P_LastLightBatch ();
+  if (!batch || batch->numglows == LIGHTBATCH
+      || P_LightsSector (batch->flashsector, batch->numflashes, secnum)
+      || P_LightsSector (batch->strobesector, batch->numstrobes, secnum))
+    batch = P_NewLightBatch ();
+  i = batch->numglows++;
+  batch->glowsector[i] = secnum;
+  batch->glowminlight[i] = g->minlight;
+  batch->glowmaxlight[i] = g->maxlight;
+  batch->glowdirection[i] = g->direction;
+}
 
 /*
   //==================================================================
   //
-  //	T_StrobeFlash
+  //	P_SpawnLightFlash
   //
   //	After the map has been loaded, scan each sector for specials 
   //     that spawn thinkers
   //
   //==================================================================
 */
-void T_StrobeFlash (strobe_t *flash)
+void P_SpawnLightFlash (sector_t *sector)
 {
-  if (--flash->count)
-    return;
+  lightflash_t	flash;
   
-  if (flash->sector->lightlevel == flash->minlight)
-    {
-      flash-> sector->lightlevel = flash->maxlight;
-      flash->count = flash->brighttime;
-    }
-  else
-    {
-      flash-> sector->lightlevel = flash->minlight;
-      flash->count =flash->darktime;
-    }
+  sector->special = 0;		/* nothing special about it during gameplay */
+  
+  flash.sector = sector;
+  flash.maxlight = sector->lightlevel;
   
+  flash.minlight = P_FindMinSurroundingLight(sector,sector->lightlevel);
+  flash.maxtime = 64;
+  flash.mintime = 7;
+  flash.count = (P_Random()&flash.maxtime)+1;
+  P_AddLightFlash (&flash);
 }
 
 /*
   //==================================================================
   //
-  //	P_SpawnLightFlash
+  //	P_SpawnStrobeFlash
   //
   //	After the map has been loaded, scan each sector for specials 
   //     that spawn thinkers
@@ -116,25 +260,23 @@ void T_StrobeFlash (strobe_t *flash)
 */
 void P_SpawnStrobeFlash (sector_t *sector,int fastOrSlow, int inSync)
 {
-  strobe_t	*flash;
+  strobe_t	flash;
   
-  flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
-  P_AddThinker (&flash->thinker);
-  flash->sector = sector;
-  flash->darktime = fastOrSlow;
-  flash->brighttime = STROBEBRIGHT;
-  flash->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
-  flash->maxlight = sector->lightlevel;
-  flash->minlight = P_FindMinSurroundingLight(sector, sector->lightlevel);
+  flash.sector = sector;
+  flash.darktime = fastOrSlow;
+  flash.brighttime = STROBEBRIGHT;
+  flash.maxlight = sector->lightlevel;
+  flash.minlight = P_FindMinSurroundingLight(sector, sector->lightlevel);
   
-  if (flash->minlight == flash->maxlight)
-    flash->minlight = 0;
+  if (flash.minlight == flash.maxlight)
+    flash.minlight = 0;
   sector->special = 0;		/* nothing special about it during gameplay */
   
   if (!inSync)
-    flash->count = (P_Random()&7)+1;
+    flash.count = (P_Random()&7)+1;
   else
-    flash->count = 1;
+    flash.count = 1;
+  P_AddStrobeFlash (&flash);
 }
 
 /*
@@ -191,6 +333,7 @@ void EV_TurnTagLightsOff(line_t	*line)
 	      min = tsec->lightlevel;
 	  }
 	sector->lightlevel = min;
+	P_LightChanged (sector);
       }
 }
 
@@ -231,6 +374,7 @@ void EV_LightTurnOn(line_t *line, int bright)
 	      }
 	  }
 	sector-> lightlevel = bright;
+	P_LightChanged (sector);
       }
 }
 
@@ -241,42 +385,15 @@ void EV_LightTurnOn(line_t *line, int bright)
   //
   //==================================================================
 */
-void T_Glow(glow_t *g)
-{
-  switch(g->direction)
-    {
-    case -1:		/* DOWN */
-      g->sector->lightlevel -= GLOWSPEED;
-      if (g->sector->lightlevel <= g->minlight)
-	{
-	  g->sector->lightlevel += GLOWSPEED;
-	  g->direction = 1;
-	}
-      break;
-    case 1:		/* UP */
-      g->sector->lightlevel += GLOWSPEED;
-      if (g->sector->lightlevel >= g->maxlight)
-	{
-	  g->sector->lightlevel -= GLOWSPEED;
-	  g->direction = -1;
-	}
-      break;
-    }
-}
-
 void P_SpawnGlowingLight(sector_t *sector)
 {
-  glow_t	*g;
+  glow_t	g;
   
-  g = Z_Malloc( sizeof(*g), PU_LEVSPEC, 0);
-  P_AddThinker(&g->thinker);
-  g->sector = sector;
-  g->minlight = P_FindMinSurroundingLight(sector,sector->lightlevel);
-  g->maxlight = sector->lightlevel;
-  g->thinker.function.acp1 = (actionf_p1)T_Glow;
-  g->direction = -1;
+  g.sector = sector;
+  g.minlight = P_FindMinSurroundingLight(sector,sector->lightlevel);
+  g.maxlight = sector->lightlevel;
+  g.direction = -1;
+  P_AddGlowingLight(&g);
   
   sector->special = 0;
 }
-
-
@@ -73,6 +73,25 @@ extern int TimerGame;        /* tic countdown for deathmatch */
 void P_InitThinkers(void);
 void P_AddThinker(thinker_t *thinker);
 void P_RemoveThinker(thinker_t *thinker);
+void P_ArchiveWorldFrom(sector_t *secs, int nsecs, line_t *lns, int nlns,
+			side_t *sds);
+
+/* ***** P_SNAP ***** */
+
+typedef struct
+{
+  byte *data;     /* malloced, grows as needed */
+  size_t length;
+  size_t size;
+} snapshot_t;
+
+void P_SnapshotWorld(snapshot_t *snap);
+void P_RestoreWorld(snapshot_t *snap);
+
+extern boolean predicting;	/* running predicted tics, no side effects */
+void P_StartPrediction(player_t *player);
+void P_PredictTic(ticcmd_t *cmd);
+void P_EndPrediction(void);
 
 /* ***** P_PSPR ***** */
 
@@ -104,6 +123,8 @@ void P_UpdateBeak(player_t *player, pspdef_t *psp);
 /* ***** P_USER ***** */
 
 void P_PlayerThink(player_t *player);
+void P_MovePlayer(player_t *player);
+void P_CalcHeight(player_t *player);
 void P_Thrust(player_t *player, angle_t angle, fixed_t move);
 void P_PlayerRemoveArtifact(player_t *player, int slot);
 void P_PlayerUseArtifact(player_t *player, artitype_t arti);
@@ -121,16 +142,34 @@ int P_GetPlayerNum(player_t *player);
 #define ONCEILINGZ MAXINT
 #define FLOATRANDZ (MAXINT-1)
 
+/*
+ * What a state change needs of a state, packed from states[] by
+ * P_InitStates so that four states fit in a cache line
+ */
+typedef struct
+{
+  short sprite;
+  unsigned short frame; /* might be ord with FF_FULLBRIGHT */
+  short tics;
+  short nextstate;
+  actionf_p1 action;
+} mobjstate_t;
+
 extern mobjtype_t PuffType;
 extern mobj_t *MissileMobj;
+extern mobjstate_t mobjstates[NUMSTATES];
 
+void P_InitStates(void);
 mobj_t *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type);
+void P_StopInterpolation(mobj_t *mo);
 void P_RemoveMobj(mobj_t *th);
 boolean	P_SetMobjState(mobj_t *mobj, statenum_t state);
 boolean	P_SetMobjStateNF(mobj_t *mobj, statenum_t state);
 void P_ThrustMobj(mobj_t *mo, angle_t angle, fixed_t move);
 int P_FaceMobj(mobj_t *source, mobj_t *target, angle_t *delta);
 boolean P_SeekerMissile(mobj_t *actor, angle_t thresh, angle_t turnMax);
+void P_XYMovement(mobj_t *mo);
+void P_ZMovement(mobj_t *mo);
 void P_MobjThinker(mobj_t *mobj);
 void P_BlasterMobjThinker(mobj_t *mobj);
 void P_SpawnPuff(fixed_t x, fixed_t y, fixed_t z);
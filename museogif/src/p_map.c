@@ -374,6 +374,10 @@ boolean PIT_CheckThing(mobj_t *thing)
 	}
       return(false);
     }
+  if(predicting)
+    { /* a predicted move only finds out what blocks it */
+      return(!(thing->flags&MF_SOLID));
+    }
   if(thing->flags2&MF2_PUSHABLE && !(tmthing->flags2&MF2_CANNOTPUSH))
     { /* Push thing */
       thing->momx += tmthing->momx>>2;
@@ -828,7 +832,7 @@ boolean P_TryMove(mobj_t *thing, fixed_t x, fixed_t y)
   /*
    * if any special lines were hit, do the effect
    */
-  if (! (thing->flags&(MF_TELEPORT|MF_NOCLIP)) )
+  if (! (thing->flags&(MF_TELEPORT|MF_NOCLIP)) && !predicting)
     while (numspechit--)
       {
 	/* see if the line was crossed */
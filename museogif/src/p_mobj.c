@@ -11,6 +11,7 @@ void P_SpawnMapThing (mapthing_t *mthing);
 
 mobjtype_t PuffType;
 mobj_t *MissileMobj;
+mobjstate_t mobjstates[NUMSTATES];
 
 static fixed_t FloatBobOffsets[64] =
 {
@@ -32,6 +33,35 @@ static fixed_t FloatBobOffsets[64] =
   -200637, -152193, -102284, -51389
 };
 
+/*
+  //----------------------------------------------------------------------------
+  //
+  // PROC P_InitStates
+  //
+  // Packs states[] into mobjstates[].
+  //
+  //----------------------------------------------------------------------------
+*/
+void P_InitStates(void)
+{
+  int i;
+  state_t *st;
+  mobjstate_t *ms;
+  
+  for(i = 0, st = states, ms = mobjstates; i < NUMSTATES; i++, st++, ms++)
+    {
+      ms->sprite = st->sprite;
+      ms->frame = st->frame;
+      ms->tics = st->tics;
+      ms->nextstate = st->nextstate;
+      ms->action = st->action.acp1;
+      if(ms->frame != st->frame || ms->tics != st->tics)
+	{
+	  I_Error("P_InitStates: state %i doesn't pack", i);
+	}
+    }
+}
+
 /*
   //----------------------------------------------------------------------------
   //
@@ -43,7 +73,7 @@ static fixed_t FloatBobOffsets[64] =
 */
 boolean P_SetMobjState(mobj_t *mobj, statenum_t state)
 {
-  state_t *st;
+  mobjstate_t *st;
   
   if(state == S_NULL)
     { /* Remove mobj */
@@ -51,14 +81,14 @@ boolean P_SetMobjState(mobj_t *mobj, statenum_t state)
       P_RemoveMobj(mobj);
       return(false);
     }
-  st = &states[state];
-  mobj->state = st;
+  st = &mobjstates[state];
+  mobj->state = &states[state];
   mobj->tics = st->tics;
   mobj->sprite = st->sprite;
   mobj->frame = st->frame;
-  if(st->action.acp1)
+  if(st->action)
     { /* Call action function */
-      st->action.acp1(mobj);
+      st->action(mobj);
     }
   return(true);
 }
@@ -74,7 +104,7 @@ boolean P_SetMobjState(mobj_t *mobj, statenum_t state)
 */
 boolean P_SetMobjStateNF(mobj_t *mobj, statenum_t state)
 {
-  state_t *st;
+  mobjstate_t *st;
   
   if(state == S_NULL)
     { /* Remove mobj */
@@ -82,8 +112,8 @@ boolean P_SetMobjStateNF(mobj_t *mobj, statenum_t state)
       P_RemoveMobj(mobj);
       return(false);
     }
-  st = &states[state];
-  mobj->state = st;
+  st = &mobjstates[state];
+  mobj->state = &states[state];
   mobj->tics = st->tics;
   mobj->sprite = st->sprite;
   mobj->frame = st->frame;
@@ -710,7 +740,8 @@ void P_BlasterMobjThinker(mobj_t *mobj)
       mobj->tics--;
       while(!mobj->tics)
 	{
-	  if(!P_SetMobjState(mobj, mobj->state->nextstate))
+	  if(!P_SetMobjState(mobj,
+			     mobjstates[mobj->state-states].nextstate))
 	    { /* mobj was removed */
 	      return;
 	    }
@@ -796,7 +827,8 @@ void P_MobjThinker(mobj_t *mobj)
       /* you can cycle through multiple states in a tic */
       while(!mobj->tics)
 	{
-	  if(!P_SetMobjState(mobj, mobj->state->nextstate))
+	  if(!P_SetMobjState(mobj,
+			     mobjstates[mobj->state-states].nextstate))
 	    { /* mobj was removed */
 	      return;
 	    }
@@ -913,11 +945,31 @@ mobj_t *P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type)
       mobj->flags2 &= ~MF2_FEETARECLIPPED;
     }
   
+  P_StopInterpolation(mobj);
   mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
   P_AddThinker(&mobj->thinker);
   return(mobj);
 }
 
+/*
+  ===============
+  =
+  = P_StopInterpolation
+  =
+  = Makes -uncapped frames show mo where it is, not on its way there
+  = from where the tic found it: for spawns and teleports
+  =
+  ===============
+*/
+
+void P_StopInterpolation(mobj_t *mo)
+{
+  mo->oldx = mo->x;
+  mo->oldy = mo->y;
+  mo->oldz = mo->z;
+  mo->oldangle = mo->angle;
+}
+
 /*
   ===============
   =
@@ -974,6 +1026,7 @@ void P_SpawnPlayer(mapthing_t *mthing)
     mobj->flags |= (mthing->type-1)<<MF_TRANSSHIFT;
   
   mobj->angle = ANG45 * (mthing->angle/45);
+  P_StopInterpolation(mobj);
   mobj->player = p;
   mobj->health = p->health;
   p->mo = mobj;
@@ -1304,6 +1357,10 @@ int P_HitFloor(mobj_t *thing)
     { /* don't splash if landing on the edge above water/lava/etc.... */
       return(FLOOR_SOLID);
     }
+  if(predicting)
+    {
+      return(P_GetThingFloorType(thing));
+    }
   switch(P_GetThingFloorType(thing))
     {
     case FLOOR_WATER:
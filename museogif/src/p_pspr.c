@@ -272,6 +272,7 @@ void P_RepositionMace(mobj_t *mo)
   mo->z = mo->floorz = ss->sector->floorheight;
   mo->ceilingz = ss->sector->ceilingheight;
   P_SetThingPosition(mo);
+  P_StopInterpolation(mo);
 }
 
 /*
@@ -180,6 +180,7 @@ void P_LoadSectors (int lump)
       ss->floorpic = R_FlatNumForName(ms->floorpic);
       ss->ceilingpic = R_FlatNumForName(ms->ceilingpic);
       ss->lightlevel = SHORT(ms->lightlevel);
+      P_LightChanged (ss);
       ss->special = SHORT(ms->special);
       ss->tag = SHORT(ms->tag);
       ss->thinglist = NULL;
@@ -528,6 +529,8 @@ void P_SetupLevel (int episode, int map, int __attribute__((unused)) playermask,
   S_Start ();		/* make sure all sounds are stopped before Z_FreeTags */
   
   Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
+  movedsectors = NULL;		/* they went with the old level */
+  changedlights = NULL;
   
   P_InitThinkers ();
   
@@ -614,6 +617,7 @@ void P_SetupLevel (int episode, int map, int __attribute__((unused)) playermask,
 
 void P_Init (void)
 {	
+  P_InitStates();
   P_InitSwitchList();
   P_InitPicAnims();
   P_InitTerrainTypes();
@@ -0,0 +1,868 @@
+/* P_snap.c */
+
+/*
+  ==============================================================================
+
+  EXACT WORLD SNAPSHOTS
+
+  Unlike the savegame archive, a snapshot keeps everything the playsim
+  looks at: the thinker list in order (including ceilings and plats in
+  stasis and thinkers removed but not yet freed), mobj targets and the
+  special1/special2 pointers, sector and block thing chains, the RNG
+  indices and the ambient sound sequence.  Restoring one and running the
+  same ticcmds gives the same game, so demos can be resumed from a
+  keyframe.
+
+  Pointers are stored as indices: thinkers as 1 + their position in the
+  list (0 is NULL), states, subsectors, sectors and lines as array
+  indices.  A pointer to a thinker that no longer exists is stored as
+  SNAP_DANGLING.  The data is only meant to be read back by the same
+  binary on the same level.
+
+  ==============================================================================
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "doomdef.h"
+#include "p_local.h"
+#include "soundst.h"
+
+#define SNAPMAGIC 0x50414e53 /* "SNAP" */
+#define SNAP_DANGLING -1
+
+#define SNAPF_SPECIAL1 1     /* mobj special1 is a thinker reference */
+#define SNAPF_SPECIAL2 2
+#define SNAPF_MOBJ 4         /* restore time only: needs SN_LinkMobj */
+
+extern int prndindex;
+extern int AmbSndSeqInit[];
+extern int *LevelAmbientSfx[];
+extern int *AmbSfxPtr;
+extern int AmbSfxCount;
+extern int AmbSfxTics;
+extern int AmbSfxVolume;
+extern mobj_t *bodyque[];
+extern int newtorch;
+extern int newtorchdelta;
+
+#define BODYQUESIZE 32
+
+typedef struct
+{
+  actionf_p1 function;
+  size_t size;
+  int sectoroffset;          /* -1 for mobjs, -2 for none */
+} snapclass_t;
+
+enum
+{
+  sc_mobj,
+  sc_blaster,
+  sc_ceiling,
+  sc_door,
+  sc_floor,
+  sc_plat,
+  sc_lights,
+  NUMSNAPCLASSES,
+  sc_removed = NUMSNAPCLASSES /* freed on its next turn, stored by size */
+};
+
+static snapclass_t snapclasses[NUMSNAPCLASSES] =
+{
+  { (actionf_p1)P_MobjThinker, sizeof(mobj_t), -1 },
+  { (actionf_p1)P_BlasterMobjThinker, sizeof(mobj_t), -1 },
+  { (actionf_p1)T_MoveCeiling, sizeof(ceiling_t), offsetof(ceiling_t, sector) },
+  { (actionf_p1)T_VerticalDoor, sizeof(vldoor_t), offsetof(vldoor_t, sector) },
+  { (actionf_p1)T_MoveFloor, sizeof(floormove_t), offsetof(floormove_t, sector) },
+  { (actionf_p1)T_PlatRaise, sizeof(plat_t), offsetof(plat_t, sector) },
+  { (actionf_p1)T_LightBatch, sizeof(lightbatch_t), -2 } /* sector numbers */
+};
+
+/*
+ * thinker pointer -> index hash, rebuilt for every snapshot
+ */
+static thinker_t **snaphash;
+static int *snaphashindex;
+static int snaphashsize;
+
+/* index -> thinker and its SNAPF_ flags, rebuilt for every restore */
+static thinker_t **snapthinkers;
+static byte *snapflags;
+static int snapthinkerssize;
+
+static snapshot_t *snap_w;   /* snapshot being written */
+static byte *snap_r;         /* read position of the snapshot being restored */
+
+/* ============================================================================= */
+
+static void SN_Write(void *data, size_t size)
+{
+  if(snap_w->length+size > snap_w->size)
+    {
+      snap_w->size = (snap_w->length+size)*2;
+      snap_w->data = realloc(snap_w->data, snap_w->size);
+      if(!snap_w->data)
+	{
+	  I_Error("P_SnapshotWorld: couldn't grow to %lu bytes",
+		  (unsigned long)snap_w->size);
+	}
+    }
+  memcpy(snap_w->data+snap_w->length, data, size);
+  snap_w->length += size;
+}
+
+static void SN_WriteInt(int val)
+{
+  SN_Write(&val, sizeof(int));
+}
+
+static void SN_Read(void *data, size_t size)
+{
+  memcpy(data, snap_r, size);
+  snap_r += size;
+}
+
+static int SN_ReadInt(void)
+{
+  int val;
+
+  SN_Read(&val, sizeof(int));
+  return val;
+}
+
+/* ============================================================================= */
+
+static unsigned SN_Hash(void *ptr)
+{
+  return (unsigned)(((size_t)ptr>>3)*2654435761u)&(snaphashsize-1);
+}
+
+static void SN_BuildHash(int count)
+{
+  thinker_t *th;
+  unsigned h;
+  int i;
+
+  if(count*2 > snaphashsize)
+    {
+      for(snaphashsize = 256; snaphashsize < count*2; snaphashsize <<= 1)
+	;
+      free(snaphash);
+      free(snaphashindex);
+      snaphash = malloc(snaphashsize*sizeof(*snaphash));
+      snaphashindex = malloc(snaphashsize*sizeof(*snaphashindex));
+      if(!snaphash || !snaphashindex)
+	{
+	  I_Error("P_SnapshotWorld: no memory for %i thinkers", count);
+	}
+    }
+  memset(snaphash, 0, snaphashsize*sizeof(*snaphash));
+  for(i = 1, th = thinkercap.next; th != &thinkercap; th = th->next, i++)
+    {
+      for(h = SN_Hash(th); snaphash[h]; h = (h+1)&(snaphashsize-1))
+	;
+      snaphash[h] = th;
+      snaphashindex[h] = i;
+    }
+}
+
+/*
+ * Returns 0 for NULL, the thinker number for a live thinker and
+ * SNAP_DANGLING for anything else.
+ */
+static int SN_ThinkerRef(void *ptr)
+{
+  unsigned h;
+
+  if(!ptr)
+    {
+      return 0;
+    }
+  for(h = SN_Hash(ptr); snaphash[h]; h = (h+1)&(snaphashsize-1))
+    {
+      if(snaphash[h] == ptr)
+	{
+	  return snaphashindex[h];
+	}
+    }
+  return SNAP_DANGLING;
+}
+
+/*
+ * A dangling reference can't be brought back.  Point it at a dummy so
+ * "is anything there" tests still behave; nothing valid is dereferenced.
+ */
+static mobj_t snapdangling;
+
+static void *SN_Thinker(int ref)
+{
+  if(ref == 0)
+    {
+      return NULL;
+    }
+  if(ref == SNAP_DANGLING)
+    {
+      return &snapdangling;
+    }
+  return snapthinkers[ref-1];
+}
+
+/* ============================================================================= */
+
+static int SN_Class(thinker_t *th)
+{
+  int i;
+  size_t blocksize;
+
+  if(th->function.acv == (actionf_v)-1)
+    {
+      return sc_removed;
+    }
+  if(th->function.acv == (actionf_v)NULL)
+    { /* In stasis */
+      for(i = 0; i < MAXCEILINGS; i++)
+	{
+	  if(activeceilings[i] == (ceiling_t *)th)
+	    {
+	      return sc_ceiling;
+	    }
+	}
+      for(i = 0; i < MAXPLATS; i++)
+	{
+	  if(activeplats[i] == (plat_t *)th)
+	    {
+	      return sc_plat;
+	    }
+	}
+      I_Error("P_SnapshotWorld: unknown thinker in stasis");
+    }
+  for(i = 0; i < NUMSNAPCLASSES; i++)
+    {
+      if(th->function.acp1 == snapclasses[i].function)
+	{
+	  return i;
+	}
+    }
+  blocksize = ((memblock_t *)((byte *)th-sizeof(memblock_t)))->size;
+  I_Error("P_SnapshotWorld: unknown thinker (%lu bytes)",
+	  (unsigned long)blocksize);
+  return 0;
+}
+
+static void SN_WriteMobj(mobj_t *mo)
+{
+  mobj_t dest;
+  byte flags;
+  int ref;
+
+  memcpy(&dest, mo, sizeof(mobj_t));
+  dest.snext = (mobj_t *)(long)SN_ThinkerRef(mo->snext);
+  dest.sprev = (mobj_t *)(long)SN_ThinkerRef(mo->sprev);
+  dest.bnext = (mobj_t *)(long)SN_ThinkerRef(mo->bnext);
+  dest.bprev = (mobj_t *)(long)SN_ThinkerRef(mo->bprev);
+  dest.target = (mobj_t *)(long)SN_ThinkerRef(mo->target);
+  dest.subsector = (subsector_t *)(mo->subsector-subsectors);
+  dest.state = (state_t *)(mo->state ? mo->state-states+1 : 0);
+  dest.player = (player_t *)(mo->player ? mo->player-players+1 : 0);
+  dest.info = NULL;
+
+  /* special1/2 are ints or mobj pointers depending on the type */
+  flags = 0;
+  if(mo->special1 && (ref = SN_ThinkerRef((void *)mo->special1)) > 0)
+    {
+      dest.special1 = ref;
+      flags |= SNAPF_SPECIAL1;
+    }
+  if(mo->special2 && (ref = SN_ThinkerRef((void *)mo->special2)) > 0)
+    {
+      dest.special2 = ref;
+      flags |= SNAPF_SPECIAL2;
+    }
+  SN_Write(&flags, 1);
+  SN_Write(&dest, sizeof(mobj_t));
+}
+
+static void SN_WritePlayer(player_t *player)
+{
+  player_t dest;
+  int i;
+
+  memcpy(&dest, player, sizeof(player_t));
+  dest.mo = (mobj_t *)(long)SN_ThinkerRef(player->mo);
+  dest.attacker = (mobj_t *)(long)SN_ThinkerRef(player->attacker);
+  dest.rain1 = (mobj_t *)(long)SN_ThinkerRef(player->rain1);
+  dest.rain2 = (mobj_t *)(long)SN_ThinkerRef(player->rain2);
+  dest.message = NULL;
+  for(i = 0; i < NUMPSPRITES; i++)
+    {
+      dest.psprites[i].state = (state_t *)(player->psprites[i].state
+		     ? player->psprites[i].state-states+1 : 0);
+    }
+  SN_Write(&dest, sizeof(player_t));
+}
+
+/*
+  ====================
+  =
+  = P_SnapshotWorld
+  =
+  = Replaces the contents of <snap> with the current level state.  The
+  = buffer is reused and only grows, so repeated snapshots don't allocate.
+  =
+  ====================
+*/
+
+void P_SnapshotWorld(snapshot_t *snap)
+{
+  thinker_t *th;
+  sector_t *sec;
+  line_t *li;
+  side_t *si;
+  int i, count, class, seq;
+  size_t size;
+  byte *best;
+
+  snap_w = snap;
+  snap->length = 0;
+
+  count = 0;
+  for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+      count++;
+    }
+  SN_BuildHash(count);
+
+  SN_WriteInt(SNAPMAGIC);
+  SN_WriteInt(numsectors);
+  SN_WriteInt(numlines);
+  SN_WriteInt(numsides);
+  SN_WriteInt(bmapwidth*bmapheight);
+  SN_WriteInt(count);
+
+  /* Globals */
+  SN_WriteInt(leveltime);
+  SN_WriteInt(TimerGame);
+  SN_WriteInt(prndindex);
+  SN_WriteInt(rndindex);
+  SN_WriteInt(validcount);
+  SN_WriteInt(newtorch);
+  SN_WriteInt(newtorchdelta);
+  SN_WriteInt(AmbSfxTics);
+  SN_WriteInt(AmbSfxVolume);
+  /* AmbSfxPtr points into one of the sequences, find which */
+  seq = -1;
+  best = (byte *)AmbSndSeqInit;
+  for(i = 0; i < AmbSfxCount; i++)
+    {
+      if((byte *)LevelAmbientSfx[i] <= (byte *)AmbSfxPtr
+	 && (byte *)LevelAmbientSfx[i] > best)
+	{
+	  best = (byte *)LevelAmbientSfx[i];
+	  seq = i;
+	}
+    }
+  if(best > (byte *)AmbSfxPtr)
+    {
+      I_Error("P_SnapshotWorld: bad ambient sequence");
+    }
+  SN_WriteInt(seq);
+  SN_WriteInt((int *)AmbSfxPtr-(int *)best);
+  SN_WriteInt(bodyqueslot);
+  for(i = 0; i < BODYQUESIZE; i++)
+    {
+      SN_WriteInt(SN_ThinkerRef(bodyque[i]));
+    }
+
+  /* Thinkers */
+  for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+      class = SN_Class(th);
+      SN_WriteInt(class);
+      if(class == sc_removed)
+	{ /* Other mobjs may still point at it, keep mobjs swizzled */
+	  size = ((memblock_t *)((byte *)th-sizeof(memblock_t)))->size
+	    -sizeof(memblock_t);
+	  SN_WriteInt(size);
+	  if(size >= sizeof(mobj_t))
+	    {
+	      SN_WriteMobj((mobj_t *)th);
+	    }
+	  else
+	    {
+	      SN_Write(th, size);
+	    }
+	  continue;
+	}
+      SN_WriteInt(th->function.acv == (actionf_v)NULL);
+      if(snapclasses[class].sectoroffset == -1)
+	{
+	  SN_WriteMobj((mobj_t *)th);
+	}
+      else
+	{
+	  SN_Write(th, snapclasses[class].size);
+	  if(snapclasses[class].sectoroffset != -2)
+	    {
+	      sec = *(sector_t **)((byte *)th+snapclasses[class].sectoroffset);
+	      SN_WriteInt(sec-sectors);
+	    }
+	}
+    }
+
+  for(i = 0; i < MAXPLAYERS; i++)
+    {
+      if(playeringame[i])
+	{
+	  SN_WritePlayer(&players[i]);
+	}
+    }
+
+  for(i = 0, sec = sectors; i < numsectors; i++, sec++)
+    {
+      SN_Write(&sec->floorheight, sizeof(fixed_t));
+      SN_Write(&sec->ceilingheight, sizeof(fixed_t));
+      SN_Write(&sec->floorpic, 5*sizeof(short));
+      SN_WriteInt(sec->soundtraversed);
+      SN_WriteInt(SN_ThinkerRef(sec->soundtarget));
+      SN_WriteInt(sec->validcount);
+      SN_WriteInt(SN_ThinkerRef(sec->thinglist));
+      SN_WriteInt(SN_ThinkerRef(sec->specialdata));
+    }
+  for(i = 0, li = lines; i < numlines; i++, li++)
+    {
+      SN_Write(&li->flags, 3*sizeof(short));
+      SN_WriteInt(li->validcount);
+      SN_WriteInt(SN_ThinkerRef(li->specialdata));
+    }
+  for(i = 0, si = sides; i < numsides; i++, si++)
+    {
+      SN_Write(&si->textureoffset, sizeof(fixed_t));
+      SN_Write(&si->rowoffset, sizeof(fixed_t));
+      SN_Write(&si->toptexture, 3*sizeof(short));
+    }
+  for(i = 0; i < bmapwidth*bmapheight; i++)
+    {
+      SN_WriteInt(SN_ThinkerRef(blocklinks[i]));
+    }
+
+  for(i = 0; i < MAXCEILINGS; i++)
+    {
+      SN_WriteInt(SN_ThinkerRef(activeceilings[i]));
+    }
+  for(i = 0; i < MAXPLATS; i++)
+    {
+      SN_WriteInt(SN_ThinkerRef(activeplats[i]));
+    }
+  for(i = 0; i < MAXBUTTONS; i++)
+    {
+      SN_WriteInt(buttonlist[i].line ? buttonlist[i].line-lines : -1);
+      SN_WriteInt(buttonlist[i].where);
+      SN_WriteInt(buttonlist[i].btexture);
+      SN_WriteInt(buttonlist[i].btimer);
+      SN_WriteInt(buttonlist[i].line ?
+		  (sector_t *)((byte *)buttonlist[i].soundorg
+			       -offsetof(sector_t, soundorg))-sectors : -1);
+    }
+}
+
+/* ============================================================================= */
+
+static byte SN_ReadMobj(mobj_t *mo)
+{
+  byte flags;
+
+  SN_Read(&flags, 1);
+  SN_Read(mo, sizeof(mobj_t));
+  mo->subsector = &subsectors[(long)mo->subsector];
+  mo->state = mo->state ? &states[(long)mo->state-1] : NULL;
+  mo->player = mo->player ? &players[(long)mo->player-1] : NULL;
+  mo->info = &mobjinfo[mo->type];
+  return flags|SNAPF_MOBJ;
+}
+
+/* Thinker references can only be resolved once all are allocated */
+static void SN_LinkMobj(mobj_t *mo, byte flags)
+{
+  mo->snext = SN_Thinker((long)mo->snext);
+  mo->sprev = SN_Thinker((long)mo->sprev);
+  mo->bnext = SN_Thinker((long)mo->bnext);
+  mo->bprev = SN_Thinker((long)mo->bprev);
+  mo->target = SN_Thinker((long)mo->target);
+  if(flags & SNAPF_SPECIAL1)
+    {
+      mo->special1 = (long)SN_Thinker(mo->special1);
+    }
+  if(flags & SNAPF_SPECIAL2)
+    {
+      mo->special2 = (long)SN_Thinker(mo->special2);
+    }
+}
+
+/*
+  ====================
+  =
+  = P_RestoreWorld
+  =
+  = Puts the level back into the state saved by P_SnapshotWorld.  The
+  = level itself (P_SetupLevel) must be the one the snapshot was taken on.
+  =
+  ====================
+*/
+
+void P_RestoreWorld(snapshot_t *snap)
+{
+  thinker_t *th, *next;
+  sector_t *sec;
+  line_t *li;
+  side_t *si;
+  player_t *player;
+  int i, j, count, class, stasis, seq, line;
+  size_t size;
+
+  snap_r = snap->data;
+  if(SN_ReadInt() != SNAPMAGIC || SN_ReadInt() != numsectors
+     || SN_ReadInt() != numlines || SN_ReadInt() != numsides
+     || SN_ReadInt() != bmapwidth*bmapheight)
+    {
+      I_Error("P_RestoreWorld: snapshot is from another level");
+    }
+  count = SN_ReadInt();
+
+  /* Throw away the current thinkers */
+  for(th = thinkercap.next; th != &thinkercap; th = next)
+    {
+      next = th->next;
+      if(th->function.acp1 == (actionf_p1)P_MobjThinker
+	 || th->function.acp1 == (actionf_p1)P_BlasterMobjThinker)
+	{
+	  S_StopSound(th);
+	}
+      Z_Free(th);
+    }
+  P_InitThinkers();
+
+  leveltime = SN_ReadInt();
+  TimerGame = SN_ReadInt();
+  prndindex = SN_ReadInt();
+  rndindex = SN_ReadInt();
+  validcount = SN_ReadInt();
+  newtorch = SN_ReadInt();
+  newtorchdelta = SN_ReadInt();
+  AmbSfxTics = SN_ReadInt();
+  AmbSfxVolume = SN_ReadInt();
+  seq = SN_ReadInt();
+  AmbSfxPtr = (seq == -1 ? AmbSndSeqInit : LevelAmbientSfx[seq])
+    +SN_ReadInt();
+  bodyqueslot = SN_ReadInt();
+  for(i = 0; i < BODYQUESIZE; i++)
+    {
+      bodyque[i] = (mobj_t *)(long)SN_ReadInt(); /* linked below */
+    }
+
+  if(count > snapthinkerssize)
+    {
+      snapthinkerssize = count*2;
+      free(snapthinkers);
+      free(snapflags);
+      snapthinkers = malloc(snapthinkerssize*sizeof(*snapthinkers));
+      snapflags = malloc(snapthinkerssize);
+      if(!snapthinkers || !snapflags)
+	{
+	  I_Error("P_RestoreWorld: no memory for %i thinkers", count);
+	}
+    }
+
+  /* Allocate every thinker, in the original order */
+  for(i = 0; i < count; i++)
+    {
+      class = SN_ReadInt();
+      snapflags[i] = 0;
+      if(class == sc_removed)
+	{
+	  size = SN_ReadInt();
+	  th = Z_Malloc(size, PU_LEVEL, NULL);
+	  if(size >= sizeof(mobj_t))
+	    {
+	      snapflags[i] = SN_ReadMobj((mobj_t *)th);
+	    }
+	  else
+	    {
+	      SN_Read(th, size);
+	    }
+	  P_AddThinker(th);
+	  th->function.acv = (actionf_v)-1;
+	  snapthinkers[i] = th;
+	  continue;
+	}
+      stasis = SN_ReadInt();
+      th = Z_Malloc(snapclasses[class].size, PU_LEVEL, NULL);
+      if(snapclasses[class].sectoroffset == -1)
+	{
+	  snapflags[i] = SN_ReadMobj((mobj_t *)th);
+	}
+      else
+	{
+	  SN_Read(th, snapclasses[class].size);
+	  if(snapclasses[class].sectoroffset != -2)
+	    {
+	      *(sector_t **)((byte *)th+snapclasses[class].sectoroffset) =
+		&sectors[SN_ReadInt()];
+	    }
+	}
+      P_AddThinker(th);
+      th->function.acp1 = stasis ? NULL : snapclasses[class].function;
+      snapthinkers[i] = th;
+    }
+
+  /* Now that everything exists, relink the mobjs */
+  for(i = 0; i < count; i++)
+    {
+      if(snapflags[i] & SNAPF_MOBJ)
+	{
+	  SN_LinkMobj((mobj_t *)snapthinkers[i], snapflags[i]);
+	}
+    }
+  for(i = 0; i < BODYQUESIZE; i++)
+    {
+      bodyque[i] = SN_Thinker((long)bodyque[i]);
+    }
+
+  for(i = 0; i < MAXPLAYERS; i++)
+    {
+      if(!playeringame[i])
+	{
+	  continue;
+	}
+      player = &players[i];
+      SN_Read(player, sizeof(player_t));
+      player->mo = SN_Thinker((long)player->mo);
+      player->attacker = SN_Thinker((long)player->attacker);
+      player->rain1 = SN_Thinker((long)player->rain1);
+      player->rain2 = SN_Thinker((long)player->rain2);
+      for(j = 0; j < NUMPSPRITES; j++)
+	{
+	  player->psprites[j].state = player->psprites[j].state
+	    ? &states[(long)player->psprites[j].state-1] : NULL;
+	}
+    }
+
+  for(i = 0, sec = sectors; i < numsectors; i++, sec++)
+    {
+      SN_Read(&sec->floorheight, sizeof(fixed_t));
+      SN_Read(&sec->ceilingheight, sizeof(fixed_t));
+      SN_Read(&sec->floorpic, 5*sizeof(short));
+      P_LightChanged(sec);
+      sec->soundtraversed = SN_ReadInt();
+      sec->soundtarget = SN_Thinker(SN_ReadInt());
+      sec->validcount = SN_ReadInt();
+      sec->thinglist = SN_Thinker(SN_ReadInt());
+      sec->specialdata = SN_Thinker(SN_ReadInt());
+    }
+  for(i = 0, li = lines; i < numlines; i++, li++)
+    {
+      SN_Read(&li->flags, 3*sizeof(short));
+      li->validcount = SN_ReadInt();
+      li->specialdata = SN_Thinker(SN_ReadInt());
+    }
+  for(i = 0, si = sides; i < numsides; i++, si++)
+    {
+      SN_Read(&si->textureoffset, sizeof(fixed_t));
+      SN_Read(&si->rowoffset, sizeof(fixed_t));
+      SN_Read(&si->toptexture, 3*sizeof(short));
+    }
+  for(i = 0; i < bmapwidth*bmapheight; i++)
+    {
+      blocklinks[i] = SN_Thinker(SN_ReadInt());
+    }
+
+  for(i = 0; i < MAXCEILINGS; i++)
+    {
+      activeceilings[i] = SN_Thinker(SN_ReadInt());
+    }
+  for(i = 0; i < MAXPLATS; i++)
+    {
+      activeplats[i] = SN_Thinker(SN_ReadInt());
+    }
+  for(i = 0; i < MAXBUTTONS; i++)
+    {
+      line = SN_ReadInt();
+      buttonlist[i].line = line == -1 ? NULL : &lines[line];
+      buttonlist[i].where = SN_ReadInt();
+      buttonlist[i].btexture = SN_ReadInt();
+      buttonlist[i].btimer = SN_ReadInt();
+      j = SN_ReadInt();
+      buttonlist[i].soundorg = j == -1 ? NULL : (mobj_t *)&sectors[j].soundorg;
+    }
+  P_ScheduleSpecials();
+}
+
+/*
+  ==============================================================================
+
+  PLAYER PREDICTION
+
+  In a net game the console player can be drawn where its own ticcmds
+  will take it, before the other players' tics for them have come in.
+  Only its movement is run: no specials are crossed, nothing is pushed
+  or picked up, no splashes are spawned and no sounds started (all of
+  it checks predicting), so nothing but its player_t, its mobj and the
+  RNG indices can change.  Those are copied aside and put back, which
+  costs two structure copies and relinking one mobj, so it can be done
+  for every frame that is drawn.
+
+  ==============================================================================
+*/
+
+boolean predicting;
+
+static player_t *predplayer;
+static player_t predsaved;
+static mobj_t predmobj;
+static int predleveltime;
+static int predrndindex;
+static int predprndindex;
+static boolean predonground;
+
+extern boolean onground;
+
+/*
+  ====================
+  =
+  = P_StartPrediction
+  =
+  ====================
+*/
+
+void P_StartPrediction(player_t *player)
+{
+  predplayer = player;
+  predsaved = *player;
+  predmobj = *player->mo;
+  predleveltime = leveltime;
+  predrndindex = rndindex;
+  predprndindex = prndindex;
+  predonground = onground;
+}
+
+/*
+  ====================
+  =
+  = P_PredictTic
+  =
+  = Runs the part of P_PlayerThink and P_MobjThinker that moves the
+  = player for one tic of <cmd>.
+  =
+  ====================
+*/
+
+void P_PredictTic(ticcmd_t *cmd)
+{
+  player_t *player = predplayer;
+  mobj_t *mo = player->mo;
+
+  predicting = true;
+  player->cmd = *cmd;
+  if(mo->flags&MF_JUSTATTACKED)
+    {
+      player->cmd.angleturn = 0;
+      player->cmd.forwardmove = 0xc800/512;
+      player->cmd.sidemove = 0;
+      mo->flags &= ~MF_JUSTATTACKED;
+    }
+  if(mo->reactiontime)
+    {
+      mo->reactiontime--;
+    }
+  else
+    {
+      P_MovePlayer(player);
+    }
+  P_CalcHeight(player);
+
+  if(mo->momx || mo->momy)
+    {
+      P_XYMovement(mo);
+    }
+  if(mo->z != mo->floorz || mo->momz)
+    {
+      if(!(mo->flags2&MF2_PASSMOBJ) || !P_CheckOnmobj(mo))
+	{
+	  P_ZMovement(mo);
+	}
+      else if(mo->momz < 0)
+	{ /* standing on something: the other mobj is left alone */
+	  mo->flags2 |= MF2_ONMOBJ;
+	  mo->momz = 0;
+	}
+    }
+  leveltime++;
+  predicting = false;
+}
+
+/*
+  ====================
+  =
+  = P_EndPrediction
+  =
+  = Puts the player back where the last real tic left it, in the same
+  = places of the sector and block thing chains.
+  =
+  ====================
+*/
+
+void P_EndPrediction(void)
+{
+  mobj_t *mo;
+  int blockx, blocky;
+
+  if(!predplayer)
+    {
+      return;
+    }
+  mo = predplayer->mo;
+  P_UnsetThingPosition(mo);
+  *mo = predmobj;
+
+  if(!(mo->flags&MF_NOSECTOR))
+    {
+      if(mo->sprev)
+	{
+	  mo->sprev->snext = mo;
+	}
+      else
+	{
+	  mo->subsector->sector->thinglist = mo;
+	}
+      if(mo->snext)
+	{
+	  mo->snext->sprev = mo;
+	}
+    }
+  if(!(mo->flags&MF_NOBLOCKMAP))
+    {
+      blockx = (mo->x-bmaporgx)>>MAPBLOCKSHIFT;
+      blocky = (mo->y-bmaporgy)>>MAPBLOCKSHIFT;
+      if(mo->bprev)
+	{
+	  mo->bprev->bnext = mo;
+	}
+      else if(blockx >= 0 && blockx < bmapwidth
+	      && blocky >= 0 && blocky < bmapheight)
+	{
+	  blocklinks[blocky*bmapwidth+blockx] = mo;
+	}
+      if(mo->bnext)
+	{
+	  mo->bnext->bprev = mo;
+	}
+    }
+
+  *predplayer = predsaved;
+  leveltime = predleveltime;
+  rndindex = predrndindex;
+  prndindex = predprndindex;
+  onground = predonground;
+  predplayer = NULL;
+}
@@ -946,81 +946,187 @@ void P_PlayerInSpecialSector(player_t *player)
     }
 }
 
+/*
+ * The timer wheel of P_UpdateSpecials: an anim is linked in the slot
+ * of the tic its picture changes next, a button in the slot of the tic
+ * it pops out, so a tic only looks at what is due then or a multiple of
+ * WHEELSIZE tics later.
+ */
+#define WHEELSIZE 64
+
+static anim_t *animwheel[WHEELSIZE];
+static button_t *buttonwheel[WHEELSIZE];
+
 /*
  * ----------------------------------------------------------------------------
  * 
- *  PROC P_UpdateSpecials
+ *  PROC P_AnimatePics
  * 
- *  Animate planes, scroll walls, etc.
+ *  Sets the translations of an anim for leveltime.
  * 
  * ----------------------------------------------------------------------------
  */
 
-void P_UpdateSpecials(void)
+static void P_AnimatePics(anim_t *anim)
 {
   int i;
   int pic;
+  
+  for(i = anim->basepic; i < anim->basepic+anim->numpics; i++)
+    {
+      pic = anim->basepic+((leveltime/anim->speed+i)%anim->numpics);
+      if(anim->istexture)
+	{
+	  texturetranslation[i] = pic;
+	}
+      else
+	{
+	  flattranslation[i] = pic;
+	}
+    }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ * 
+ *  PROC P_ScheduleAnim
+ * 
+ *  Links an anim in for the next tic after leveltime that its picture
+ *  changes.
+ * 
+ * ----------------------------------------------------------------------------
+ */
+
+static void P_ScheduleAnim(anim_t *anim)
+{
+  anim_t **slot;
+  
+  anim->nexttic = (leveltime/anim->speed+1)*anim->speed;
+  slot = &animwheel[anim->nexttic&(WHEELSIZE-1)];
+  anim->next = *slot;
+  *slot = anim;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ * 
+ *  PROC P_ScheduleButton
+ * 
+ *  Links a button in for its btimer, behind the buttons before it in
+ *  buttonlist so that they pop out in the same order as ever.
+ * 
+ * ----------------------------------------------------------------------------
+ */
+
+void P_ScheduleButton(button_t *button)
+{
+  button_t **link;
+  
+  link = &buttonwheel[button->btimer&(WHEELSIZE-1)];
+  while(*link && *link < button)
+    {
+      link = &(*link)->next;
+    }
+  button->next = *link;
+  *link = button;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ * 
+ *  PROC P_ScheduleSpecials
+ * 
+ *  Sets the anims for leveltime and builds the timer wheel again.
+ * 
+ * ----------------------------------------------------------------------------
+ */
+
+void P_ScheduleSpecials(void)
+{
+  int i;
   anim_t *anim;
-  line_t *line;
   
-  /* Animate flats and textures */
+  memset(animwheel, 0, sizeof(animwheel));
+  memset(buttonwheel, 0, sizeof(buttonwheel));
   for(anim = anims; anim < lastanim; anim++)
     {
-      for(i = anim->basepic; i < anim->basepic+anim->numpics; i++)
+      P_AnimatePics(anim);
+      P_ScheduleAnim(anim);
+    }
+  for(i = 0; i < MAXBUTTONS; i++)
+    {
+      if(buttonlist[i].btimer)
 	{
-	  pic = anim->basepic+((leveltime/anim->speed+i)%anim->numpics);
-	  if(anim->istexture)
-	    {
-	      texturetranslation[i] = pic;
-	    }
-	  else
-	    {
-	      flattranslation[i] = pic;
-	    }
+	  P_ScheduleButton(&buttonlist[i]);
 	}
     }
-  /* Update scrolling texture offsets */
-  for(i = 0; i < numlinespecials; i++)
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ * 
+ *  PROC P_UpdateSpecials
+ * 
+ *  Animate planes, scroll walls, etc.
+ * 
+ * ----------------------------------------------------------------------------
+ */
+
+void P_UpdateSpecials(void)
+{
+  int i;
+  int slot;
+  anim_t *anim, *nextanim;
+  button_t *button, *nextbutton;
+  
+  slot = leveltime&(WHEELSIZE-1);
+  
+  /* Animate flats and textures */
+  anim = animwheel[slot];
+  animwheel[slot] = NULL;
+  for(; anim; anim = nextanim)
     {
-      line = linespeciallist[i];
-      switch(line->special)
-	{
-	case 48: /* Effect_Scroll_Left */
-	  sides[line->sidenum[0]].textureoffset += FRACUNIT;
-	  break;
-	case 99: /* Effect_Scroll_Right */
-	  sides[line->sidenum[0]].textureoffset -= FRACUNIT;
-	  break;
+      nextanim = anim->next;
+      if(anim->nexttic != leveltime)
+	{ /* Due a turn of the wheel later */
+	  anim->next = animwheel[slot];
+	  animwheel[slot] = anim;
+	  continue;
 	}
+      P_AnimatePics(anim);
+      P_ScheduleAnim(anim);
+    }
+  /* Update scrolling texture offsets */
+  for(i = 0; i < numscrollers; i++)
+    {
+      scrollers[i].side->textureoffset += scrollers[i].speed;
     }
   /* Handle buttons */
-  for(i = 0; i < MAXBUTTONS; i++)
+  button = buttonwheel[slot];
+  buttonwheel[slot] = NULL;
+  for(; button; button = nextbutton)
     {
-      if(buttonlist[i].btimer)
+      nextbutton = button->next;
+      if(button->btimer != leveltime)
 	{
-	  buttonlist[i].btimer--;
-	  if(!buttonlist[i].btimer)
-	    {
-	      switch(buttonlist[i].where)
-		{
-		case top:
-		  sides[buttonlist[i].line->sidenum[0]].toptexture =
-		    buttonlist[i].btexture;
-		  break;
-		case middle:
-		  sides[buttonlist[i].line->sidenum[0]].midtexture =
-		    buttonlist[i].btexture;
-		  break;
-		case bottom:
-		  sides[buttonlist[i].line->sidenum[0]].bottomtexture =
-		    buttonlist[i].btexture;
-		  break;
-		}
-	      S_StartSound((mobj_t *)&buttonlist[i].soundorg, sfx_switch);
-	      memset(&buttonlist[i], 0, sizeof(button_t));
-	    }
+	  P_ScheduleButton(button);
+	  continue;
+	}
+      switch(button->where)
+	{
+	case top:
+	  sides[button->line->sidenum[0]].toptexture = button->btexture;
+	  break;
+	case middle:
+	  sides[button->line->sidenum[0]].midtexture = button->btexture;
+	  break;
+	case bottom:
+	  sides[button->line->sidenum[0]].bottomtexture = button->btexture;
+	  break;
 	}
-    }	
+      S_StartSound((mobj_t *)&button->soundorg, sfx_switch);
+      memset(button, 0, sizeof(button_t));
+    }
 }
 
 /*
@@ -1111,8 +1217,8 @@ int EV_DoDonut(line_t *line)
   ===============================================================================
 */
 
-short	numlinespecials;
-line_t	*linespeciallist[MAXLINEANIMS];
+int		numscrollers;
+scroller_t	*scrollers;
 
 void P_SpawnSpecials (void)
 {
@@ -1172,14 +1278,22 @@ void P_SpawnSpecials (void)
   /*
    *	Init line EFFECTs
    */
-  numlinespecials = 0;
+  numscrollers = 0;
+  for (i = 0;i < numlines; i++)
+    if (lines[i].special == 48 || lines[i].special == 99)
+      numscrollers++;
+  scrollers = Z_Malloc (numscrollers*sizeof(*scrollers), PU_LEVEL, 0);
+  numscrollers = 0;
   for (i = 0;i < numlines; i++)
     switch(lines[i].special)
       {
       case 48: /* Effect_Scroll_Left */
+	scrollers[numscrollers].side = &sides[lines[i].sidenum[0]];
+	scrollers[numscrollers++].speed = FRACUNIT;
+	break;
       case 99: /* Effect_Scroll_Right */
-	linespeciallist[numlinespecials] = &lines[i];
-	numlinespecials++;
+	scrollers[numscrollers].side = &sides[lines[i].sidenum[0]];
+	scrollers[numscrollers++].speed = -FRACUNIT;
 	break;
       }
   
@@ -1192,6 +1306,7 @@ void P_SpawnSpecials (void)
 	  activeplats[i] = NULL;
 	for (i = 0;i < MAXBUTTONS;i++)
 	  memset(&buttonlist[i],0,sizeof(button_t));
+	P_ScheduleSpecials();
 }
 
 /*
@@ -16,13 +16,15 @@
 /*
  *	Animating textures and planes
  */
-typedef struct
+typedef struct anim_s
 {
   boolean	istexture;
   int		picnum;
   int		basepic;
   int		numpics;
   int		speed;
+  int		nexttic;	/* when the picture changes next */
+  struct anim_s	*next;		/* in the same slot of the timer wheel */
 } anim_t;
 
 /*
@@ -42,11 +44,16 @@ extern	anim_t	anims[MAXANIMS], *lastanim;
 extern int *TerrainTypes;
 
 /*
- *	Animating line specials
+ *	Scrolling walls
  */
-#define	MAXLINEANIMS		64
-extern	short	numlinespecials;
-extern	line_t	*linespeciallist[MAXLINEANIMS];
+typedef struct
+{
+  side_t	*side;
+  fixed_t	speed;		/* added to the texture offset every tic */
+} scroller_t;
+
+extern	int	numscrollers;
+extern	scroller_t	*scrollers;
 
 /*	Define values for map objects */
 #define	MO_TELEPORTMAN		14
@@ -61,6 +68,9 @@ void P_SpawnSpecials(void);
 void P_InitAmbientSound(void);
 void P_AddAmbientSfx(int sequence);
 
+/* when leveltime or the buttons were loaded */
+void P_ScheduleSpecials(void);
+
 /* every tic */
 void P_UpdateSpecials(void);
 void P_AmbientSound(void);
@@ -96,6 +106,9 @@ int EV_DoDonut(line_t *line);
   
   ===============================================================================
 */
+/*
+ * One effect each, as savegames store them
+ */
 typedef struct
 {
   thinker_t	thinker;
@@ -127,19 +140,56 @@ typedef struct
   int	        direction;
 } glow_t;
 
+/*
+ * The effects run as batches, one thinker for effects started one
+ * right after the other, each kind kept as arrays.  A batch stands
+ * where the thinkers of its effects used to, so the lights still take
+ * their random numbers in the same order.
+ */
+#define LIGHTBATCH		32
+
+typedef struct
+{
+  thinker_t	thinker;
+  
+  int		numflashes;
+  int		flashsector[LIGHTBATCH];	/* sector numbers */
+  int		flashcount[LIGHTBATCH];
+  int		flashmaxlight[LIGHTBATCH];
+  int		flashminlight[LIGHTBATCH];
+  int		flashmaxtime[LIGHTBATCH];
+  int		flashmintime[LIGHTBATCH];
+  
+  int		numstrobes;
+  int		strobesector[LIGHTBATCH];
+  int		strobecount[LIGHTBATCH];
+  int		strobeminlight[LIGHTBATCH];
+  int		strobemaxlight[LIGHTBATCH];
+  int		strobedarktime[LIGHTBATCH];
+  int		strobebrighttime[LIGHTBATCH];
+  
+  int		numglows;
+  int		glowsector[LIGHTBATCH];
+  int		glowminlight[LIGHTBATCH];
+  int		glowmaxlight[LIGHTBATCH];
+  int		glowdirection[LIGHTBATCH];
+} lightbatch_t;
+
 #define GLOWSPEED		8
 #define	STROBEBRIGHT	        5
 #define	FASTDARK		15
 #define	SLOWDARK		35
 
-void	T_LightFlash (lightflash_t *flash);
+void	T_LightBatch (lightbatch_t *batch);
+void	P_AddLightFlash (lightflash_t *flash);
+void	P_AddStrobeFlash (strobe_t *flash);
+void	P_AddGlowingLight (glow_t *g);
+void	P_LightChanged (sector_t *sector);
 void	P_SpawnLightFlash (sector_t *sector);
-void	T_StrobeFlash (strobe_t *flash);
 void 	P_SpawnStrobeFlash (sector_t *sector, int fastOrSlow, int inSync);
 void	EV_StartLightStrobing(line_t *line);
 void	EV_TurnTagLightsOff(line_t	*line);
 void	EV_LightTurnOn(line_t *line, int bright);
-void	T_Glow(glow_t *g);
 void	P_SpawnGlowingLight(sector_t *sector);
 
 /*
@@ -163,13 +213,14 @@ typedef enum
   bottom
 } bwhere_e;
 
-typedef struct
+typedef struct button_s
 {
   line_t		*line;
   bwhere_e	        where;
   int			btexture;
-  int			btimer;
+  int			btimer;	   /* leveltime it pops out at, 0 when free */
   mobj_t		*soundorg;
+  struct button_s	*next;	   /* in the same slot of the timer wheel */
 } button_t;
 
 #define	MAXSWITCHES	50	   /* max # of wall switches in a level */
@@ -179,6 +230,7 @@ typedef struct
 extern	button_t	buttonlist[MAXBUTTONS];	
 
 void	P_ChangeSwitchTexture(line_t *line,int useAgain);
+void	P_ScheduleButton(button_t *button);
 void 	P_InitSwitchList(void);
 
 /*
@@ -129,8 +129,10 @@ void P_StartButton(line_t *line,bwhere_e w,int texture,int time)
 	buttonlist[i].line = line;
 	buttonlist[i].where = w;
 	buttonlist[i].btexture = texture;
-	buttonlist[i].btimer = time;
+	/* counting down started with this tic */
+	buttonlist[i].btimer = leveltime+time-1;
 	buttonlist[i].soundorg = (mobj_t *)&line->frontsector->soundorg;
+	P_ScheduleButton(&buttonlist[i]);
 	return;
       }
   
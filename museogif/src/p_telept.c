@@ -94,6 +94,7 @@ else
 {
   thing->momx = thing->momy = thing->momz = 0;
 }
+P_StopInterpolation(thing);
 return(true);
 }
 
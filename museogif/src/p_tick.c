@@ -80,6 +80,24 @@ void P_UnArchivePlayers (void)
 */
 
 void P_ArchiveWorld(void)
+{
+  P_ArchiveWorldFrom(sectors, numsectors, lines, numlines, sides);
+}
+
+/*
+  ====================
+  =
+  = P_ArchiveWorldFrom
+  =
+  = Archives the given copies of the sector, line and side arrays.
+  = Only touches its arguments and the SV_ buffer, so the autosave
+  = thread can run it on a snapshot while the level keeps playing.
+  =
+  ====================
+*/
+
+void P_ArchiveWorldFrom(sector_t *secs, int nsecs, line_t *lns, int nlns,
+			side_t *sds)
 {
   int i, j;
   sector_t *sec;
@@ -87,7 +105,7 @@ void P_ArchiveWorld(void)
   side_t *si;
   
   /* Sectors */
-  for(i = 0, sec = sectors; i < numsectors; i++, sec++)
+  for(i = 0, sec = secs; i < nsecs; i++, sec++)
     {
       SV_WriteWord(sec->floorheight>>FRACBITS);
       SV_WriteWord(sec->ceilingheight>>FRACBITS);
@@ -99,7 +117,7 @@ void P_ArchiveWorld(void)
     }
   
   /* Lines */
-  for(i = 0, li = lines; i < numlines; i++, li++)
+  for(i = 0, li = lns; i < nlns; i++, li++)
     {
       SV_WriteWord(li->flags);
       SV_WriteWord(li->special);
@@ -110,7 +128,7 @@ void P_ArchiveWorld(void)
 	    {
 	      continue;
 	    }
-	  si = &sides[li->sidenum[j]];
+	  si = &sds[li->sidenum[j]];
 	  SV_WriteWord(si->textureoffset>>FRACBITS);
 	  SV_WriteWord(si->rowoffset>>FRACBITS);
 	  SV_WriteWord(si->toptexture);
@@ -148,6 +166,7 @@ void P_UnArchiveWorld (void)
       sec->floorpic = *get++;
       sec->ceilingpic = *get++;
       sec->lightlevel = *get++;
+      P_LightChanged (sec);
       sec->special = *get++;	/* needed? */
       sec->tag = *get++;	/* needed? */
       sec->specialdata = 0;
@@ -313,9 +332,7 @@ void P_ArchiveSpecials(void)
     T_MoveCeiling, (ceiling_t: sector_t * swizzle), - active list
     T_VerticalDoor, (vldoor_t: sector_t * swizzle),
     T_MoveFloor, (floormove_t: sector_t * swizzle),
-    T_LightFlash, (lightflash_t: sector_t * swizzle),
-    T_StrobeFlash, (strobe_t: sector_t *),
-    T_Glow, (glow_t: sector_t *),
+    T_LightBatch, (lightflash_t, strobe_t, glow_t: sector_t * swizzle),
     T_PlatRaise, (plat_t: sector_t *), - active list
   */
   
@@ -327,6 +344,8 @@ void P_ArchiveSpecials(void)
   lightflash_t flash;
   strobe_t strobe;
   glow_t glow;
+  lightbatch_t *batch;
+  int i;
   
   for(th = thinkercap.next; th != &thinkercap; th = th->next)
     {
@@ -362,28 +381,44 @@ void P_ArchiveSpecials(void)
 	  SV_Write(&plat, sizeof(plat_t));
 	  continue;
 	}
-      if(th->function.acp1 == (actionf_p1)T_LightFlash)
-	{
-	  SV_WriteByte(tc_flash);
-	  memcpy(&flash, th, sizeof(lightflash_t));
-	  flash.sector = (sector_t *)(flash.sector-sectors);
-	  SV_Write(&flash, sizeof(lightflash_t));
-	  continue;
-	}
-      if(th->function.acp1 == (actionf_p1)T_StrobeFlash)
-	{
-	  SV_WriteByte(tc_strobe);
-	  memcpy(&strobe, th, sizeof(strobe_t));
-	  strobe.sector = (sector_t *)(strobe.sector-sectors);
-	  SV_Write(&strobe, sizeof(strobe_t));
-	  continue;
-	}
-      if(th->function.acp1 == (actionf_p1)T_Glow)
+      if(th->function.acp1 == (actionf_p1)T_LightBatch)
 	{
-	  SV_WriteByte(tc_glow);
-	  memcpy(&glow, th, sizeof(glow_t));
-	  glow.sector = (sector_t *)(glow.sector-sectors);
-	  SV_Write(&glow, sizeof(glow_t));
+	  /* one record per effect, as when each had a thinker */
+	  batch = (lightbatch_t *)th;
+	  for(i = 0; i < batch->numflashes; i++)
+	    {
+	      memset(&flash, 0, sizeof(lightflash_t));
+	      flash.sector = (sector_t *)(long)batch->flashsector[i];
+	      flash.count = batch->flashcount[i];
+	      flash.maxlight = batch->flashmaxlight[i];
+	      flash.minlight = batch->flashminlight[i];
+	      flash.maxtime = batch->flashmaxtime[i];
+	      flash.mintime = batch->flashmintime[i];
+	      SV_WriteByte(tc_flash);
+	      SV_Write(&flash, sizeof(lightflash_t));
+	    }
+	  for(i = 0; i < batch->numstrobes; i++)
+	    {
+	      memset(&strobe, 0, sizeof(strobe_t));
+	      strobe.sector = (sector_t *)(long)batch->strobesector[i];
+	      strobe.count = batch->strobecount[i];
+	      strobe.minlight = batch->strobeminlight[i];
+	      strobe.maxlight = batch->strobemaxlight[i];
+	      strobe.darktime = batch->strobedarktime[i];
+	      strobe.brighttime = batch->strobebrighttime[i];
+	      SV_WriteByte(tc_strobe);
+	      SV_Write(&strobe, sizeof(strobe_t));
+	    }
+	  for(i = 0; i < batch->numglows; i++)
+	    {
+	      memset(&glow, 0, sizeof(glow_t));
+	      glow.sector = (sector_t *)(long)batch->glowsector[i];
+	      glow.minlight = batch->glowminlight[i];
+	      glow.maxlight = batch->glowmaxlight[i];
+	      glow.direction = batch->glowdirection[i];
+	      SV_WriteByte(tc_glow);
+	      SV_Write(&glow, sizeof(glow_t));
+	    }
 	  continue;
 	}
     }
@@ -406,9 +441,9 @@ void P_UnArchiveSpecials (void)
   vldoor_t	*door;
   floormove_t	*floor;
   plat_t		*plat;
-  lightflash_t *flash;
-  strobe_t	*strobe;
-  glow_t		*glow;
+  lightflash_t	flash;
+  strobe_t	strobe;
+  glow_t		glow;
   
   
   /* read in saved thinkers */
@@ -465,30 +500,24 @@ void P_UnArchiveSpecials (void)
 	  break;
 	  
 	case tc_flash:
-	  flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
-	  memcpy (flash, save_p, sizeof(*flash));
-	  save_p += sizeof(*flash);
-	  flash->sector = &sectors[(long)flash->sector];
-	  flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
-	  P_AddThinker (&flash->thinker);
+	  memcpy (&flash, save_p, sizeof(flash));
+	  save_p += sizeof(flash);
+	  flash.sector = &sectors[(long)flash.sector];
+	  P_AddLightFlash (&flash);
 	  break;
 	  
 	case tc_strobe:
-	  strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
-	  memcpy (strobe, save_p, sizeof(*strobe));
-	  save_p += sizeof(*strobe);
-	  strobe->sector = &sectors[(long)strobe->sector];
-	  strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
-	  P_AddThinker (&strobe->thinker);
+	  memcpy (&strobe, save_p, sizeof(strobe));
+	  save_p += sizeof(strobe);
+	  strobe.sector = &sectors[(long)strobe.sector];
+	  P_AddStrobeFlash (&strobe);
 	  break;
 	  
 	case tc_glow:
-	  glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
-	  memcpy (glow, save_p, sizeof(*glow));
-	  save_p += sizeof(*glow);
-	  glow->sector = &sectors[(long)glow->sector];
-	  glow->thinker.function.acp1 = (actionf_p1)T_Glow;
-	  P_AddThinker (&glow->thinker);
+	  memcpy (&glow, save_p, sizeof(glow));
+	  save_p += sizeof(glow);
+	  glow.sector = &sectors[(long)glow.sector];
+	  P_AddGlowingLight (&glow);
 	  break;
 	  
 	default:
@@ -606,6 +635,46 @@ void P_RunThinkers (void)
     }
 }
 
+/*
+ * ----------------------------------------------------------------------------
+ * 
+ *  PROC P_SaveOldPositions
+ * 
+ *  Keeps where the mobjs are before a tic, and starts a new list of the
+ *  sectors it moves, so -uncapped frames can be drawn in between.
+ *  Without -uncapped every frame shows the tic as it is, and only the
+ *  list is started.
+ * 
+ * ----------------------------------------------------------------------------
+ */
+
+sector_t *movedsectors;
+
+static void P_SaveOldPositions(void)
+{
+  thinker_t *th;
+  mobj_t *mo;
+  
+  movedsectors = NULL;
+  if(!uncapped)
+    {
+      return;
+    }
+  for(th = thinkercap.next; th != &thinkercap; th = th->next)
+    {
+      if(th->function.acp1 != (actionf_p1)P_MobjThinker
+	 && th->function.acp1 != (actionf_p1)P_BlasterMobjThinker)
+	{
+	  continue;
+	}
+      mo = (mobj_t *)th;
+      mo->oldx = mo->x;
+      mo->oldy = mo->y;
+      mo->oldz = mo->z;
+      mo->oldangle = mo->angle;
+    }
+}
+
 /*
  * ----------------------------------------------------------------------------
  * 
@@ -618,6 +687,8 @@ void P_Ticker(void)
 {
   int i;
   
+  /* even paused, so the frames stand still */
+  P_SaveOldPositions();
   if(paused)
     {
       return;
@@ -481,6 +481,7 @@ boolean P_UndoPlayerChicken(player_t *player)
       P_RemoveMobj(mo);
       mo = P_SpawnMobj(x, y, z, MT_CHICPLAYER);
       mo->angle = angle;
+      P_StopInterpolation(mo);
       mo->health = player->health;
       mo->special1 = weapon;
       mo->player = player;
@@ -496,6 +497,7 @@ boolean P_UndoPlayerChicken(player_t *player)
       mo->flags |= playerNum<<MF_TRANSSHIFT;
     }
   mo->angle = angle;
+  P_StopInterpolation(mo);
   mo->player = player;
   mo->reactiontime = 18;
   if(oldFlags2&MF2_FLY)
@@ -416,6 +416,7 @@ void R_DrawViewBorder (void)
       src = W_CacheLumpName ("FLAT513", PU_CACHE);
     }
   dest = screen;
+  V_MarkRect (0, 0, screenwidth, screenheight-SBARHEIGHT);
   
   for (y=0 ; y<screenheight-SBARHEIGHT ; y++)
     {
@@ -480,6 +481,7 @@ void R_DrawTopBorder (void)
       src = W_CacheLumpName ("FLAT513", PU_CACHE);
     }
   dest = screen;
+  V_MarkRect (0, 0, screenwidth, 30);
   
   for (y=0 ; y<30 ; y++)
     {
@@ -55,7 +55,7 @@ typedef struct
 
 struct line_s;
 
-typedef	struct
+typedef	struct sector_s
 {
   fixed_t	floorheight, ceilingheight;
   short		floorpic, ceilingpic;
@@ -73,8 +73,22 @@ typedef	struct
   void		*specialdata;		/* thinker_t for reversable actions */
   int		linecount;
   struct line_s	**lines;		/* [linecount] size */
+  
+  /* -uncapped: the heights before the tic that last moved it */
+  fixed_t	oldfloorheight, oldceilingheight;
+  fixed_t	tempfloorheight, tempceilingheight; /* during a frame */
+  int		movedtic;		/* leveltime+1 of that tic */
+  struct sector_s *nextmoved;		/* in movedsectors */
+  
+  /* the renderer's light, redone when the sector is in changedlights */
+  int		lightnum;		/* (lightlevel>>LIGHTSEGSHIFT)+extralight */
+  boolean	lightchanged;		/* in changedlights */
+  struct sector_s *nextchanged;
 } sector_t;
 
+extern sector_t	*movedsectors;		/* the sectors the last tic moved */
+extern sector_t	*changedlights;		/* lightlevel changed since the last frame */
+
 typedef struct
 {
   fixed_t		textureoffset;		/* add this to the calculated texture col */
@@ -257,6 +271,13 @@ extern	fixed_t		viewx, viewy, viewz;
 extern	angle_t		viewangle;
 extern	player_t	*viewplayer;
 
+/*
+ * -uncapped: old moved on interpfrac of the way to cur, angles too.
+ * cur alone at FRACUNIT, as old is only kept with -uncapped.
+ */
+#define R_Interpolate(old,cur)	(interpfrac == FRACUNIT ? (cur)		\
+				 : (old)+FixedMul((cur)-(old),interpfrac))
+
 
 extern	angle_t		clipangle;
 
@@ -30,6 +30,8 @@ player_t	        *viewplayer;
 
 int			detailshift;	 /* 0 = high, 1 = low */
 
+fixed_t			interpfrac = FRACUNIT;
+
 /*
  * precalculated math tables
  */
@@ -758,6 +760,39 @@ subsector_t *R_PointInSubsector (fixed_t x, fixed_t y)
 }
 
 
+/*
+  ==============
+  =
+  = R_UpdateLights
+  =
+  = Redoes lightnum for the sectors on changedlights, or for all of them
+  = when extralight changed
+  =
+  ==============
+*/
+
+static void R_UpdateLights (void)
+{
+  static int	lastextralight = -1;
+  sector_t	*sec;
+  int		i;
+  
+  if (extralight != lastextralight)
+    {
+      lastextralight = extralight;
+      for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+	sec->lightnum = (sec->lightlevel >> LIGHTSEGSHIFT)+extralight;
+    }
+  else
+    for (sec = changedlights ; sec ; sec = sec->nextchanged)
+      sec->lightnum = (sec->lightlevel >> LIGHTSEGSHIFT)+extralight;
+  
+  for (sec = changedlights ; sec ; sec = sec->nextchanged)
+    sec->lightchanged = false;
+  changedlights = NULL;
+}
+
+
 /*
   //----------------------------------------------------------------------------
   //
@@ -770,23 +805,24 @@ void R_SetupFrame(player_t *player)
   int i;
   int tableAngle;
   int tempCentery;
+  mobj_t *mo;
   
   /*   drawbsp = 1;   */
   viewplayer = player;
-  viewangle = player->mo->angle+viewangleoffset;
+  mo = player->mo;
+  viewangle = R_Interpolate(mo->oldangle, mo->angle)+viewangleoffset;
   tableAngle = viewangle>>ANGLETOFINESHIFT;
+  viewx = R_Interpolate(mo->oldx, mo->x);
+  viewy = R_Interpolate(mo->oldy, mo->y);
   if(player->chickenTics && player->chickenPeck)
     { /* Set chicken attack view position */
-      viewx = player->mo->x+player->chickenPeck*finecosine[tableAngle];
-      viewy = player->mo->y+player->chickenPeck*finesine[tableAngle];
-    }
-  else
-    { /* Normal view position */
-      viewx = player->mo->x;
-      viewy = player->mo->y;
+      viewx += player->chickenPeck*finecosine[tableAngle];
+      viewy += player->chickenPeck*finesine[tableAngle];
     }
   extralight = player->extralight;
-  viewz = player->viewz;
+  R_UpdateLights ();
+  /* the view height and bob move with the tics, only the body between */
+  viewz = R_Interpolate(mo->oldz, mo->z)+player->viewz-mo->z;
   
   tempCentery = viewheight/2+(player->lookdir)*screenblocks/10;
   if(centery != tempCentery)
@@ -851,6 +887,41 @@ void R_SetupFrame(player_t *player)
 #endif
 }
 
+/*
+  ==============
+  =
+  = R_InterpolateSectors
+  =
+  = For an -uncapped frame, puts the sectors the last tic moved
+  = interpfrac of the way from where they were before it, and back
+  = again with restore set
+  =
+  ==============
+*/
+
+static void R_InterpolateSectors (boolean restore)
+{
+  sector_t	*sec;
+  
+  if (interpfrac == FRACUNIT)
+    return;
+  for (sec = movedsectors ; sec ; sec = sec->nextmoved)
+    if (restore)
+      {
+	sec->floorheight = sec->tempfloorheight;
+	sec->ceilingheight = sec->tempceilingheight;
+      }
+    else
+      {
+	sec->tempfloorheight = sec->floorheight;
+	sec->tempceilingheight = sec->ceilingheight;
+	sec->floorheight = R_Interpolate(sec->oldfloorheight,
+					 sec->floorheight);
+	sec->ceilingheight = R_Interpolate(sec->oldceilingheight,
+					   sec->ceilingheight);
+      }
+}
+
 /*
   ==============
   =
@@ -861,6 +932,7 @@ void R_SetupFrame(player_t *player)
 
 void R_RenderPlayerView (player_t *player)
 {
+  R_InterpolateSectors (false);
   R_SetupFrame (player);
   R_ClearClipSegs ();
   R_ClearDrawSegs ();
@@ -872,6 +944,8 @@ void R_RenderPlayerView (player_t *player)
   R_DrawPlanes ();
   NetUpdate ();			     /* check for new console commands */
   R_DrawMasked ();
+  R_InterpolateSectors (true);
   NetUpdate ();			     /* check for new console commands */
+  V_MarkRect (viewwindowx, viewwindowy, scaledviewwidth, viewheight);
 }
 
@@ -73,7 +73,7 @@ void R_RenderMaskedSegRange (drawseg_t *ds, int x1, int x2)
   backsector = curline->backsector;
   texnum = texturetranslation[curline->sidedef->midtexture];
   
-  lightnum = (frontsector->lightlevel >> LIGHTSEGSHIFT)+extralight;
+  lightnum = frontsector->lightnum;
   if (curline->v1->y == curline->v2->y)
     lightnum--;
   else if (curline->v1->x == curline->v2->x)
@@ -552,7 +552,7 @@ void R_StoreWallRange (int start, int stop)
        */
       if (!fixedcolormap)
 	{
-	  lightnum = (frontsector->lightlevel >> LIGHTSEGSHIFT)+extralight;
+	  lightnum = frontsector->lightnum;
 	  if (curline->v1->y == curline->v2->y)
 	    lightnum--;
 	  else if (curline->v1->x == curline->v2->x)
@@ -447,6 +447,7 @@ void R_DrawVisSprite (vissprite_t *vis, int __attribute__((unused)) x1, int __at
 
 void R_ProjectSprite (mobj_t *thing)
 {
+  fixed_t		thingx, thingy, thingz;
   fixed_t		trx,try;
   fixed_t		gxt,gyt;
   fixed_t		tx,tz;
@@ -467,11 +468,15 @@ void R_ProjectSprite (mobj_t *thing)
       return;
     }
   
+  thingx = R_Interpolate(thing->oldx, thing->x);
+  thingy = R_Interpolate(thing->oldy, thing->y);
+  thingz = R_Interpolate(thing->oldz, thing->z);
+  
   /*
    * transform the origin point
    */
-  trx = thing->x - viewx;
-  try = thing->y - viewy;
+  trx = thingx - viewx;
+  try = thingy - viewy;
   
   gxt = FixedMul(trx,viewcos);
   gyt = -FixedMul(try,viewsin);
@@ -505,7 +510,7 @@ void R_ProjectSprite (mobj_t *thing)
   
   if (sprframe->rotate)
     {	/* choose a different rotation based on player view */
-      ang = R_PointToAngle (thing->x, thing->y);
+      ang = R_PointToAngle (thingx, thingy);
       rot = (ang-thing->angle+(unsigned)(ANG45/2)*9)>>29;
       lump = sprframe->lump[rot];
       flip = (boolean)sprframe->flip[rot];
@@ -536,14 +541,14 @@ void R_ProjectSprite (mobj_t *thing)
   vis->mobjflags = thing->flags;
   vis->psprite = false;
   vis->scale = xscale<<detailshift;
-  vis->gx = thing->x;
-  vis->gy = thing->y;
-  vis->gz = thing->z;
-  vis->gzt = thing->z + spritetopoffset[lump];
+  vis->gx = thingx;
+  vis->gy = thingy;
+  vis->gz = thingz;
+  vis->gzt = thingz + spritetopoffset[lump];
   
   /* foot clipping */
   if(thing->flags2&MF2_FEETARECLIPPED
-     && thing->z <= thing->subsector->sector->floorheight)
+     && thingz <= thing->subsector->sector->floorheight)
     {
       vis->footclip = 10;
     }
@@ -617,7 +622,7 @@ void R_AddSprites (sector_t *sec)
   
   sec->validcount = validcount;
   
-  lightnum = (sec->lightlevel >> LIGHTSEGSHIFT)+extralight;
+  lightnum = sec->lightnum;
   if (lightnum < 0)
     spritelights = scalelight[0];
   else if (lightnum >= LIGHTLEVELS)
@@ -775,8 +780,7 @@ void R_DrawPlayerSprites (void)
   /*
    * get light level
    */
-  lightnum = (viewplayer->mo->subsector->sector->lightlevel >> LIGHTSEGSHIFT)
-    +extralight;
+  lightnum = viewplayer->mo->subsector->sector->lightnum;
   if (lightnum < 0)
     spritelights = scalelight[0];
   else if (lightnum >= LIGHTLEVELS)
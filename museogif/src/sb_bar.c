@@ -569,6 +569,7 @@ static void ShadeLine(int x, int y, int height, int shade)
   y += Y_BOTTOM;
   
   shades = colormaps+9*256+shade*2*256;
+  V_MarkRect(x, y, 1, height);
   dest = screen+y*screenwidth+x;
   while(height--)
     {
@@ -740,6 +741,7 @@ void SB_Drawer(void)
 	{
 	    memset(screen+(screenheight-SBARHEIGHT)*screenwidth, 3,
 		   screenwidth*SBARHEIGHT);
+	    V_MarkRect(0, screenheight-SBARHEIGHT, screenwidth, SBARHEIGHT);
 	  V_DrawPatch(0, Y_BOTTOM+158, PatchBARBACK);
 	  if(players[consoleplayer].cheats&CF_GODMODE)
 	    {
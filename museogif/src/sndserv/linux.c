@@ -57,14 +57,15 @@ void I_InitMusic(void)
 {
 }
 
-void I_InitSound( int samplerate, int samplesize )
+int I_InitSound( int samplerate, int __attribute__((unused)) samplesize )
 {
   int i;
+  int samplerate_got;
   
   audio_fd = open("/dev/dsp", O_WRONLY);
   if (audio_fd<0) {
     fprintf(stderr, "Could not open /dev/dsp\n");
-    return;
+    return samplerate;
   }
   
   
@@ -72,8 +73,12 @@ void I_InitSound( int samplerate, int samplesize )
   myioctl(audio_fd, SNDCTL_DSP_SETFRAGMENT, &i);
   
   myioctl(audio_fd, SNDCTL_DSP_RESET, 0);
-  i=11025;
-  myioctl(audio_fd, SNDCTL_DSP_SPEED, &i);
+  /* the driver answers with the rate it really runs at */
+  samplerate_got = samplerate;
+  myioctl(audio_fd, SNDCTL_DSP_SPEED, &samplerate_got);
+  if (snd_ratefixed && samplerate_got != samplerate)
+    fprintf(stderr, "Device runs at %d Hz, sfx were made for %d Hz\n",
+	    samplerate_got, samplerate);
   i=1;    
   myioctl(audio_fd, SNDCTL_DSP_STEREO, &i);
   
@@ -83,14 +88,25 @@ void I_InitSound( int samplerate, int samplesize )
   else
     fprintf(stderr, "Could not play signed 16 data\n");
   
+  return samplerate_got;
+}
+
+int I_OutputDelay( void )
+{
+  /* the write blocks instead */
+  return audio_fd >= 0 ? 0 : 10000;
 }
 
 void I_SubmitOutputBuffer( void* samples, int samplecount )
 {
   if (audio_fd >= 0)
     write(audio_fd, samples, samplecount*4);
-  else
-    usleep(10000);
+}
+
+void I_OutputStats( int* underruns, int* overruns )
+{
+  *underruns = 0;
+  *overruns = 0;
 }
 
 void I_ShutdownSound(void)
@@ -28,6 +28,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
@@ -37,27 +38,38 @@
 
 #include "soundsrv.h"
 
+/*
+ * Output ring between the server loop and the SDL audio thread.
+ * Single producer, single consumer: only the server loop moves
+ *  outhead, only the callback moves outtail, so neither side ever
+ *  locks or waits for the other.  Both are free running frame
+ *  counters; the size is a power of two.
+ */
 static SDL_AudioSpec	SDL_audio;
-static int16_t*		outbuffer=NULL;
-static unsigned int	outbuffer_in=0,outbuffer_out=0,outbuffer_max=0;
+static uint32_t*	outbuffer=NULL;	/* stereo frames */
+static unsigned int	outsize=0;
+static unsigned int	outhead=0, outtail=0;
+static unsigned int	outlatency=0;	/* frames kept queued */
+static int		outstarted=0;
+static int		underruns=0, overruns=0;
 
 static void audio_cb(void __attribute__((unused)) *user,uint8_t *stream,int len) {
-	int16_t *out = (int16_t*)stream;
-	len /= 4;
-
-	while (len > 0) {
-		if (outbuffer_out == outbuffer_in)
-			break;
-
-		*out++ = outbuffer[(outbuffer_out*2)  ];
-		*out++ = outbuffer[(outbuffer_out*2)+1];
-		if ((++outbuffer_out) >= outbuffer_max) outbuffer_out = 0;
-		len--;
-	}
-
-	while (len-- > 0) {
-		*out++ = 0;
-		*out++ = 0;
+	unsigned int tail = outtail;
+	unsigned int avail = __atomic_load_n(&outhead, __ATOMIC_ACQUIRE) - tail;
+	unsigned int frames = len / 4;
+	unsigned int n, first;
+
+	n = avail < frames ? avail : frames;
+	first = outsize - (tail & (outsize-1));
+	if (first > n) first = n;
+	memcpy(stream, outbuffer + (tail & (outsize-1)), first*4);
+	memcpy(stream + first*4, outbuffer, (n-first)*4);
+	__atomic_store_n(&outtail, tail + n, __ATOMIC_RELEASE);
+
+	if (n < frames) {
+		memset(stream + n*4, 0, (frames-n)*4);
+		if (__atomic_load_n(&outstarted, __ATOMIC_RELAXED))
+			__atomic_add_fetch(&underruns, 1, __ATOMIC_RELAXED);
 	}
 }
 
@@ -65,71 +77,104 @@ void I_InitMusic(void)
 {
 }
 
-void I_InitSound( int samplerate, int samplesize )
+int I_InitSound( int samplerate, int __attribute__((unused)) samplesize )
 {
+  SDL_AudioSpec obtained;
+
   memset(&SDL_audio,0,sizeof(SDL_audio));
 
   fprintf(stderr,"I_InitSound SDL\n");
   if (SDL_Init(SDL_INIT_AUDIO) < 0) {
 	  fprintf(stderr,"Failed to init SDL audio\n");
-	  return;
+	  return samplerate;
   }
 
-  outbuffer_in=0;
-  outbuffer_out=0;
-  SDL_audio.freq = 11025;
-  SDL_audio.format = AUDIO_S16;
+  /* -latency <ms>, by default two mixing blocks */
+  outlatency = snd_latency > 0 ? snd_latency * samplerate / 1000 : 2 * SAMPLECOUNT;
+  if (outlatency < SAMPLECOUNT) outlatency = SAMPLECOUNT;
+  for (outsize = 1; outsize < outlatency + SAMPLECOUNT; outsize <<= 1)
+	  ;
+
+  outbuffer = malloc(4 * outsize);
+  if (outbuffer == NULL) {
+	  fprintf(stderr,"Failed to alloc for SDL\n");
+	  abort();
+  }
+  outhead=0;
+  outtail=0;
+
+  SDL_audio.freq = samplerate;
+  SDL_audio.format = AUDIO_S16SYS;
   SDL_audio.channels = 2;
   SDL_audio.silence = 0;
   SDL_audio.samples = 512;
   SDL_audio.size = 2 * 2 * 1024;
   SDL_audio.callback = audio_cb;
 
-  if (SDL_OpenAudio(&SDL_audio,NULL)) {
+  /*
+   * Take the device's own rate if it differs, so SDL doesn't
+   * resample the mixer output a second time, unless the sfx
+   * were converted for this rate already.
+   */
+  if (SDL_OpenAudio(&SDL_audio,&obtained)) {
           memset(&SDL_audio,0,sizeof(SDL_audio));
 	  fprintf(stderr,"Failed to open SDL audio\n");
-	  return;
+	  return samplerate;
   }
-
-  outbuffer_max = SDL_audio.samples * 2;
-  outbuffer = malloc(4 * outbuffer_max);
-  if (outbuffer == NULL) {
-	  fprintf(stderr,"Failed to alloc for SDL\n");
-	  abort();
+  if (obtained.format != AUDIO_S16SYS || obtained.channels != 2
+      || (snd_ratefixed && obtained.freq != samplerate)) {
+	  SDL_CloseAudio();
+	  if (SDL_OpenAudio(&SDL_audio,NULL)) {
+		  memset(&SDL_audio,0,sizeof(SDL_audio));
+		  fprintf(stderr,"Failed to open SDL audio\n");
+		  return samplerate;
+	  }
   }
+  else
+	  SDL_audio.freq = obtained.freq;
 
   SDL_PauseAudio(0/*unpause*/);
+  return SDL_audio.freq;
+}
+
+int I_OutputDelay( void )
+{
+  int excess;
+
+  if (SDL_audio.size == 0)
+	  return SAMPLECOUNT * 1000000 / snd_rate;
+
+  /* time until a block fits under the latency target */
+  excess = (int)(outhead - __atomic_load_n(&outtail, __ATOMIC_ACQUIRE))
+	  + SAMPLECOUNT - (int)outlatency;
+  return excess > 0 ? excess * 1000000 / SDL_audio.freq : 0;
 }
 
 void I_SubmitOutputBuffer( void* samples, int samplecount )
 {
-  int16_t *i = (int16_t*)samples,*o;
-  unsigned int cc;
+  unsigned int head = outhead;
+  unsigned int n = samplecount, first;
 
-  if (SDL_audio.size == 0) {
-          usleep(10000);
+  if (SDL_audio.size == 0)
 	  return;
-  }
 
-  SDL_LockAudio();
-  while (samplecount > 0) {
-    cc = outbuffer_in;
-    if ((++cc) >= outbuffer_max) cc = 0;
-    if (cc == outbuffer_out) {
-	    /* calling thread expects us to block in this case, so.. */
-            SDL_UnlockAudio();
-	    usleep(1000);
-	    SDL_LockAudio();
-	    continue;
-    }
-
-    o = outbuffer + (outbuffer_in*2);
-    outbuffer_in = cc;
-    samplecount--;
-    *o++ = *i++;
-    *o++ = *i++;
+  if (head - __atomic_load_n(&outtail, __ATOMIC_ACQUIRE) + n > outsize) {
+	  overruns++;
+	  return;
   }
-  SDL_UnlockAudio();
+
+  first = outsize - (head & (outsize-1));
+  if (first > n) first = n;
+  memcpy(outbuffer + (head & (outsize-1)), samples, first*4);
+  memcpy(outbuffer, (uint32_t*)samples + first, (n-first)*4);
+  __atomic_store_n(&outhead, head + n, __ATOMIC_RELEASE);
+  __atomic_store_n(&outstarted, 1, __ATOMIC_RELAXED);
+}
+
+void I_OutputStats( int* under, int* over )
+{
+  *under = __atomic_load_n(&underruns, __ATOMIC_RELAXED);
+  *over = overruns;
 }
 
 void I_ShutdownSound(void)
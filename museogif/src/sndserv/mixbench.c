@@ -0,0 +1,224 @@
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DESCRIPTION:
+ *	Mixer benchmark.  Runs mix() against the old per-sample mixing
+ *	 loop with growing channel counts, checks that both produce the
+ *	 same output and prints the time each takes per block.  Then
+ *	 times the music synth with all its voices sounding.
+ *
+ *	usage: mixbench [blocks]
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mixer.h"
+#include "musplay.h"
+
+#define DATASIZE	(1<<20)
+
+static unsigned char	sfxdata[DATASIZE];
+
+/* the per-sample mixer mix() replaced, kept as the reference */
+static unsigned char*	refchannels[MIX_CHANNELS];
+static unsigned char*	refchannelsend[MIX_CHANNELS];
+static unsigned int	refchannelstep[MIX_CHANNELS];
+static unsigned int	refchannelstepremainder[MIX_CHANNELS];
+static int*		refleftvol[MIX_CHANNELS];
+static int*		refrightvol[MIX_CHANNELS];
+static int		refsteptable[256];
+static int		refvol_lookup[128*256];
+
+static void refmix(signed short* buffer, int numchannels)
+{
+  int		dl, dr, ch;
+  unsigned int	sample;
+  signed short*	out;
+
+  for (out = buffer ; out != buffer + MIX_BUFFERSIZE ; out += 2)
+    {
+      dl = 0;
+      dr = 0;
+
+      for (ch=0 ; ch<numchannels ; ch++)
+	if (refchannels[ch])
+	  {
+	    sample = *refchannels[ch];
+	    dl += refleftvol[ch][sample];
+	    dr += refrightvol[ch][sample];
+	    refchannelstepremainder[ch] += refchannelstep[ch];
+	    refchannels[ch] += refchannelstepremainder[ch] >> 16;
+	    refchannelstepremainder[ch] &= 65536-1;
+
+	    if (refchannels[ch] >= refchannelsend[ch])
+	      refchannels[ch] = 0;
+	  }
+
+      out[0] = dl > 0x7fff ? 0x7fff : dl < -0x8000 ? -0x8000 : dl;
+      out[1] = dr > 0x7fff ? 0x7fff : dr < -0x8000 ? -0x8000 : dr;
+    }
+}
+
+static int refvol(int volume, int seperation)
+{
+  int		vol = volume - (volume*seperation*seperation)/(256*256);
+
+  return vol < 0 ? 0 : vol > 127 ? 127 : vol;
+}
+
+static double now(void)
+{
+  struct timespec	ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Starts numchannels sounds on both mixers and runs blocks blocks.
+ * Returns 0 if the outputs differ.
+ */
+static int bench(int numchannels, int blocks)
+{
+  static signed short	out[MIX_BUFFERSIZE];
+  static signed short	refout[MIX_BUFFERSIZE];
+  double		t, reftime = 0, mixtime = 0;
+  int			ch, b, start, length, vol, pitch, sep;
+
+  srand(numchannels);
+  initmixer(numchannels, MIX_SFXSPEED);
+
+  for (ch=0 ; ch<numchannels ; ch++)
+    {
+      start = rand() % (DATASIZE/4);
+      length = DATASIZE/2 + rand() % (DATASIZE/2 - start);
+      vol = rand() % 128;
+      pitch = 112 + rand() % 33;
+      sep = rand() % 256;
+
+      addsfx(sfxdata + start, length, ch+1, vol, pitch, sep);
+
+      refchannels[ch] = sfxdata + start;
+      refchannelsend[ch] = sfxdata + start + length;
+      refchannelstep[ch] = refsteptable[pitch];
+      refchannelstepremainder[ch] = 0;
+      refleftvol[ch] = &refvol_lookup[refvol(vol, sep+1)*256];
+      refrightvol[ch] = &refvol_lookup[refvol(vol, sep+1-257)*256];
+    }
+
+  for (b=0 ; b<blocks ; b++)
+    {
+      t = now();
+      refmix(refout, numchannels);
+      reftime += now() - t;
+
+      t = now();
+      mix(out);
+      mixtime += now() - t;
+
+      if (memcmp(out, refout, sizeof(out)))
+	{
+	  printf("%8i  output differs from the reference in block %i\n",
+		 numchannels, b);
+	  return 0;
+	}
+    }
+
+  printf("%8i  %9.2f us  %9.2f us  %6.2fx  %8.2f ns\n", numchannels,
+	 reftime * 1e6 / blocks, mixtime * 1e6 / blocks, reftime / mixtime,
+	 mixtime * 1e9 / ((double) blocks * MIX_SAMPLECOUNT * numchannels));
+  return 1;
+}
+
+/*
+ * Plays a score that starts a note on every voice and holds them,
+ *  the most the synth ever has to do in a block.
+ */
+static void benchmusic(int blocks)
+{
+  static unsigned char	song[16 + MUS_VOICES*3 + 4];
+  static signed short	out[MIX_BUFFERSIZE];
+  unsigned char*	p = song + 16;
+  double		t, mixtime = 0, blocktime;
+  int			i, b;
+
+  memcpy(song, "MUS\x1a", 4);
+  song[6] = 16;
+
+  for (i=0 ; i<MUS_VOICES ; i++)
+    {
+      /* play note, with volume */
+      *p++ = 0x10 | (i % 15);
+      *p++ = 0x80 | (36 + i*2);
+      *p++ = 127;
+    }
+  /* the longest delay after the last one, then the end */
+  p[-3] |= 0x80;
+  *p++ = 0xff;
+  *p++ = 0xff;
+  *p++ = 0x7f;
+  *p++ = 0x60;
+  song[4] = (p - song - 16) & 0xff;
+  song[5] = (p - song - 16) >> 8;
+
+  initmixer(1, MIX_SPEED);
+  initmusic(NULL, 0, MIX_SPEED);
+  setmusicvolume(15);
+  playsong(song, p - song, 1);
+
+  for (b=0 ; b<blocks ; b++)
+    {
+      t = now();
+      mix(out);
+      mixtime += now() - t;
+    }
+
+  blocktime = (double) MIX_SAMPLECOUNT / MIX_SPEED;
+  printf("\nmusic: %i voices  %9.2f us/block  %6.2f%% of the block's"
+	 " %.2f ms at %i Hz\n", musicvoices(), mixtime * 1e6 / blocks,
+	 mixtime / blocks / blocktime * 100, blocktime * 1e3, MIX_SPEED);
+}
+
+int main(int argc, char** argv)
+{
+  int		blocks = argc > 1 ? atoi(argv[1]) : 1000;
+  int		counts[] = { 1, 8, 16, 32, 64, 128, 256 };
+  int		ok = 1;
+  int		i, j;
+
+  if (blocks < 1)
+    blocks = 1;
+
+  for (i=0 ; i<(int) sizeof(sfxdata) ; i++)
+    sfxdata[i] = rand();
+
+  for (i=-128 ; i<128 ; i++)
+    refsteptable[i+128] = pow(2.0, (i/64.0))*65536.0;
+  for (i=0 ; i<128 ; i++)
+    for (j=0 ; j<256 ; j++)
+      refvol_lookup[i*256+j] = (i*(j-128)*256)/127;
+
+  printf("%i blocks of %i frames, %s saturation\n\n", blocks, MIX_SAMPLECOUNT,
+#if defined(__SSE2__)
+	 "SSE2"
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	 "NEON"
+#else
+	 "scalar"
+#endif
+	 );
+  printf("channels  reference/block  mix()/block  speedup  per channel-sample\n");
+
+  for (i=0 ; i<(int) (sizeof(counts)/sizeof(counts[0])) ; i++)
+    ok &= bench(counts[i], blocks);
+
+  benchmusic(blocks);
+
+  return ok ? 0 : 1;
+}
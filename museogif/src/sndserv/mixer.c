@@ -0,0 +1,353 @@
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DESCRIPTION:
+ *	Software sfx mixer, split out of the soundserver so that
+ *	 the game can run the same mixing in-process.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "mixer.h"
+#include "musplay.h"
+
+/* number of channels addsfx() hands out */
+static int	numchannels = MIX_DEFCHANNELS;
+
+/* output rate */
+static int	mixrate = MIX_SPEED;
+
+/* 32 bit interleaved left/right accumulator for one block */
+static int	mixacc[MIX_BUFFERSIZE] __attribute__((aligned(16)));
+
+/* an internal time keeper, counts mixed buffers */
+static int	mytime = 0;
+
+/* the channel data pointers */
+static unsigned char*	channels[MIX_CHANNELS];
+
+/* the channel step amount */
+static unsigned int	channelstep[MIX_CHANNELS];
+
+/* 0.16 bit remainder of last step */
+static unsigned int	channelstepremainder[MIX_CHANNELS];
+
+/* the channel data end pointers */
+static unsigned char*	channelsend[MIX_CHANNELS];
+
+/* time that the channel started playing */
+static int		channelstart[MIX_CHANNELS];
+
+/* the channel handles */
+static int 		channelhandles[MIX_CHANNELS];
+
+/* the channel left/right volume lookup, interleaved per sample value */
+static int		channelvol[MIX_CHANNELS][256*2] __attribute__((aligned(16)));
+
+static int		steptable[256];
+
+static int		vol_lookup[128*256];
+
+
+void initmixer(int count, int rate)
+{
+  int		i;
+  int		j;
+
+  int*	        steptablemid = steptable + 128;
+
+  if (count < 1)
+    count = 1;
+  if (count > MIX_CHANNELS)
+    count = MIX_CHANNELS;
+  numchannels = count;
+  mixrate = rate > 0 ? rate : MIX_SPEED;
+
+  for (i=0 ; i<MIX_CHANNELS ; i++)
+    channels[i] = 0;
+
+  for (i=-128 ; i<128 ; i++)
+    steptablemid[i] = pow(2.0, (i/64.0))*65536.0;
+
+  for (i=0 ; i<128 ; i++)
+    for (j=0 ; j<256 ; j++)
+      vol_lookup[i*256+j] = (i*(j-128)*256)/127;
+}
+
+
+int resamplesfx( unsigned char* in, int length, int rate,
+		 unsigned char* out )
+{
+  unsigned long long	pos;
+  unsigned long long	step;
+  unsigned int		frac;
+  int			outlength;
+  int			padded;
+  int			i;
+  int			x;
+
+  if (rate <= 0)
+    rate = MIX_SFXSPEED;
+  if (length <= 0)
+    return 0;
+
+  outlength = ((long long) length * mixrate + rate - 1) / rate;
+  padded = ((outlength + (MIX_SAMPLECOUNT-1)) / MIX_SAMPLECOUNT)
+    * MIX_SAMPLECOUNT;
+  if (!out)
+    return padded;
+
+  /* 32.32 position in the source */
+  step = ((unsigned long long) rate << 32) / mixrate;
+  for (i=0, pos=0 ; i<outlength ; i++, pos+=step)
+    {
+      x = pos >> 32;
+      frac = (pos >> 16) & 0xffff;
+      if (x+1 >= length)
+	out[i] = in[length-1];
+      else
+	out[i] = (in[x]*(65536-frac) + in[x+1]*frac + 32768) >> 16;
+    }
+  for ( ; i<padded ; i++)
+    out[i] = 128;
+
+  return padded;
+}
+
+
+/*
+ * Adds one channel's contribution to a whole block into mixacc.
+ * The number of samples left before the channel runs off its end
+ *  is worked out up front, so the inner loop has no branches.
+ */
+static void mixchannel(int ch)
+{
+  unsigned char*	data = channels[ch];
+  int*			vol = channelvol[ch];
+  unsigned int		step = channelstep[ch];
+  unsigned int		pos = channelstepremainder[ch];
+  unsigned long long	rest;
+  unsigned int		sample;
+  int*			acc = mixacc;
+  int			count;
+  int			i;
+
+  /* 16.16 distance to the end; the channel stops once it gets there */
+  rest = ((unsigned long long) (channelsend[ch] - data) << 16) - pos;
+  count = MIX_SAMPLECOUNT;
+  if (rest <= (unsigned long long) step * MIX_SAMPLECOUNT)
+    count = (rest + step - 1) / step;
+
+  i = 0;
+#if defined(__SSE2__)
+  /* two frames per 128 bit add */
+  for ( ; i+1<count ; i+=2)
+    {
+      __m128i	v0, v1;
+
+      v0 = _mm_loadl_epi64((__m128i *) (vol + data[pos >> 16]*2));
+      pos += step;
+      v1 = _mm_loadl_epi64((__m128i *) (vol + data[pos >> 16]*2));
+      pos += step;
+      _mm_store_si128((__m128i *) acc,
+		      _mm_add_epi32(_mm_load_si128((__m128i *) acc),
+				    _mm_unpacklo_epi64(v0, v1)));
+      acc += 4;
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for ( ; i+1<count ; i+=2)
+    {
+      int32x2_t	v0, v1;
+
+      v0 = vld1_s32(vol + data[pos >> 16]*2);
+      pos += step;
+      v1 = vld1_s32(vol + data[pos >> 16]*2);
+      pos += step;
+      vst1q_s32(acc, vaddq_s32(vld1q_s32(acc), vcombine_s32(v0, v1)));
+      acc += 4;
+    }
+#endif
+  for ( ; i<count ; i++)
+    {
+      sample = data[pos >> 16];
+      acc[0] += vol[sample*2];
+      acc[1] += vol[sample*2+1];
+      acc += 2;
+      pos += step;
+    }
+
+  data += pos >> 16;
+  if (count < MIX_SAMPLECOUNT || data >= channelsend[ch])
+    channels[ch] = 0;
+  else
+    {
+      channels[ch] = data;
+      channelstepremainder[ch] = pos & (65536-1);
+    }
+}
+
+
+/*
+ * Clamps the accumulator to 16 bit into buffer.
+ */
+static void saturate(signed short* buffer)
+{
+  int		i;
+
+#if defined(__SSE2__)
+  for (i=0 ; i<MIX_BUFFERSIZE ; i+=8)
+    _mm_storeu_si128((__m128i *) (buffer+i),
+		     _mm_packs_epi32(_mm_load_si128((__m128i *) (mixacc+i)),
+				     _mm_load_si128((__m128i *) (mixacc+i+4))));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for (i=0 ; i<MIX_BUFFERSIZE ; i+=8)
+    vst1q_s16(buffer+i, vcombine_s16(vqmovn_s32(vld1q_s32(mixacc+i)),
+				     vqmovn_s32(vld1q_s32(mixacc+i+4))));
+#else
+  int		d;
+
+  for (i=0 ; i<MIX_BUFFERSIZE ; i++)
+    {
+      d = mixacc[i];
+      if (d > 0x7fff)
+	buffer[i] = 0x7fff;
+      else if (d < -0x8000)
+	buffer[i] = -0x8000;
+      else
+	buffer[i] = d;
+    }
+#endif
+}
+
+
+void mix(signed short* buffer)
+{
+  int		ch;
+
+  memset(mixacc, 0, sizeof(mixacc));
+
+  for (ch=0 ; ch<numchannels ; ch++)
+    if (channels[ch])
+      mixchannel(ch);
+
+  mixmusic(mixacc, MIX_SAMPLECOUNT);
+
+  saturate(buffer);
+
+  mytime++;
+}
+
+
+/*
+ * Sets up the channel's volume lookup for volume and seperation.
+ */
+static void setchannelvol(int slot, int volume, int seperation)
+{
+  int		i;
+  int		rightvol;
+  int		leftvol;
+
+  /* (range: 1 - 256) */
+  seperation += 1;
+
+  /* (x^2 seperation) */
+  leftvol =
+    volume - (volume*seperation*seperation)/(256*256);
+
+  if (leftvol<0)
+    leftvol=0;
+  if (leftvol>127)
+    leftvol=127;
+
+  seperation = seperation - 257;
+
+  /* (x^2 seperation) */
+  rightvol =
+    volume - (volume*seperation*seperation)/(256*256);
+
+  if (rightvol<0)
+    rightvol=0;
+  if (rightvol>127)
+    rightvol=127;
+
+  /*
+   * get the proper lookup table pieces
+   *  for this volume level, side by side
+   */
+  for (i=0 ; i<256 ; i++)
+    {
+      channelvol[slot][i*2] = vol_lookup[leftvol*256+i];
+      channelvol[slot][i*2+1] = vol_lookup[rightvol*256+i];
+    }
+}
+
+
+int addsfx( unsigned char* data, int length, int handle,
+	    int volume, int pitch, int seperation )
+{
+  int		i;
+
+  int		oldest = mytime;
+  int		oldestnum = 0;
+  int		slot;
+
+  for (i=0 ; i<numchannels && channels[i] ; i++)
+    {
+      if (channelstart[i] < oldest)
+	{
+	  oldestnum = i;
+	  oldest = channelstart[i];
+	}
+    }
+
+  if (i == numchannels)
+    slot = oldestnum;
+  else
+    slot = i;
+
+  channels[slot] = data;
+  channelsend[slot] = channels[slot] + length;
+
+  channelhandles[slot] = handle;
+  channelstep[slot] = steptable[pitch & 255];
+  channelstepremainder[slot] = 0;
+  channelstart[slot] = mytime;
+
+  setchannelvol(slot, volume, seperation);
+
+  return slot;
+}
+
+
+void updatesfx(int handle, int volume, int seperation)
+{
+  int		i;
+
+  for (i=0 ; i<numchannels ; i++)
+    if (channels[i] && channelhandles[i] == handle)
+      {
+	setchannelvol(i, volume, seperation);
+	return;
+      }
+}
+
+
+int channelsplaying(void)
+{
+  int		i;
+
+  for (i=0 ; i<numchannels ; i++)
+    if (channels[i])
+      return 1;
+  return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DESCRIPTION:
+ *	Software sfx mixer, shared by the soundserver and the
+ *	 in-process mixer of the game.
+ *	Not thread safe; the caller serializes addsfx() and mix().
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef __MIXER_H__
+#define __MIXER_H__
+
+/* stereo frames mixed per call of mix() */
+#define MIX_SAMPLECOUNT	512
+#define MIX_BUFFERSIZE	(MIX_SAMPLECOUNT*2)
+
+/* default output rate, and the rate of sfx lumps that don't give one */
+#define MIX_SPEED	44100
+#define MIX_SFXSPEED	11025
+
+/* most channels the mixer can run, and how many it runs by default */
+#define MIX_CHANNELS	256
+#define MIX_DEFCHANNELS	8
+
+/*
+ * All sfx of the game, converted by resamplesfx(), in one block:
+ *  the header, numsfx entries indexed by sfx number (length 0 for a
+ *  missing sfx), then the data.  The game builds it once and hands it
+ *  to the soundserver as a shared memory file (-sfxfd).
+ */
+#define SFXBLOCK_MAGIC	0x58465348	/* "HSFX" */
+
+typedef struct
+{
+  int		offset;		/* from the start of the block */
+  int		length;
+} sfxentry_t;
+
+typedef struct
+{
+  int		magic;
+  int		rate;		/* output rate the data was converted to */
+  int		numsfx;
+  int		size;		/* of the whole block, in bytes */
+} sfxblock_t;
+
+void initmixer(int channels, int rate);
+
+/*
+ * Converts 8 bit unsigned sfx data from rate to the mixer's output
+ *  rate, interpolating linearly, and pads it with silence to whole
+ *  mixing blocks.  Done once per sfx at load time, so mix() only ever
+ *  steps through data at its own rate.  Returns the converted length;
+ *  with out NULL only the length is worked out.
+ */
+int resamplesfx(unsigned char* in, int length, int rate,
+		unsigned char* out);
+
+/*
+ * Starts sfx data from resamplesfx() on a free
+ *  channel or the oldest one.  volume is 0-127, pitch and seperation
+ *  0-255 with 128 as normal / centered.  handle is the caller's name
+ *  for the sound, for updatesfx().  Returns the channel used.
+ */
+int addsfx(unsigned char* data, int length, int handle,
+	   int volume, int pitch, int seperation);
+
+/*
+ * Changes volume and seperation of the sound started with handle,
+ *  if it is still playing.
+ */
+void updatesfx(int handle, int volume, int seperation);
+
+/*
+ * Mixes the next MIX_SAMPLECOUNT stereo frames into buffer.
+ * Each channel is run across the whole block into a 32 bit
+ *  accumulator, which is then saturated to 16 bit (SSE2 or NEON
+ *  where available), so the cost grows linearly with the number
+ *  of playing channels.  Music (musplay.h) is added to the same
+ *  accumulator.
+ */
+void mix(signed short* buffer);
+
+/* True while any channel is still playing. */
+int channelsplaying(void);
+
+#endif
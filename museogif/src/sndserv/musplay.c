@@ -0,0 +1,722 @@
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DESCRIPTION:
+ *	MUS music player.  The sequencer steps through the score at
+ *	 140 ticks a second, splitting the mixing block at tick
+ *	 boundaries; the synth gives each note a voice of two
+ *	 operators, a modulator feeding a carrier, set up from the
+ *	 GENMIDI patch the way DMX programmed an OPL2.  Envelopes
+ *	 are stepped every MUS_ENVCHUNK frames, the operators every
+ *	 frame.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "musplay.h"
+
+/* frames per envelope step */
+#define MUS_ENVCHUNK	16
+
+/* MUS ticks per second */
+#define MUS_TICKRATE	140
+
+#define MUS_CHANNELS	16
+#define MUS_PERCUSSION	15
+
+/* GENMIDI: 128 instruments, then percussion for notes 35-81 */
+#define GENMIDI_HEADER	8
+#define GENMIDI_INSTRS	175
+#define GENMIDI_SIZE	36
+
+#define GENMIDI_FIXED	0x0001
+
+/*
+ * Envelope attenuation, 16.16 in the OPL's steps of 0.1875 dB,
+ *  so ENV_MAX is 96 dB down: silent.
+ */
+#define ENV_STEPS	512
+#define ENV_MAX		((ENV_STEPS-1) << 16)
+
+enum
+{
+  ENV_ATTACK,
+  ENV_DECAY,
+  ENV_SUSTAIN,
+  ENV_RELEASE,
+  ENV_OFF
+};
+
+typedef struct
+{
+  unsigned int	phase;
+  unsigned int	step;
+  short*	wave;
+  /* frequency multiple, in halves */
+  int		mult;
+
+  int		state;
+  int		env;
+  /* attenuation from the patch's total level, in steps */
+  int		level;
+  /* 16.16 multiplier per envelope step, 0 for instant */
+  int		attack;
+  /* added per envelope step */
+  int		decay;
+  int		release;
+  int		sustain;
+  /* hold at the sustain level until the key is released */
+  int		hold;
+} musop_t;
+
+typedef struct
+{
+  musop_t	mod;
+  musop_t	car;
+  /* shift of the modulator's feedback, 0 for none */
+  int		feedback;
+  int		additive;
+  /* the modulator's last two outputs */
+  int		out[2];
+
+  int		active;
+  int		channel;
+  /* as played, to find it at key off */
+  int		note;
+  /* sounding note, with the patch's offset */
+  int		pitch;
+  int		volume;
+  int		left;
+  int		right;
+  int		age;
+} musvoice_t;
+
+typedef struct
+{
+  int		instrument;
+  /* 0-127 */
+  int		volume;
+  /* 0-127, 64 centered */
+  int		pan;
+  /* 0-255, 128 centered, a semitone up or down per 64 */
+  int		bend;
+  /* volume of the last note, reused when a note gives none */
+  int		notevolume;
+} muschannel_t;
+
+static int		musrate = 44100;
+
+static unsigned char*	genmidi;
+
+/* a plain FM patch for anything GENMIDI doesn't cover */
+static unsigned char	defaultinstr[GENMIDI_SIZE] =
+{
+  0, 0, 128, 0,
+  0x21, 0xf2, 0x74, 0, 0, 0x1a,  0x08,  0x21, 0xf2, 0x53, 0, 0, 0x00,
+  0,  0, 0,
+  0x21, 0xf2, 0x74, 0, 0, 0x1a,  0x08,  0x21, 0xf2, 0x53, 0, 0, 0x00,
+  0,  0, 0
+};
+
+/* the four OPL2 waveforms, 13 bit */
+static short		waves[4][1024];
+
+/* output amplitude of an attenuation, 12 bit */
+static int		amptab[ENV_STEPS];
+
+static int		attacktab[16];
+static int		decaytab[16];
+
+static musvoice_t	voices[MUS_VOICES];
+static muschannel_t	channels[MUS_CHANNELS];
+static int		voiceage;
+
+static int		musvolume = 8;
+
+/* the song */
+static unsigned char*	score;
+static unsigned char*	scoreend;
+static unsigned char*	scorepos;
+static int		playing;
+static int		paused;
+static int		looping;
+
+/* ticks to the next event */
+static unsigned int	delay;
+/* 16.16 frames to the next tick, and per tick */
+static int		tickleft;
+static int		ticklen;
+
+/* frames into the current envelope step */
+static int		envclock;
+
+
+void initmusic(unsigned char* data, int length, int rate)
+{
+  int		i;
+  int		r;
+  double	s;
+  double	chunks;
+
+  musrate = rate > 0 ? rate : 44100;
+  ticklen = ((long long) musrate << 16) / MUS_TICKRATE;
+
+  genmidi = NULL;
+  if (data && length >= GENMIDI_HEADER + GENMIDI_INSTRS*GENMIDI_SIZE
+      && !memcmp(data, "#OPL_II#", GENMIDI_HEADER))
+    genmidi = data + GENMIDI_HEADER;
+
+  for (i=0 ; i<1024 ; i++)
+    {
+      s = sin((i + 0.5) * M_PI / 512) * 4095;
+      waves[0][i] = s;
+      waves[1][i] = i < 512 ? s : 0;
+      waves[2][i] = fabs(s);
+      waves[3][i] = (i & 256) ? 0 : fabs(s);
+    }
+
+  for (i=0 ; i<ENV_STEPS ; i++)
+    amptab[i] = 4096 * pow(10.0, -i * 0.1875 / 20);
+  amptab[ENV_STEPS-1] = 0;
+
+  /*
+   * OPL2 envelope times: an attack from silence takes
+   *  2826 ms at rate 1, a decay over the full 96 dB 39280 ms,
+   *  each rate halving them.
+   */
+  for (r=0 ; r<16 ; r++)
+    {
+      if (r == 0)
+	attacktab[r] = 1 << 16;
+      else
+	{
+	  chunks = 2826.24 / (1 << (r-1)) * musrate / 1000 / MUS_ENVCHUNK;
+	  attacktab[r] = r == 15 || chunks < 1
+	    ? 0 : exp(log(1.0 / ENV_STEPS) / chunks) * 65536;
+	}
+
+      if (r == 0)
+	decaytab[r] = 0;
+      else
+	{
+	  chunks = 39280.0 / (1 << (r-1)) * musrate / 1000 / MUS_ENVCHUNK;
+	  decaytab[r] = chunks < 1 ? ENV_MAX : ENV_MAX / chunks;
+	}
+    }
+
+  memset(voices, 0, sizeof(voices));
+  playing = 0;
+}
+
+
+/*
+ * The GENMIDI record for an instrument.
+ */
+static unsigned char* getinstrument(int n)
+{
+  if (!genmidi || n < 0 || n >= GENMIDI_INSTRS)
+    return defaultinstr;
+  return genmidi + n*GENMIDI_SIZE;
+}
+
+
+/*
+ * Programs an operator from the GENMIDI bytes for
+ *  the registers 0x20, 0x60, 0x80, 0xe0 and 0x40.
+ */
+static void setoperator(musop_t* op, unsigned char* p)
+{
+  static int	mults[16] =
+  {
+    1, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 20, 24, 24, 30, 30
+  };
+  int		sl;
+
+  op->mult = mults[p[0] & 15];
+  op->hold = p[0] & 0x20;
+  op->attack = attacktab[p[1] >> 4];
+  op->decay = decaytab[p[1] & 15];
+  op->release = decaytab[p[2] & 15];
+  sl = p[2] >> 4;
+  op->sustain = (sl == 15 ? 31 : sl) * 16 << 16;
+  op->wave = waves[p[3] & 3];
+  op->level = (p[5] & 63) * 4;
+
+  op->phase = 0;
+  op->env = ENV_MAX;
+  op->state = ENV_ATTACK;
+}
+
+
+static void setstep(musvoice_t* v)
+{
+  double	step;
+
+  step = 440.0 * pow(2.0, (v->pitch - 69
+			   + (channels[v->channel].bend - 128) / 64.0) / 12)
+    * 4294967296.0 / musrate;
+  if (step > 2147483647.0)
+    step = 2147483647.0;
+
+  v->mod.step = step * v->mod.mult / 2;
+  v->car.step = step * v->car.mult / 2;
+}
+
+
+/*
+ * Left and right gains, 1024 for a full volume note
+ *  on a full volume channel at full music volume.
+ */
+static void setgain(musvoice_t* v)
+{
+  muschannel_t*	ch = &channels[v->channel];
+  int		gain;
+
+  gain = v->volume * ch->volume * musvolume * 1024 / (127*127*15);
+  v->left = gain * (ch->pan < 64 ? 64 : 127 - ch->pan) / 64;
+  v->right = gain * (ch->pan > 64 ? 64 : ch->pan) / 64;
+}
+
+
+static void keyoff(musvoice_t* v)
+{
+  if (v->mod.state != ENV_OFF)
+    v->mod.state = ENV_RELEASE;
+  if (v->car.state != ENV_OFF)
+    v->car.state = ENV_RELEASE;
+  v->note = -1;
+}
+
+
+static void noteon(int channel, int note, int volume)
+{
+  musvoice_t*	v;
+  unsigned char* instr;
+  unsigned char* p;
+  int		i;
+  int		pitch;
+
+  if (channel == MUS_PERCUSSION)
+    {
+      if (note < 35 || note > 81)
+	return;
+      instr = getinstrument(128 + note - 35);
+    }
+  else
+    instr = getinstrument(channels[channel].instrument);
+
+  /* a free voice, else the oldest released one, else the oldest */
+  v = NULL;
+  for (i=0 ; i<MUS_VOICES ; i++)
+    {
+      if (!voices[i].active)
+	{
+	  v = &voices[i];
+	  break;
+	}
+      if (!v
+	  || (voices[i].note < 0) > (v->note < 0)
+	  || ((voices[i].note < 0) == (v->note < 0)
+	      && voices[i].age < v->age))
+	v = &voices[i];
+    }
+
+  /* only the first of double voice instruments is played */
+  p = instr + 4;
+  pitch = (instr[0] | instr[1] << 8) & GENMIDI_FIXED ? instr[3] : note;
+  pitch += (short) (p[14] | p[15] << 8);
+
+  setoperator(&v->mod, p);
+  setoperator(&v->car, p + 7);
+  v->feedback = (p[6] >> 1) & 7 ? 13 + ((p[6] >> 1) & 7) : 0;
+  v->additive = p[6] & 1;
+  v->out[0] = v->out[1] = 0;
+
+  v->active = 1;
+  v->channel = channel;
+  v->note = note;
+  v->pitch = pitch;
+  v->volume = volume;
+  v->age = voiceage++;
+  setstep(v);
+  setgain(v);
+}
+
+
+static void noteoff(int channel, int note)
+{
+  int		i;
+
+  for (i=0 ; i<MUS_VOICES ; i++)
+    if (voices[i].active && voices[i].channel == channel
+	&& voices[i].note == note)
+      keyoff(&voices[i]);
+}
+
+
+static void allnotesoff(int channel, int kill)
+{
+  int		i;
+
+  for (i=0 ; i<MUS_VOICES ; i++)
+    if (voices[i].active && (channel < 0 || voices[i].channel == channel))
+      {
+	keyoff(&voices[i]);
+	if (kill)
+	  voices[i].active = 0;
+      }
+}
+
+
+static void resetchannels(void)
+{
+  int		i;
+
+  for (i=0 ; i<MUS_CHANNELS ; i++)
+    {
+      channels[i].instrument = 0;
+      channels[i].volume = 100;
+      channels[i].pan = 64;
+      channels[i].bend = 128;
+      channels[i].notevolume = 127;
+    }
+}
+
+
+/*
+ * Next score byte; running off the end ends the song.
+ */
+static int getbyte(void)
+{
+  if (scorepos >= scoreend)
+    {
+      playing = 0;
+      return 0;
+    }
+  return *scorepos++;
+}
+
+
+/*
+ * Plays one event, and reads the delay after it.
+ */
+static void runevent(void)
+{
+  int		event;
+  int		channel;
+  int		b;
+  int		value;
+  int		i;
+
+  event = getbyte();
+  channel = event & 15;
+
+  switch ((event >> 4) & 7)
+    {
+    case 0:
+      /* release note */
+      noteoff(channel, getbyte() & 127);
+      break;
+
+    case 1:
+      /* play note, with a volume if the top bit is set */
+      b = getbyte();
+      if (b & 128)
+	channels[channel].notevolume = getbyte() & 127;
+      noteon(channel, b & 127, channels[channel].notevolume);
+      break;
+
+    case 2:
+      /* pitch wheel */
+      channels[channel].bend = getbyte();
+      for (i=0 ; i<MUS_VOICES ; i++)
+	if (voices[i].active && voices[i].channel == channel)
+	  setstep(&voices[i]);
+      break;
+
+    case 3:
+      /* system event */
+      b = getbyte();
+      if (b == 10)
+	allnotesoff(channel, 1);
+      else if (b == 11)
+	allnotesoff(channel, 0);
+      else if (b == 14)
+	{
+	  channels[channel].volume = 100;
+	  channels[channel].pan = 64;
+	  channels[channel].bend = 128;
+	}
+      break;
+
+    case 4:
+      /* controller */
+      b = getbyte();
+      value = getbyte() & 127;
+      if (b == 0)
+	channels[channel].instrument = value;
+      else if (b == 3 || b == 4)
+	{
+	  if (b == 3)
+	    channels[channel].volume = value;
+	  else
+	    channels[channel].pan = value;
+	  for (i=0 ; i<MUS_VOICES ; i++)
+	    if (voices[i].active && voices[i].channel == channel)
+	      setgain(&voices[i]);
+	}
+      break;
+
+    case 5:
+      /* end of measure */
+      break;
+
+    case 6:
+      /* score end */
+      if (looping)
+	scorepos = score;
+      else
+	{
+	  playing = 0;
+	  allnotesoff(-1, 0);
+	}
+      return;
+
+    default:
+      playing = 0;
+      allnotesoff(-1, 0);
+      return;
+    }
+
+  if (event & 128)
+    {
+      value = 0;
+      do
+	{
+	  b = getbyte();
+	  value = value*128 + (b & 127);
+	} while (playing && (b & 128));
+      delay = value;
+    }
+}
+
+
+int playsong(unsigned char* data, int length, int loop)
+{
+  int		start;
+  int		len;
+
+  stopsong();
+
+  if (!data || length < 16 || memcmp(data, "MUS\x1a", 4))
+    return 0;
+  len = data[4] | data[5] << 8;
+  start = data[6] | data[7] << 8;
+  if (start >= length)
+    return 0;
+  if (len > length - start)
+    len = length - start;
+
+  score = scorepos = data + start;
+  scoreend = score + len;
+  looping = loop;
+  paused = 0;
+  delay = 0;
+  tickleft = ticklen;
+  resetchannels();
+  playing = 1;
+  return 1;
+}
+
+
+void stopsong(void)
+{
+  if (playing)
+    allnotesoff(-1, 0);
+  playing = 0;
+  score = scorepos = scoreend = NULL;
+}
+
+
+void pausesong(int pause)
+{
+  paused = pause;
+}
+
+
+void setmusicvolume(int volume)
+{
+  int		i;
+
+  musvolume = volume < 0 ? 0 : volume > 15 ? 15 : volume;
+  for (i=0 ; i<MUS_VOICES ; i++)
+    if (voices[i].active)
+      setgain(&voices[i]);
+}
+
+
+int musicvoices(void)
+{
+  int		i;
+  int		count = 0;
+
+  for (i=0 ; i<MUS_VOICES ; i++)
+    if (voices[i].active)
+      count++;
+  return count;
+}
+
+
+static void stepenvelope(musop_t* op)
+{
+  switch (op->state)
+    {
+    case ENV_ATTACK:
+      op->env = (long long) op->env * op->attack >> 16;
+      if (op->env < 1 << 16)
+	{
+	  op->env = 0;
+	  op->state = ENV_DECAY;
+	}
+      break;
+
+    case ENV_DECAY:
+      op->env += op->decay;
+      if (op->env >= op->sustain)
+	{
+	  op->env = op->sustain;
+	  op->state = op->hold ? ENV_SUSTAIN : ENV_RELEASE;
+	}
+      break;
+
+    case ENV_RELEASE:
+      op->env += op->release;
+      if (op->env >= ENV_MAX)
+	{
+	  op->env = ENV_MAX;
+	  op->state = ENV_OFF;
+	}
+      break;
+    }
+}
+
+
+static int opamp(musop_t* op)
+{
+  int		att = (op->env >> 16) + op->level;
+
+  return amptab[att < ENV_STEPS ? att : ENV_STEPS-1];
+}
+
+
+/*
+ * Adds frames of one voice into acc, envelopes held.
+ */
+static void rendervoice(musvoice_t* v, int* acc, int frames)
+{
+  short*	mwave = v->mod.wave;
+  short*	cwave = v->car.wave;
+  unsigned int	mphase = v->mod.phase;
+  unsigned int	cphase = v->car.phase;
+  unsigned int	mstep = v->mod.step;
+  unsigned int	cstep = v->car.step;
+  int		mamp = opamp(&v->mod);
+  int		camp = opamp(&v->car);
+  int		o0 = v->out[0];
+  int		o1 = v->out[1];
+  int		left = v->left;
+  int		right = v->right;
+  int		m;
+  int		s;
+  int		i;
+
+  for (i=0 ; i<frames ; i++)
+    {
+      if (v->feedback)
+	m = mwave[(mphase + ((unsigned int) (o0 + o1) << v->feedback)) >> 22];
+      else
+	m = mwave[mphase >> 22];
+      m = m * mamp >> 12;
+      o1 = o0;
+      o0 = m;
+
+      if (v->additive)
+	s = m + (cwave[cphase >> 22] * camp >> 12);
+      else
+	s = cwave[(cphase + ((unsigned int) m << 22)) >> 22] * camp >> 12;
+
+      acc[0] += s * left >> 11;
+      acc[1] += s * right >> 11;
+      acc += 2;
+      mphase += mstep;
+      cphase += cstep;
+    }
+
+  v->mod.phase = mphase;
+  v->car.phase = cphase;
+  v->out[0] = o0;
+  v->out[1] = o1;
+}
+
+
+void mixmusic(int* acc, int frames)
+{
+  musvoice_t*	v;
+  int		events = 0;
+  int		n;
+  int		i;
+
+  if (paused || (!playing && !musicvoices()))
+    return;
+
+  while (frames > 0)
+    {
+      while (playing && !delay && events < MUS_MAXEVENTS)
+	{
+	  runevent();
+	  events++;
+	}
+
+      /* up to the next tick or envelope step */
+      n = frames;
+      if (n > (tickleft + 0xffff) >> 16)
+	n = (tickleft + 0xffff) >> 16;
+      if (n > MUS_ENVCHUNK - envclock)
+	n = MUS_ENVCHUNK - envclock;
+      if (n < 1)
+	n = 1;
+
+      for (i=0, v=voices ; i<MUS_VOICES ; i++, v++)
+	if (v->active)
+	  rendervoice(v, acc, n);
+
+      acc += n*2;
+      frames -= n;
+
+      envclock += n;
+      if (envclock >= MUS_ENVCHUNK)
+	{
+	  envclock = 0;
+	  for (i=0, v=voices ; i<MUS_VOICES ; i++, v++)
+	    if (v->active)
+	      {
+		stepenvelope(&v->mod);
+		stepenvelope(&v->car);
+		if (v->car.state == ENV_OFF
+		    && (!v->additive || v->mod.state == ENV_OFF))
+		  v->active = 0;
+	      }
+	}
+
+      tickleft -= n << 16;
+      if (tickleft <= 0)
+	{
+	  tickleft += ticklen;
+	  if (delay)
+	    delay--;
+	}
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DESCRIPTION:
+ *	MUS music player: a sequencer for MUS lumps driving a small
+ *	 two operator FM synth patched from the GENMIDI lump, in the
+ *	 manner of the OPL2 cards the music was written for.
+ *	mix() renders it into the same block as the sfx, so all of
+ *	 it runs wherever the mixer does, and like the mixer it is
+ *	 not thread safe.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef __MUSPLAY_H__
+#define __MUSPLAY_H__
+
+/*
+ * Voices the synth runs at most, as many as an OPL3 has two
+ *  operator channels.  With MUS_MAXEVENTS, the bound on the
+ *  sequencer's work per block, this caps what music can cost
+ *  a block whatever the song does.
+ */
+#define MUS_VOICES	18
+#define MUS_MAXEVENTS	128
+
+/*
+ * Sets the synth up for rate.  genmidi is the GENMIDI lump, which
+ *  must stay around; with NULL every instrument is a plain default.
+ */
+void initmusic(unsigned char* genmidi, int length, int rate);
+
+/*
+ * Starts the MUS lump data, which must stay around until the next
+ *  playsong() or stopsong().  Returns 0 if it isn't a MUS lump.
+ */
+int playsong(unsigned char* data, int length, int looping);
+void stopsong(void);
+void pausesong(int paused);
+
+/* 0-15 */
+void setmusicvolume(int volume);
+
+/* Voices sounding, including ones still ringing out. */
+int musicvoices(void);
+
+/*
+ * Adds the next frames stereo frames of music to the 32 bit
+ *  interleaved accumulator acc.
+ */
+void mixmusic(int* acc, int frames);
+
+#endif
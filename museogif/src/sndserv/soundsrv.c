@@ -47,12 +47,12 @@
 #include <malloc.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 
 #include "sounds.h"
 #include "soundsrv.h"
 #include "wadread.h"
-
-#define MIX_CHANNELS	16
+#include "mixer.h"
 
 /*
  * Department of Redundancy Department.
@@ -76,9 +76,6 @@ typedef struct filelump_struct
 } filelump_t;
 
 
-/* an internal time keeper */
-static int	mytime = 0;
-
 /* number of sound effects */
 int 		numsounds;
  
@@ -97,120 +94,100 @@ int		sfxdevice;
 /* file descriptor of music device */
 int 		musdevice;
 
-/* the channel data pointers */
-unsigned char*	channels[MIX_CHANNELS] = {NULL};
-
-/* the channel step amount */
-unsigned int	channelstep[MIX_CHANNELS] = {0};
+int		snd_verbose=1;
 
-/* 0.16 bit remainder of last step */
-unsigned int	channelstepremainder[MIX_CHANNELS] = {0};
+/* mixing channels, -channels <n> */
+int		mixchannels=MIX_DEFCHANNELS;
 
-/* the channel data end pointers */
-unsigned char*	channelsend[MIX_CHANNELS] = {NULL};
+/* output latency in ms, -latency <ms> */
+int		snd_latency=0;
 
-/* time that the channel started playing */
-int		channelstart[MIX_CHANNELS] = {0};
+/* output rate, -samplerate <hz> */
+int		snd_rate=MIX_SPEED;
 
-/* the channel handles */
-int 		channelhandles[MIX_CHANNELS] = {0};
+/* set when the sfx come from the game, made for snd_rate */
+int		snd_ratefixed=0;
 
-/* the channel left volume lookup */
-int*		channelleftvol_lookup[MIX_CHANNELS] = {0};
+/* shared memory file with the game's sfx block, -sfxfd <fd> */
+int		sfxfd=-1;
 
-/* the channel right volume lookup */
-int*		channelrightvol_lookup[MIX_CHANNELS] = {0};
+void getoptions( int c, char** v )
+{
+  int		i;
 
-/* sfx id of the playing sound effect */
-int		channelids[MIX_CHANNELS] = {0};
+  for (i=1 ; i<c ; i++)
+    {
+      if (!strcmp(v[i], "-quiet"))
+	{
+	  snd_verbose = 0;
+	}
+      else if (!strcmp(v[i], "-channels") && i+1 < c)
+	{
+	  mixchannels = atoi(v[++i]);
+	}
+      else if (!strcmp(v[i], "-latency") && i+1 < c)
+	{
+	  snd_latency = atoi(v[++i]);
+	}
+      else if (!strcmp(v[i], "-samplerate") && i+1 < c)
+	{
+	  snd_rate = atoi(v[++i]);
+	}
+      else if (!strcmp(v[i], "-sfxfd") && i+1 < c)
+	{
+	  sfxfd = atoi(v[++i]);
+	}
+    }
+}
 
-int		snd_verbose=1;
+/*
+ * Maps the sfx block the game built and passed down as sfxfd,
+ *  so the sfx need not be read from the WAD and converted again.
+ * Returns 0 if it isn't usable, and grabdata() has to do it.
+ */
+int mapsfx(int fd)
+{
+  struct stat	st;
+  sfxblock_t*	block;
+  sfxentry_t*	entries;
+  int		i;
 
-int		steptable[256];
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(sfxblock_t))
+    {
+      close(fd);
+      return 0;
+    }
 
-int		vol_lookup[128*256];
+  block = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (block == MAP_FAILED)
+    return 0;
 
-static void derror(char* msg)
-{
-  fprintf(stderr, "error: %s\n", msg);
-  exit(-1);
-}
+  if (block->magic != SFXBLOCK_MAGIC || block->numsfx != NUMSFX
+      || block->size != st.st_size)
+    {
+      munmap(block, st.st_size);
+      return 0;
+    }
 
-int mix(void)
-{
+  numsounds = NUMSFX;
+  longsound = 0;
+  entries = (sfxentry_t *) (block+1);
 
-  register int		dl;
-  register int		dr;
-  register unsigned int	sample;
-  
-  signed short*		leftout;
-  signed short*		rightout;
-  signed short*		leftend;
-  
-  int			step,ch;
-  
-  leftout = mixbuffer;
-  rightout = mixbuffer+1;
-  step = 2;
-  
-  leftend = mixbuffer + SAMPLECOUNT*step;
-  
-  /* mix into the mixing buffer */
-  while (leftout != leftend)
+  for (i=1 ; i<NUMSFX ; i++)
     {
-      
-      dl = 0;
-      dr = 0;
-      
-      for (ch=0;ch < MIX_CHANNELS;ch++) {
-        if (channels[ch]) {
-	  sample = *channels[ch];
-	  dl += channelleftvol_lookup[ch][sample];
-	  dr += channelrightvol_lookup[ch][sample];
-	  channelstepremainder[ch] += channelstep[ch];
-	  channels[ch] += channelstepremainder[ch] >> 16;
-	  channelstepremainder[ch] &= 65536-1;
-	  
-	  if (channels[ch] >= channelsend[ch])
-	    channels[ch] = 0;
-	}
-      }
-     
-      /*
-       * Has been char instead of short.
-       * if (dl > 127) *leftout = 127;
-       * else if (dl < -128) *leftout = -128;
-       * else *leftout = dl;
-       
-       * if (dr > 127) *rightout = 127;
-       * else if (dr < -128) *rightout = -128;
-       * else *rightout = dr;
-       */
-
-      if (dl > 0x7fff)
-	*leftout = 0x7fff;
-      else if (dl < -0x8000)
-	*leftout = -0x8000;
-      else
-	*leftout = dl;
-      
-      if (dr > 0x7fff)
-	*rightout = 0x7fff;
-      else if (dr < -0x8000)
-	*rightout = -0x8000;
-      else
-	*rightout = dr;
-      
-      leftout += step;
-      rightout += step;
-      
+      lengths[i] = entries[i].length;
+      S_sfx[i].data = lengths[i]
+	? (unsigned char *) block + entries[i].offset : NULL;
+      if (longsound < lengths[i]) longsound = lengths[i];
     }
+
+  snd_rate = block->rate;
+  snd_ratefixed = 1;
   return 1;
 }
 
-
-
-void grabdata( int c, char** v )
+void grabdata(void)
 {
   int		i;
   char*	        name;
@@ -225,14 +202,6 @@ void grabdata( int c, char** v )
    *	sprintf(basedefault, "%s/.doomrc", home);
    */
   
-  for (i=1 ; i<c ; i++)
-    {
-      if (!strcmp(v[i], "-quiet"))
-	{
-	  snd_verbose = 0;
-	}
-    }
-
   numsounds = NUMSFX;
   longsound = 0;
 
@@ -260,7 +229,7 @@ void grabdata( int c, char** v )
 	  if (longsound < lengths[i]) longsound = lengths[i];
 	} else {
 	  S_sfx[i].data = S_sfx[i].link->data;
-	  lengths[i] = lengths[(S_sfx[i].link - S_sfx)/sizeof(sfxinfo_t)];
+	  lengths[i] = lengths[S_sfx[i].link - S_sfx];
 	}
     }
 }
@@ -271,151 +240,24 @@ static struct timezone		whocares;
 
 void updatesounds(void)
 {
-  mix();
+  mix(mixbuffer);
   I_SubmitOutputBuffer(mixbuffer, SAMPLECOUNT); 
 }
 
-int addsfx( int sfxid, int volume, int step, int seperation )
+/* Value of n hex digits at s. */
+int gethex(unsigned char* s, int n)
 {
-  static unsigned short	handlenums = 0;
-  
-  int		i;
-  int		rc = -1;
-  
-  int		oldest = mytime;
-  int		oldestnum = 0;
-  int		slot;
-  int		rightvol;
-  int		leftvol;
-
-  /*
-   * play these sound effects
-   *  only one at a time
-   */
-
-  /*
-    if ( sfxid == sfx_sawup
-    || sfxid == sfx_sawidl
-    || sfxid == sfx_sawful
-    || sfxid == sfx_sawhit
-    || sfxid == sfx_stnmov
-    || sfxid == sfx_pistol )
-  */
-
-#if 0 /* removed; do we really need this ? */
-  if ( sfxid == sfx_gntful
-       || sfxid == sfx_gnthit
-       || sfxid == sfx_stnmov )
-    
-    {
-      for (i=0 ; i<8 ; i++)
-	{
-	  if (channels[i] && channelids[i] == sfxid)
-	    {
-	      channels[i] = 0;
-	      break;
-	    }
-	}
-    }
-#endif
-  
-  for (i=0 ; i<8 && channels[i] ; i++)
-    {
-      if (channelstart[i] < oldest)
-	{
-	  oldestnum = i;
-	  oldest = channelstart[i];
-	}
-    }
-  
-  if (i == 8)
-    slot = oldestnum;
-  else
-    slot = i;
-  
-  channels[slot] = (unsigned char *) S_sfx[sfxid].data;
-  channelsend[slot] = channels[slot] + lengths[sfxid];
-  
-  if (!handlenums)
-    handlenums = 100;
-  
-  channelhandles[slot] = rc = handlenums++;
-  channelstep[slot] = step;
-  channelstepremainder[slot] = 0;
-  channelstart[slot] = mytime;
-  
-  /* (range: 1 - 256) */
-  seperation += 1;
-  
-  /* printf("seperation before leftvol: %d\n", seperation); */
-  
-  /* (x^2 seperation) */
-  leftvol =
-    volume - (volume*seperation*seperation)/(256*256);
+  int		v = 0;
 
-  if (leftvol<0) 
+  while (n--)
     {
-#ifdef _DEBUGSOUND
-      printf("warning: leftvol<0 !: %d\n", leftvol);
-#endif
-      leftvol=0; 
+      v <<= 4;
+      v += *s >= 'a' ? *s - ('a'-10) : *s - '0';
+      s++;
     }
-  if (leftvol>127)
-    {
-#ifdef _DEBUGSOUND
-      printf("warning: leftvol>127 !: %d\n", leftvol);
-#endif
-      leftvol=127;
-    }
-  
-  /* printf("leftvol: %d\n", leftvol); */
-  
-  seperation = seperation - 257;
-  
-  /* printf("seperation before rightvol: %d\n", seperation); */
-
-  /* (x^2 seperation) */
-  rightvol =
-    volume - (volume*seperation*seperation)/(256*256);
-
-  if (rightvol<0)
-    {
-#ifdef _DEBUGSOUND
-      printf("warning: rightvol<0 !: %d\n", rightvol);
-#endif
-      rightvol=0;
-    }
-
-  if (rightvol>127)
-    {
-#ifdef _DEBUGSOUND
-      printf("warning: rightvol>127 !: %d\n", rightvol);
-#endif
-      rightvol=127;
-    }
-
-  /* printf("rightvol: %d\n", rightvol); */
-  
-  /* sanity check */
-  if (rightvol < 0 || rightvol > 127)
-    derror("rightvol out of bounds");
-  
-  if (leftvol < 0 || leftvol > 127)
-    derror("leftvol out of bounds");
-  
-  /*
-   * get the proper lookup table piece
-   *  for this volume level
-   */
-  channelleftvol_lookup[slot] = &vol_lookup[leftvol*256];
-  channelrightvol_lookup[slot] = &vol_lookup[rightvol*256];
-  
-  channelids[slot] = sfxid;
-  
-  return rc;  
+  return v;
 }
 
-
 void outputushort(int num)
 {
   static unsigned char	buff[5] = { 0, 0, 0, 0, '\n' };
@@ -442,32 +284,22 @@ void outputushort(int num)
 
 void initdata(void)
 {
-  int		i;
-  int		j;
-  
-  int*	        steptablemid = steptable + 128;
-  
-  for (i=0 ;
-       i<sizeof(channels)/sizeof(unsigned char *) ;
-       i++)
-    {
-      channels[i] = 0;
-    }
+  initmixer(mixchannels, snd_rate);
   
   gettimeofday(&last, &whocares);
-  
-  for (i=-128 ; i<128 ; i++)
-    steptablemid[i] = pow(2.0, (i/64.0))*65536.0;
-  
-  for (i=0 ; i<128 ; i++)
-    for (j=0 ; j<256 ; j++)
-      vol_lookup[i*256+j] = (i*(j-128)*256)/127;
-  
 }
 
 
 void quit(void)
 {
+  int		underruns;
+  int		overruns;
+
+  I_OutputStats(&underruns, &overruns);
+  if (snd_verbose)
+    fprintf(stderr, "sndserver: %d underruns, %d overruns\n",
+	    underruns, overruns);
+
   /* I_ShutdownMusic(); */
   I_ShutdownSound();
   exit(0);
@@ -485,24 +317,39 @@ int main( int c, char**	v )
   int		sndnum;
 //  int		handle = 0;
   
-  unsigned char	commandbuf[10];
-  struct timeval	zerowait = { 0, 0 };
+  unsigned char	commandbuf[16];
+  unsigned char	paramsbuf[255*8+1];
+  int		handle;
+  int		count;
+  int		i;
+  struct timeval	wait;
+  int		delay;
   
   
   int 	        step;
   int 	        vol;
   int		sep;
   
-  int		i;
   int		waitingtofinish=0;
   
-  /* get sound data */
-  grabdata(c, v);
+  getoptions(c, v);
+  
+  /* the game's sfx block fixes the rate */
+  if (sfxfd >= 0 && !mapsfx(sfxfd))
+    {
+      fprintf(stderr, "sndserver: bad sfx block, loading from the WAD\n");
+      sfxfd = -1;
+    }
+  
+  /* otherwise the sfx are converted to the rate the device really runs at */
+  snd_rate = I_InitSound(snd_rate, 16);
   
   /* init any data */
   initdata();
   
-  I_InitSound(11025, 16);
+  /* get sound data */
+  if (sfxfd < 0)
+    grabdata();
   
   /* I_InitMusic(); */
   
@@ -515,13 +362,18 @@ int main( int c, char**	v )
 
   while (!done)
     {
-      mytime++;
-      
       if (!waitingtofinish)
 	{
+	  /*
+	   * Start sounds as their commands come in,
+	   *  until the output has room for the next block.
+	   */
 	  do {
 	    scratchset = fdset;
-	    rc = select(FD_SETSIZE, &scratchset, 0, 0, &zerowait);
+	    delay = I_OutputDelay();
+	    wait.tv_sec = delay / 1000000;
+	    wait.tv_usec = delay % 1000000;
+	    rc = select(FD_SETSIZE, &scratchset, 0, 0, &wait);
 	    
 	    if (rc > 0)
 	      {
@@ -545,14 +397,16 @@ int main( int c, char**	v )
 		      {
 		      case 'p':
 			/* play a new sound effect */
-			read(0, commandbuf, 9);
+			read(0, commandbuf, 13);
 			
 			if (snd_verbose)
 			  {
-			    commandbuf[9]=0;
+			    commandbuf[13]=0;
 			    fprintf(stderr, "%s\n", commandbuf);
 			  }
 			
+			handle = gethex(commandbuf+8, 4);
+			
 			commandbuf[0] -=
 			  commandbuf[0]>='a' ? 'a'-10 : '0';
 			commandbuf[1] -=
@@ -570,18 +424,32 @@ int main( int c, char**	v )
 			commandbuf[7] -=
 			  commandbuf[7]>='a' ? 'a'-10 : '0';
 			
-			/*	p<snd#><step><vol><sep> */
+			/*	p<snd#><step><vol><sep><handle> */
 			sndnum = (commandbuf[0]<<4) + commandbuf[1];
 			step = (commandbuf[2]<<4) + commandbuf[3];
-			step = steptable[step];
 			vol = (commandbuf[4]<<4) + commandbuf[5];
 			sep = (commandbuf[6]<<4) + commandbuf[7];
 			
-			/*handle = */addsfx(sndnum, vol, step, sep);
+			addsfx(S_sfx[sndnum].data, lengths[sndnum], handle,
+			       vol, step, sep);
+			break;
+			
+		      case 'u':
 			/*
-			 * returns the handle
-			 *	outputushort(handle);
+			 * a frame's parameter changes,
+			 *  u<count>[<handle><vol><sep>]...
 			 */
+			read(0, commandbuf, 2);
+			count = gethex(commandbuf, 2);
+			read(0, paramsbuf, count*8+1);
+			
+			if (snd_verbose)
+			  fprintf(stderr, " %d updates\n", count);
+			
+			for (i=0 ; i<count ; i++)
+			  updatesfx(gethex(paramsbuf+i*8, 4),
+				    gethex(paramsbuf+i*8+4, 2),
+				    gethex(paramsbuf+i*8+6, 2));
 			break;
 			
 		      case 'q':
@@ -617,14 +485,19 @@ int main( int c, char**	v )
 	      }
 	  } while (rc > 0);
 	}
+      else
+	{
+	  delay = I_OutputDelay();
+	  wait.tv_sec = delay / 1000000;
+	  wait.tv_usec = delay % 1000000;
+	  select(0, 0, 0, 0, &wait);
+	}
       
       updatesounds();
       
       if (waitingtofinish)
 	{
-	  for(i=0 ; i<8 && !channels[i] ; i++);
-	  
-	  if (i==8)
+	  if (!channelsplaying())
 	    done=1;
 	}
       
@@ -26,17 +26,38 @@
 #ifndef __SNDSERVER_H__
 #define __SNDSERVER_H__
 
-#define SAMPLECOUNT	512
+#include "mixer.h"
+
+#define SAMPLECOUNT	MIX_SAMPLECOUNT
 #define MIXBUFFERSIZE	(SAMPLECOUNT*2*2)
-#define SPEED		11025
+#define SPEED		MIX_SPEED
 
 
 void I_InitMusic(void);
 
-void I_InitSound( int samplerate, int samplesound );
+/* Returns the rate the device was opened at. */
+int I_InitSound( int samplerate, int samplesound );
+
+/*
+ * Microseconds until the output has room for the next block
+ *  under the latency target; the server waits for commands that long.
+ */
+int I_OutputDelay( void );
 
 void I_SubmitOutputBuffer( void* samples, int samplecount );
 
+/* Times the output ran dry, and blocks dropped for lack of room. */
+void I_OutputStats( int* underruns, int* overruns );
+
+/* -latency <ms>: output queued ahead of the audio device, 0 for default */
+extern int snd_latency;
+
+/* -samplerate <hz>: output rate */
+extern int snd_rate;
+
+/* The sfx came converted for snd_rate; the device must run at it. */
+extern int snd_ratefixed;
+
 void I_ShutdownSound(void);
 void I_ShutdownMusic(void);
 
@@ -291,10 +291,9 @@ void* loadlump( char* lumpname, int* size )
 void* getsfx( char* sfxname, int* len )
 {
   unsigned char*	sfx;
-  unsigned char*	paddedsfx;
-  int			i;
+  unsigned char*	convertedsfx;
   int			size;
-  int			paddedsize;
+  int			rate;
   char		        name[20];
   
   /* sprintf(name, "ds%s", sfxname); */
@@ -307,15 +306,25 @@ void* getsfx( char* sfxname, int* len )
 #ifdef _DEBUGSOUND
   fprintf(stderr, "Sfxsize: %d\n", size );
 #endif
+  if (!sfx || size <= 8)
+    {
+      free(sfx);
+      *len = 0;
+      return NULL;
+    }
   
-  /* pad the sound effect out to the mixing buffer size */
-  paddedsize = ((size-8 + (SAMPLECOUNT-1)) / SAMPLECOUNT) * SAMPLECOUNT;
-  paddedsfx = (unsigned char *) realloc(sfx, paddedsize+8);
-  for (i=size ; i<paddedsize+8 ; i++)
-    paddedsfx[i] = 128;
+  /*
+   * convert the sound effect to the output rate,
+   *  padded out to the mixing buffer size
+   */
+  rate = sfx[2] | (sfx[3]<<8);
+  *len = resamplesfx(sfx+8, size-8, rate, NULL);
+  convertedsfx = (unsigned char *) malloc(*len);
+  assert(convertedsfx);
+  resamplesfx(sfx+8, size-8, rate, convertedsfx);
+  free(sfx);
   
-  *len = paddedsize;
-  return (void *) (paddedsfx + 8);  
+  return (void *) convertedsfx;
 }
 
 static int findlump(char *lumpname)
@@ -1,7 +1,12 @@
 
+#ifdef SNDSERV
+#define _GNU_SOURCE		/* memfd_create */
+#endif /* SNDSERV */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include <math.h>
 
@@ -19,111 +24,165 @@
 
 #include "i_sound.h"
 #include "doomdef.h"
+#include "sndserv/mixer.h"
+#include "sndserv/musplay.h"
 
 /* UNIX hack, to be removed. */
 #ifdef SNDSERV
+#include <sys/mman.h>
+
 /* Separate sound server process. */
 FILE*	sndserver=0;
 char*	sndserver_filename = "./sndserver";
 char*	sndserver_options = "-quiet";
-#endif /* SNDSERV */
-
-/*
- * The number of internal mixing channels,
- *  the samples calculated for each mixing step,
- *  the size of the 16bit, 2 hardware channel (stereo)
- *  mixing buffer, and the samplerate of the raw data.
- */
-
-/* Needed for calling the actual sound output. */
-#define SAMPLECOUNT		512
-#define NUM_CHANNELS		8
-/* It is 2 for 16bit, and 2 for two channels. */
-#define BUFMUL                  4
-#define MIXBUFFERSIZE		(SAMPLECOUNT*BUFMUL)
 
-#define SAMPLERATE		11025	/* Hz */
-#define SAMPLESIZE		2   	/* 16bit */
+/* Memory file holding sfxblock, handed to the sound server. */
+static int	sfxfd = -1;
+#else
+#include "SDL/SDL.h"
+#endif /* SNDSERV */
 
 /* The actual lengths of all sound effects. */
 int 		lengths[NUMSFX];
 
-/* The actual output device. */
-int	        audio_fd;
+/* All sfx, converted to the output rate, in one block. */
+static sfxblock_t*	sfxblock;
+
+/* Rate the mixer runs at. */
+static int		sndrate = MIX_SPEED;
 
 /*
- * The global mixing buffer.
- * Basically, samples from all active internal channels
- *  are modifed and added, and stored in the buffer
- *  that is submitted to the audio device.
+ * Handles name the started sounds to the mixer.  It can't be asked
+ *  whether a sound still plays, so when one will end is worked out
+ *  from its length and pitch as it starts.
  */
-signed short	mixbuffer[MIXBUFFERSIZE];
+#define SNDHANDLES		256	/* power of two */
 
+static int		sndhandle;
+static int		sndends[SNDHANDLES];
 
-/* The channel step amount... */
-unsigned int	channelstep[NUM_CHANNELS];
-/* ... and a 0.16 bit remainder of last step. */
-unsigned int	channelstepremainder[NUM_CHANNELS];
-
+/*
+ * Parameter changes made in one S_UpdateSounds,
+ *  which I_SubmitSound hands to the mixer together.
+ */
+#define SNDPARAMS		64
 
-/* The channel data pointers, start and end. */
-unsigned char*	channels[NUM_CHANNELS];
-unsigned char*	channelsend[NUM_CHANNELS];
+typedef struct
+{
+  int		handle;
+  int		volume;
+  int		sep;
+} sndparam_t;
 
+typedef struct
+{
+  int		count;
+  sndparam_t	params[SNDPARAMS];
+} sndbatch_t;
 
+#ifdef SNDSERV
+/* Parameter changes not yet written to the sound server. */
+static sndbatch_t	sndbatch;
+#else
 /*
- * Time/gametic that the channel started playing,
- *  used to determine oldest, which automatically
- *  has lowest priority.
- * In case number of active sounds exceeds
- *  available channels.
+ * In-process mixer.
+ * The game thread queues sounds and music on a single-producer/
+ *  single-consumer ring; the SDL audio thread drains it before every
+ *  block and mixes with the soundserver's mixer, which also runs the
+ *  music synth.  Neither side ever waits for the other, and starting
+ *  a sound costs no syscall.
  */
-int		channelstart[NUM_CHANNELS];
 
-/*
- * The sound in channel handles,
- *  determined on registration,
- *  might be used to unregister/stop/modify,
- *  currently unused.
- */
-int 		channelhandles[NUM_CHANNELS];
+/* Must be a power of two. */
+#define SNDCMDS			256
+
+enum
+{
+  SNDCMD_SFX,
+  SNDCMD_PLAYSONG,
+  SNDCMD_STOPSONG,
+  SNDCMD_PAUSESONG,
+  SNDCMD_MUSICVOLUME
+};
+
+typedef struct
+{
+  int		type;
+  int		sfxid;
+  int		handle;
+  int		volume;
+  int		pitch;
+  int		sep;
+  /* song, handed over to the audio thread */
+  byte*		data;
+  int		length;
+  /* looping, paused or music volume */
+  int		value;
+} sndcmd_t;
+
+static sndcmd_t		sndcmds[SNDCMDS];
+/* Next free slot, written by the game thread only. */
+static unsigned int	sndcmdhead;
+/* Next slot to play, written by the audio thread only. */
+static unsigned int	sndcmdtail;
+/* Sounds and parameter changes lost to a full ring. */
+static int		sndcmdsdropped;
+
+/* Parameter batches go on a ring of their own.  Power of two. */
+#define SNDBATCHES		4
+
+static sndbatch_t	sndbatches[SNDBATCHES];
+static unsigned int	sndbatchhead;
+static unsigned int	sndbatchtail;
+
+/* Mixed block, and how many of its frames have been played. */
+static signed short	mixbuffer[MIX_BUFFERSIZE];
+static int		mixplayed = MIX_SAMPLECOUNT;
+
+static boolean		mixeropen;
+static boolean		musicopen;
+
+/* GENMIDI patches, for the synth. */
+static byte*		genmidi;
+
+/* Song registered by the game, not yet handed to the audio thread. */
+static byte*		regsong;
+static int		regsonglength;
+
+/* Song the audio thread plays, owned by it. */
+static byte*		mussong;
 
 /*
- * SFX id of the playing sound effect.
- * Used to catch duplicates (like chainsaw).
+ * -wavout <file>: no device is opened.  The game thread mixes the
+ *  blocks each tic lasts and writes them to a WAV file, so the output
+ *  only depends on the tics run, not on how fast they run.
  */
-int		channelids[NUM_CHANNELS];
-
-/* Pitch to stepping lookup, unused. */
-int		steptable[256];
-
-/* Volume lookups. */
-int		vol_lookup[128*256];
+static FILE*		wavfile;
+/* Frames written, header not counted. */
+static unsigned int	wavframes;
+#endif /* SNDSERV */
 
-/* Hardware left and right channel volume lookup. */
-int*		channelleftvol_lookup[NUM_CHANNELS];
-int*		channelrightvol_lookup[NUM_CHANNELS];
 
+/*
+ * Milliseconds on the clock sounds play by:
+ *  with -wavout, the length of the audio written so far.
+ */
+static int I_SoundTime(void)
+{
+#ifndef SNDSERV
+  if (wavfile)
+    return (long long) wavframes * 1000 / sndrate;
+#endif
+  return I_GetTimeMS();
+}
 
 
 void I_SetChannels()
 {
   /*
-   * Init internal lookups (raw data, mixing buffer, channels).
-   * This function sets up internal lookups used during
-   *  the mixing process.
+   * The mixing lookups belong to the mixer,
+   *  which sets them up in I_InitSound.
    */
-  int		i;
-  int		j;
-
-  /*
-   * Generates volume lookup tables
-   *  which also turn the unsigned samples
-   *  into signed samples.
-   */
-  for (i=0 ; i<128 ; i++)
-    for (j=0 ; j<256 ; j++)
-      vol_lookup[i*256+j] = (i*(j-128)*256)/127;
 }
 
 
@@ -150,6 +209,37 @@ int I_GetSfxLumpNum(sfxinfo_t* sfx)
   return W_GetNumForName(namebuf);
 }
 
+#ifndef SNDSERV
+/*
+ * The ring slot for the next command, NULL if it can't be queued.
+ */
+static sndcmd_t* I_SoundCommand(int type)
+{
+  sndcmd_t*	cmd;
+
+  if (!mixeropen)
+    return NULL;
+  if (sndcmdhead - __atomic_load_n(&sndcmdtail, __ATOMIC_ACQUIRE) == SNDCMDS)
+    {
+      sndcmdsdropped++;
+      return NULL;
+    }
+  cmd = &sndcmds[sndcmdhead & (SNDCMDS-1)];
+  cmd->type = type;
+  return cmd;
+}
+
+
+/*
+ * Hands the command filled in at I_SoundCommand to the audio thread.
+ */
+static void I_PostSoundCommand(void)
+{
+  __atomic_store_n(&sndcmdhead, sndcmdhead+1, __ATOMIC_RELEASE);
+}
+#endif /* SNDSERV */
+
+
 /*
  * Starting a sound means adding it
  *  to the current list of active sounds
@@ -164,15 +254,42 @@ int I_GetSfxLumpNum(sfxinfo_t* sfx)
  */
 int I_StartSound( int id, int vol, int sep, int pitch, int __attribute__((unused)) priority )
 {
+  int		handle;
+  boolean	started = false;
+#ifndef SNDSERV
+  sndcmd_t*	cmd;
+#endif
+
+  if (++sndhandle > 0xffff)
+    sndhandle = 1;
+  handle = sndhandle;
+
 #ifdef SNDSERV
   if (sndserver)
     {
-      fprintf(sndserver, "p%2.2x%2.2x%2.2x%2.2x\n", id, pitch, vol*8, sep);
+      fprintf(sndserver, "p%2.2x%2.2x%2.2x%2.2x%4.4x\n",
+	      id, pitch, vol*8, sep, handle);
       fflush(sndserver);
+      started = true;
+    }
+#else
+  if (S_sfx[id].data && (cmd = I_SoundCommand(SNDCMD_SFX)) != NULL)
+    {
+      cmd->sfxid = id;
+      cmd->handle = handle;
+      cmd->volume = vol*8;
+      cmd->pitch = pitch;
+      cmd->sep = sep;
+      I_PostSoundCommand();
+      started = true;
     }
-  /* warning: control reaches end of non-void function. */
 #endif
-  return id;
+
+  sndends[handle & (SNDHANDLES-1)] = I_SoundTime();
+  if (started)
+    sndends[handle & (SNDHANDLES-1)] +=
+      lengths[id] * 1000.0 / (sndrate * pow(2.0, (pitch-128)/64.0));
+  return handle;
 }
 
 void I_StopSound (int __attribute__((unused)) handle)
@@ -187,156 +304,365 @@ void I_StopSound (int __attribute__((unused)) handle)
 
 int I_SoundIsPlaying(int handle)
 {
-  /* Ouch. */
-  return gametic < handle;
+  return I_SoundTime() - sndends[handle & (SNDHANDLES-1)] < 0;
 }
 
 
 
 /*
- * This function loops all active (internal) sound
- *  channels, retrieves a given number of samples
- *  from the raw sound data, modifies it according
- *  to the current (internal) channel parameters,
- *  mixes the per channel samples into the global
- *  mixbuffer, clamping it to the allowed range,
- *  and sets up everything for transferring the
- *  contents of the mixbuffer to the (two)
- *  hardware channels (left and right, that is).
- *
- * This function currently supports only 16bit.
+ * The batch I_UpdateSoundParams adds to, NULL if there is no room.
  */
-void I_UpdateSound( void )
+static sndbatch_t* I_SoundBatch(void)
 {
-  /*
-   * Mix current sound data.
-   * Data, from raw sound, for right and left.
-   */
-  register unsigned int	sample;
-  register int		dl;
-  register int		dr;
-  
-  /* Pointers in global mixbuffer, left, right, end. */
-  signed short*		leftout;
-  signed short*		rightout;
-  signed short*		leftend;
-  /* Step in mixbuffer, left and right, thus two. */
-  int			step;
-  
-  /* Mixing channel index. */
-  int			chan;
-  
-  /*
-   * Left and right channel
-   *  are in global mixbuffer, alternating.
-   */
-  leftout = mixbuffer;
-  rightout = mixbuffer+1;
-  step = 2;
-  
-    /*
-     * Determine end, for left channel only
-     *  (right channel is implicit).
-     */
-    leftend = mixbuffer + SAMPLECOUNT*step;
-    
-    /*
-     * Mix sounds into the mixing buffer.
-     * Loop over step*SAMPLECOUNT,
-     *  that is 512 values for two channels.
-     */
-    while (leftout != leftend)
-      {
-	/* Reset left/right value. */
-	dl = 0;
-	dr = 0;
-	
-	/*
-	 * Love thy L2 chache - made this a loop.
-	 * Now more channels could be set at compile time
-	 *  as well. Thus loop those  channels.
-	 */
-	for ( chan = 0; chan < NUM_CHANNELS; chan++ )
-	  {
-	    /* Check channel, if active. */
-	    if (channels[ chan ])
-	      {
-		/* Get the raw data from the channel. */
-		sample = *channels[ chan ];
-		/*
-		 * Add left and right part
-		 *  for this channel (sound)
-		 *  to the current data.
-		 * Adjust volume accordingly.
-		 */
-		dl += channelleftvol_lookup[ chan ][sample];
-		dr += channelrightvol_lookup[ chan ][sample];
-		/* Increment index ??? */
-		channelstepremainder[ chan ] += channelstep[ chan ];
-		/* MSB is next sample??? */
-		channels[ chan ] += channelstepremainder[ chan ] >> 16;
-		/* Limit to LSB??? */
-		channelstepremainder[ chan ] &= 65536-1;
-		
-		/* Check whether we are done. */
-		if (channels[ chan ] >= channelsend[ chan ])
-		  channels[ chan ] = 0;
-	      }
-	  }
-	
-	/*
-	 * Clamp to range. Left hardware channel.
-	 * Has been char instead of short.
-	 * if (dl > 127) *leftout = 127;
-	 * else if (dl < -128) *leftout = -128;
-	 * else *leftout = dl;
-	 */
-	
-	if (dl > 0x7fff)
-	  *leftout = 0x7fff;
-	else if (dl < -0x8000)
-	  *leftout = -0x8000;
-	else
-	  *leftout = dl;
-	
-	/* Same for right hardware channel. */
-	if (dr > 0x7fff)
-	  *rightout = 0x7fff;
-	else if (dr < -0x8000)
-	  *rightout = -0x8000;
-	else
-	  *rightout = dr;
-	
-	/* Increment current pointers in mixbuffer. */
-	leftout += step;
-	rightout += step;
-      }
+#ifdef SNDSERV
+  return &sndbatch;
+#else
+  if (sndbatchhead - __atomic_load_n(&sndbatchtail, __ATOMIC_ACQUIRE)
+      == SNDBATCHES)
+    return NULL;
+  return &sndbatches[sndbatchhead & (SNDBATCHES-1)];
+#endif
 }
 
 
 /*
- * This would be used to write out the mixbuffer
- *  during each game loop update.
- * Updates sound buffer and audio device at runtime.
- * It is called during Timer interrupt with SNDINTR.
- * Mixing now done synchronous, and
- *  only output be done asynchronous?
+ * Hands the parameter changes made since the last call
+ *  to the mixer, as one message.
  */
 void I_SubmitSound(void)
 {
-  /* Write it to DSP device. */
-  write(audio_fd, mixbuffer, SAMPLECOUNT*BUFMUL);
+  sndbatch_t*	batch = I_SoundBatch();
+#ifdef SNDSERV
+  char		buffer[4 + SNDPARAMS*8 + 2];
+  char*		p;
+  int		i;
+#endif
+
+  if (!batch || !batch->count)
+    return;
+
+#ifdef SNDSERV
+  if (sndserver)
+    {
+      /* u<count>[<handle><vol><sep>]... */
+      p = buffer + sprintf(buffer, "u%2.2x", batch->count);
+      for (i=0 ; i<batch->count ; i++)
+	p += sprintf(p, "%4.4x%2.2x%2.2x", batch->params[i].handle,
+		     batch->params[i].volume, batch->params[i].sep);
+      *p++ = '\n';
+      fwrite(buffer, 1, p - buffer, sndserver);
+      fflush(sndserver);
+    }
+  batch->count = 0;
+#else
+  /* the audio thread clears the batch once it is done with it */
+  __atomic_store_n(&sndbatchhead, sndbatchhead+1, __ATOMIC_RELEASE);
+#endif
 }
 
 
-void I_UpdateSoundParams( int __attribute__((unused)) handle, int __attribute__((unused)) vol, int __attribute__((unused)) sep, int __attribute__((unused)) pitch )
+#ifndef SNDSERV
+/*
+ * Audio thread: starts the queued sounds.
+ */
+static void I_RunSoundCommands(void)
 {
+  unsigned int	head;
+  unsigned int	tail;
+  unsigned int	batchhead;
+  sndcmd_t*	cmd;
+  sndbatch_t*	batch;
+  int		i;
+
   /*
-   * I fail too see that this is used.
-   * Would be using the handle to identify
-   *  on which channel the sound might be active,
-   *  and resetting the channel parameters.
+   * Batches first: the sounds a batch changes were queued
+   *  before it, so they are seen here too.
    */
+  batchhead = __atomic_load_n(&sndbatchhead, __ATOMIC_ACQUIRE);
+  head = __atomic_load_n(&sndcmdhead, __ATOMIC_ACQUIRE);
+  for (tail = sndcmdtail ; tail != head ; tail++)
+    {
+      cmd = &sndcmds[tail & (SNDCMDS-1)];
+      switch (cmd->type)
+	{
+	case SNDCMD_SFX:
+	  addsfx(S_sfx[cmd->sfxid].data, lengths[cmd->sfxid], cmd->handle,
+		 cmd->volume, cmd->pitch, cmd->sep);
+	  break;
+
+	case SNDCMD_PLAYSONG:
+	  stopsong();
+	  free(mussong);
+	  mussong = cmd->data;
+	  playsong(mussong, cmd->length, cmd->value);
+	  break;
+
+	case SNDCMD_STOPSONG:
+	  stopsong();
+	  free(mussong);
+	  mussong = NULL;
+	  break;
+
+	case SNDCMD_PAUSESONG:
+	  pausesong(cmd->value);
+	  break;
+
+	case SNDCMD_MUSICVOLUME:
+	  setmusicvolume(cmd->value);
+	  break;
+	}
+    }
+  __atomic_store_n(&sndcmdtail, tail, __ATOMIC_RELEASE);
+
+  for (tail = sndbatchtail ; tail != batchhead ; tail++)
+    {
+      batch = &sndbatches[tail & (SNDBATCHES-1)];
+      for (i=0 ; i<batch->count ; i++)
+	updatesfx(batch->params[i].handle, batch->params[i].volume,
+		  batch->params[i].sep);
+      batch->count = 0;
+    }
+  __atomic_store_n(&sndbatchtail, tail, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * SDL audio callback, the mixer thread.
+ * Commands are picked up at block boundaries, as the
+ *  sound server did between its mix() calls.
+ */
+static void I_MixSound(void __attribute__((unused)) *user, Uint8 *stream, int len)
+{
+  int		frames;
+
+  while (len >= 4)
+    {
+      if (mixplayed == MIX_SAMPLECOUNT)
+	{
+	  I_RunSoundCommands();
+	  mix(mixbuffer);
+	  mixplayed = 0;
+	}
+
+      frames = MIX_SAMPLECOUNT - mixplayed;
+      if (frames > len/4)
+	frames = len/4;
+      memcpy(stream, mixbuffer + mixplayed*2, frames*4);
+      mixplayed += frames;
+      stream += frames*4;
+      len -= frames*4;
+    }
+}
+
+
+
+
+/*
+ * Stores value little endian at p, for the WAV header.
+ */
+static void I_PutWavLong(byte* p, int value)
+{
+  p[0] = value;
+  p[1] = value >> 8;
+  p[2] = value >> 16;
+  p[3] = value >> 24;
+}
+
+
+/*
+ * Writes the WAV header for wavframes frames at the start of wavfile.
+ */
+static void I_WriteWavHeader(void)
+{
+  byte		header[44];
+  int		size = wavframes*4;
+
+  memcpy(header, "RIFF", 4);
+  I_PutWavLong(header+4, 36 + size);
+  memcpy(header+8, "WAVEfmt ", 8);
+  I_PutWavLong(header+16, 16);
+  /* PCM, stereo */
+  I_PutWavLong(header+20, 1 | (2 << 16));
+  I_PutWavLong(header+24, sndrate);
+  I_PutWavLong(header+28, sndrate*4);
+  /* 4 bytes a frame, 16 bits a sample */
+  I_PutWavLong(header+32, 4 | (16 << 16));
+  memcpy(header+36, "data", 4);
+  I_PutWavLong(header+40, size);
+
+  fseek(wavfile, 0, SEEK_SET);
+  fwrite(header, 1, sizeof(header), wavfile);
+  fseek(wavfile, 0, SEEK_END);
+}
+#endif /* SNDSERV */
+
+
+/*
+ * Mixing runs on the audio thread (or in the sound server),
+ *  so there is nothing to do per game loop.  With -wavout the mixer
+ *  is run here instead, once per tic: the sounds the tic started are
+ *  picked up, then blocks are mixed up to the time the tics run so
+ *  far last.  So every run of the same tics writes the same file.
+ */
+void I_UpdateSound( void )
+{
+#ifndef SNDSERV
+  unsigned int	frames;
+#ifdef __BIG_ENDIAN__
+  int		i;
+#endif
+
+  if (!wavfile)
+    return;
+
+  I_RunSoundCommands();
+  frames = (long long) gametic * sndrate / TICRATE;
+  while (wavframes + MIX_SAMPLECOUNT <= frames)
+    {
+      mix(mixbuffer);
+#ifdef __BIG_ENDIAN__
+      for (i=0 ; i<MIX_BUFFERSIZE ; i++)
+	mixbuffer[i] = SHORT(mixbuffer[i]);
+#endif
+      fwrite(mixbuffer, 4, MIX_SAMPLECOUNT, wavfile);
+      wavframes += MIX_SAMPLECOUNT;
+    }
+#endif /* SNDSERV */
+}
+
+
+#ifdef SNDSERV
+/*
+ * The sfx block goes into an unlinked memory file, which the sound
+ *  server inherits and maps read-only: the sfx exist once, and the
+ *  server never opens the WAD.
+ */
+static void* I_AllocSfxBlock(int size)
+{
+  void*		block;
+  FILE*		f;
+
+#ifdef MFD_CLOEXEC
+  sfxfd = memfd_create("heretic-sfx", 0);
+#endif
+  if (sfxfd < 0 && (f = tmpfile()) != NULL)
+    {
+      sfxfd = dup(fileno(f));
+      fclose(f);
+    }
+  if (sfxfd < 0)
+    return NULL;
+
+  if (ftruncate(sfxfd, size) < 0
+      || (block = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		       sfxfd, 0)) == MAP_FAILED)
+    {
+      close(sfxfd);
+      sfxfd = -1;
+      return NULL;
+    }
+  return block;
+}
+#else
+static void* I_AllocSfxBlock(int size)
+{
+  void*		block = malloc(size);
+
+  if (!block)
+    I_Error("I_LoadSfx: can't allocate %i bytes", size);
+  return block;
+}
+#endif /* SNDSERV */
+
+
+/*
+ * Converts every sfx lump to the mixer's output rate into one
+ *  sfxblock_t, padded with silence to the mixing block size.
+ */
+static void I_LoadSfx(int rate)
+{
+  int		i;
+  int		lump;
+  int		size;
+  byte*		sfx;
+  byte*		p;
+  sfxentry_t*	entries;
+
+  size = sizeof(sfxblock_t) + NUMSFX*sizeof(sfxentry_t);
+  for (i=1 ; i<NUMSFX ; i++)
+    {
+      lengths[i] = 0;
+      if (S_sfx[i].link)
+	continue;
+      lump = W_CheckNumForName(S_sfx[i].name);
+      if (lump < 0 || W_LumpLength(lump) <= 8)
+	continue;
+      sfx = W_CacheLumpNum(lump, PU_CACHE);
+      lengths[i] = resamplesfx(sfx+8, W_LumpLength(lump)-8,
+			       sfx[2] | (sfx[3]<<8), NULL);
+      size += lengths[i];
+    }
+
+  sfxblock = I_AllocSfxBlock(size);
+  if (!sfxblock)
+    return;
+  sfxblock->magic = SFXBLOCK_MAGIC;
+  sfxblock->rate = rate;
+  sfxblock->numsfx = NUMSFX;
+  sfxblock->size = size;
+  entries = (sfxentry_t *) (sfxblock+1);
+  memset(entries, 0, NUMSFX*sizeof(sfxentry_t));
+
+  p = (byte *) (entries + NUMSFX);
+  for (i=1 ; i<NUMSFX ; i++)
+    {
+      S_sfx[i].data = NULL;
+      if (!lengths[i])
+	continue;
+      lump = W_CheckNumForName(S_sfx[i].name);
+      sfx = W_CacheLumpNum(lump, PU_CACHE);
+      resamplesfx(sfx+8, W_LumpLength(lump)-8, sfx[2] | (sfx[3]<<8), p);
+      entries[i].offset = p - (byte *) sfxblock;
+      entries[i].length = lengths[i];
+      S_sfx[i].data = p;
+      p += lengths[i];
+    }
+
+  for (i=1 ; i<NUMSFX ; i++)
+    if (S_sfx[i].link)
+      {
+	entries[i] = entries[S_sfx[i].link - S_sfx];
+	S_sfx[i].data = S_sfx[i].link->data;
+	lengths[i] = entries[i].length;
+      }
+}
+
+
+/*
+ * Queues the change for the next I_SubmitSound.
+ */
+void I_UpdateSoundParams( int handle, int vol, int sep, int __attribute__((unused)) pitch )
+{
+  sndbatch_t*	batch = I_SoundBatch();
+  sndparam_t*	param;
+
+  if (batch && batch->count == SNDPARAMS)
+    {
+      I_SubmitSound();
+      batch = I_SoundBatch();
+    }
+  if (!batch)
+    {
+#ifndef SNDSERV
+      sndcmdsdropped++;
+#endif
+      return;
+    }
+
+  param = &batch->params[batch->count++];
+  param->handle = handle;
+  param->volume = vol*8;
+  param->sep = sep;
 }
 
 
@@ -349,6 +675,22 @@ void I_ShutdownSound(void)
       fprintf(sndserver, "q\n");
       fflush(sndserver);
     }
+#else
+  if (mixeropen)
+    {
+      if (wavfile)
+	{
+	  I_WriteWavHeader();
+	  fclose(wavfile);
+	  wavfile = NULL;
+	}
+      else
+	SDL_CloseAudio();
+      mixeropen = false;
+      if (sndcmdsdropped)
+	fprintf(stderr, "I_ShutdownSound: %i sounds dropped\n",
+		sndcmdsdropped);
+    }
 #endif /* SNDSERV */
   
   /* Done. */
@@ -360,8 +702,23 @@ void I_InitSound(void)
 {
 #ifdef SNDSERV
   char *buffer = (char *)malloc(256);
+  int rate;
+  int p;
+  int i;
   if (!buffer)
   	return;
+
+  /*
+   * -samplerate <hz>: the sfx are converted here, once, for the rate
+   *  the sound server will run at, and handed to it in sfxblock.
+   */
+  p = M_CheckParm("-samplerate");
+  rate = p && p < myargc-1 ? atoi(myargv[p+1]) : MIX_SPEED;
+  sndrate = rate;
+  if (M_CheckParm("-wavout"))
+    fprintf(stderr, "I_InitSound: -wavout needs the in-process mixer\n");
+  initmixer(MIX_DEFCHANNELS, rate);
+  I_LoadSfx(rate);
  
   sprintf(buffer, "%s", sndserver_filename);
   find_in_path(&buffer, 256);
@@ -374,18 +731,229 @@ void I_InitSound(void)
        strcat(buffer, " ");
        strcat(buffer, sndserver_options);
       }
+     p = M_CheckParm("-channels");
+     if (p && p < myargc-1)
+       sprintf(buffer+strlen(buffer), " -channels %d", atoi(myargv[p+1]));
+     if (sfxblock)
+       sprintf(buffer+strlen(buffer), " -sfxfd %d", sfxfd);
+     else
+       sprintf(buffer+strlen(buffer), " -samplerate %d", rate);
       sndserver = popen(buffer, "w");
     }
   else
     fprintf(stderr, "Could not start sound server [%s]\n", buffer);
+
+  /* the server has its own mapping now; the sfx in it go too */
+  if (sfxblock)
+    {
+      for (i=1 ; i<NUMSFX ; i++)
+	S_sfx[i].data = NULL;
+      munmap(sfxblock, sfxblock->size);
+      sfxblock = NULL;
+      close(sfxfd);
+      sfxfd = -1;
+    }
   
   free(buffer);
+#else
+  SDL_AudioSpec	spec;
+  SDL_AudioSpec	obtained;
+  int		p;
+
+  /* -samplerate <hz>: output rate */
+  p = M_CheckParm("-samplerate");
+  memset(&spec, 0, sizeof(spec));
+  spec.freq = p && p < myargc-1 ? atoi(myargv[p+1]) : MIX_SPEED;
+  spec.format = AUDIO_S16SYS;
+  spec.channels = 2;
+  spec.samples = MIX_SAMPLECOUNT;
+  spec.callback = I_MixSound;
+
+  /* -wavout <file>: render to a WAV file, no device */
+  p = M_CheckParm("-wavout");
+  if (p && p < myargc-1)
+    {
+      wavfile = fopen(myargv[p+1], "wb");
+      if (!wavfile)
+	I_Error("I_InitSound: can't write %s", myargv[p+1]);
+      wavframes = 0;
+    }
+  /*
+   * Mix at the rate the device runs at, so SDL doesn't resample again;
+   *  only a format it can't take as is makes SDL convert.
+   */
+  else if (SDL_Init(SDL_INIT_AUDIO) < 0
+	   || SDL_OpenAudio(&spec, &obtained) < 0)
+    {
+      fprintf(stderr, "I_InitSound: can't open audio: %s\n", SDL_GetError());
+      return;
+    }
+  else if (obtained.format != AUDIO_S16SYS || obtained.channels != 2)
+    {
+      SDL_CloseAudio();
+      if (SDL_OpenAudio(&spec, NULL) < 0)
+	{
+	  fprintf(stderr, "I_InitSound: can't open audio: %s\n",
+		  SDL_GetError());
+	  return;
+	}
+    }
+  else
+    spec.freq = obtained.freq;
+
+  /* -channels <n>: more simultaneous sounds in the mixer */
+  p = M_CheckParm("-channels");
+  initmixer(p && p < myargc-1 ? atoi(myargv[p+1]) : MIX_DEFCHANNELS,
+	    spec.freq);
+  I_LoadSfx(spec.freq);
+  sndrate = spec.freq;
+
+  /* the music synth's patches */
+  p = W_CheckNumForName("GENMIDI");
+  if (p >= 0 && (genmidi = malloc(W_LumpLength(p))) != NULL)
+    {
+      memcpy(genmidi, W_CacheLumpNum(p, PU_CACHE), W_LumpLength(p));
+      initmusic(genmidi, W_LumpLength(p), spec.freq);
+    }
+  else
+    initmusic(NULL, 0, spec.freq);
+  mixeropen = true;
+  if (wavfile)
+    I_WriteWavHeader();
+  else
+    SDL_PauseAudio(0);
 #endif /* SNDSERV */
 }
 
+/*
+ * MUSIC API.
+ * Songs play in the in-process mixer; the sound server
+ *  plays none.
+ */
+void I_InitMusic(void)
+{
+#ifndef SNDSERV
+  musicopen = mixeropen;
+#endif
+}
+
+
+void I_ShutdownMusic(void)
+{
+#ifndef SNDSERV
+  musicopen = false;
+  free(regsong);
+  regsong = NULL;
+#endif
+}
+
+
+void I_SetMusicVolume(int __attribute__((unused)) volume)
+{
+#ifndef SNDSERV
+  sndcmd_t*	cmd;
+
+  if (musicopen && (cmd = I_SoundCommand(SNDCMD_MUSICVOLUME)) != NULL)
+    {
+      cmd->value = volume;
+      I_PostSoundCommand();
+    }
+#endif
+}
+
+
+void I_PauseSong(int __attribute__((unused)) handle)
+{
+#ifndef SNDSERV
+  sndcmd_t*	cmd;
+
+  if (musicopen && (cmd = I_SoundCommand(SNDCMD_PAUSESONG)) != NULL)
+    {
+      cmd->value = 1;
+      I_PostSoundCommand();
+    }
+#endif
+}
+
+
+void I_ResumeSong(int __attribute__((unused)) handle)
+{
+#ifndef SNDSERV
+  sndcmd_t*	cmd;
+
+  if (musicopen && (cmd = I_SoundCommand(SNDCMD_PAUSESONG)) != NULL)
+    {
+      cmd->value = 0;
+      I_PostSoundCommand();
+    }
+#endif
+}
+
+
+/*
+ * Takes a copy of the song, as the audio thread
+ *  may play it after the lump is purged.
+ */
+int I_RegisterSong(void __attribute__((unused)) *data, int __attribute__((unused)) len)
+{
+#ifndef SNDSERV
+  if (!musicopen)
+    return 0;
+  free(regsong);
+  regsong = malloc(len);
+  if (!regsong)
+    return 0;
+  memcpy(regsong, data, len);
+  regsonglength = len;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+
+void I_PlaySong(int __attribute__((unused)) handle, int __attribute__((unused)) looping)
+{
+#ifndef SNDSERV
+  sndcmd_t*	cmd;
+
+  if (!musicopen || !regsong)
+    return;
+  if ((cmd = I_SoundCommand(SNDCMD_PLAYSONG)) != NULL)
+    {
+      /* the audio thread frees it */
+      cmd->data = regsong;
+      cmd->length = regsonglength;
+      cmd->value = looping;
+      regsong = NULL;
+      I_PostSoundCommand();
+    }
+#endif
+}
+
+
+void I_StopSong(int __attribute__((unused)) handle)
+{
+#ifndef SNDSERV
+  sndcmd_t*	cmd;
+
+  if (musicopen && (cmd = I_SoundCommand(SNDCMD_STOPSONG)) != NULL)
+    I_PostSoundCommand();
+#endif
+}
+
+
+void I_UnRegisterSong(int __attribute__((unused)) handle)
+{
+#ifndef SNDSERV
+  free(regsong);
+  regsong = NULL;
+#endif
+}
+
+
 void find_in_path(char **filename, int size)
 {
     (void)filename;
     (void)size;
-}      
-
+}
\ No newline at end of file
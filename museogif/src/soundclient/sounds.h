@@ -143,19 +143,6 @@ extern sfxinfo_t	S_sfx[];
 /* the complete set of music */
 extern musicinfo_t	S_music[];
 
-typedef struct
-{
-  /* sound information (if null, channel avail.) */
-  sfxinfo_t*	sfxinfo;
-  
-  /* origin of sound */
-  void*	origin;
-  
-  /* handle of the sound being played */
-  int		handle;
-  
-} channel_t;
-
 
 
 /* Sound identifiers */
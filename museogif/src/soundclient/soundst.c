@@ -15,6 +15,9 @@
  */
 long snd_SfxVolume = 15;
 
+/* Music volume, 0-15, set by the menu. */
+long snd_MusicVolume = 10;
+
 #define S_MAX_VOLUME		127
 
 /*
@@ -50,10 +53,48 @@ long snd_SfxVolume = 15;
 #define NA			0
 #define S_NUMCHANNELS		2
 
+/*
+ * Smallest change of a playing sound's volume or separation
+ *  that is passed on to the mixer; below that it isn't heard.
+ */
+#define S_VOL_THRESHOLD		1
+#define S_SEP_THRESHOLD		8
+
 
-/* the set of channels available */
 #ifdef __DOSOUND__
-static channel_t*	channels;
+/*
+ * The set of channels available, one array per field,
+ *  so that S_UpdateSounds goes through all channels
+ *  in one pass over just the fields it needs.
+ */
+typedef struct
+{
+  /* sound information (if null, channel avail.) */
+  sfxinfo_t**	sfxinfo;
+  
+  /* origin of sound */
+  mobj_t**	origin;
+  
+  /* handle of the sound being played */
+  int*		handle;
+  
+  /* volume and separation the mixer last got */
+  int*		vol;
+  int*		sep;
+  
+  /* origin position they were last worked out for */
+  fixed_t*	x;
+  fixed_t*	y;
+  
+} channels_t;
+
+static channels_t	channels;
+
+/* listener and sfx volume the channels were last updated for */
+static fixed_t		listenerx;
+static fixed_t		listenery;
+static angle_t		listenerangle;
+static long		listenervolume = -1;
 #endif /* __DOSOUND__ */
 
 /* whether songs are mus_paused */
@@ -85,6 +126,8 @@ static int S_getChannel( void* origin, sfxinfo_t* sfxinfo );
 static int S_AdjustSoundParams( mobj_t*	listener, mobj_t* source,
 				int* vol, int* sep, int* pitch );
 
+static void S_SetChannelParams( int cnum, int vol, int sep );
+
 static void S_StopChannel(int cnum);
 #endif /* __DOSOUND__ */
 
@@ -96,14 +139,14 @@ static void S_StopChannel(int cnum);
 static void S_StopChannel(int cnum)
 {
   int		i;
-  channel_t*	c = &channels[cnum];
+  sfxinfo_t*	sfxinfo = channels.sfxinfo[cnum];
   
-  if (c->sfxinfo)
+  if (sfxinfo)
     {
       /* stop the sound playing */
-      if (I_SoundIsPlaying(c->handle))
+      if (I_SoundIsPlaying(channels.handle[cnum]))
 	{
-	  I_StopSound(c->handle);
+	  I_StopSound(channels.handle[cnum]);
 	}
       
       /*
@@ -113,18 +156,28 @@ static void S_StopChannel(int cnum)
       for (i=0 ; i<numChannels ; i++)
 	{
 	  if (cnum != i
-	      && c->sfxinfo == channels[i].sfxinfo)
+	      && sfxinfo == channels.sfxinfo[i])
 	    {
 	      break;
 	    }
 	}
       
       /* degrade usefulness of sound data */
-      c->sfxinfo->usefulness--;
+      sfxinfo->usefulness--;
       
-      c->sfxinfo = 0;
+      channels.sfxinfo[cnum] = 0;
     }
 }
+
+
+/*
+ * Notes the parameters a channel was started or updated with.
+ */
+static void S_SetChannelParams( int cnum, int vol, int sep )
+{
+  channels.vol[cnum] = vol;
+  channels.sep[cnum] = sep;
+}
 #endif/* __DOSOUND__ */
 
 
@@ -206,14 +259,12 @@ static int S_getChannel( void* origin, sfxinfo_t* sfxinfo )
   /* channel number to use */
   int		cnum;
   
-  channel_t*	c;
-  
   /* Find an open channel */
   for (cnum=0 ; cnum<numChannels ; cnum++)
     {
-      if (!channels[cnum].sfxinfo)
+      if (!channels.sfxinfo[cnum])
 	break;
-      else if (origin &&  channels[cnum].origin ==  origin)
+      else if (origin &&  channels.origin[cnum] ==  origin)
 	{
 	  S_StopChannel(cnum);
 	  break;
@@ -225,7 +276,7 @@ static int S_getChannel( void* origin, sfxinfo_t* sfxinfo )
     {
       /* Look for lower priority */
       for (cnum=0 ; cnum<numChannels ; cnum++)
-	if (channels[cnum].sfxinfo->priority >= sfxinfo->priority) break;
+	if (channels.sfxinfo[cnum]->priority >= sfxinfo->priority) break;
       
       if (cnum == numChannels)
 	{
@@ -239,11 +290,9 @@ static int S_getChannel( void* origin, sfxinfo_t* sfxinfo )
 	}
     }
   
-  c = &channels[cnum];
-  
   /* channel is decided to be cnum. */
-  c->sfxinfo = sfxinfo;
-  c->origin = origin;
+  channels.sfxinfo[cnum] = sfxinfo;
+  channels.origin[cnum] = origin;
   
   return cnum;
 }
@@ -259,10 +308,13 @@ static int S_getChannel( void* origin, sfxinfo_t* sfxinfo )
  */
 void S_Init( int sfxVolume, int	musicVolume )
 {
+#ifndef __DOMUSIC__
     (void)musicVolume;
+#endif
 
 #ifdef __DOSOUND__
   int i;
+  byte* p;
 
   /* Whatever these did with DMX, these are rather dummies now. */
   I_SetChannels();
@@ -274,16 +326,28 @@ void S_Init( int sfxVolume, int	musicVolume )
    * (the maximum numer of sounds rendered
    * simultaneously) within zone memory.
    */
-  channels = 
-    (channel_t *) Z_Malloc(numChannels*sizeof(channel_t), PU_STATIC, 0);
+  p = Z_Malloc(numChannels*(sizeof(*channels.sfxinfo)
+			     + sizeof(*channels.origin)
+			     + 3*sizeof(int) + 2*sizeof(fixed_t)),
+	       PU_STATIC, 0);
+  channels.sfxinfo = (sfxinfo_t **) p;
+  p += numChannels*sizeof(*channels.sfxinfo);
+  channels.origin = (mobj_t **) p;
+  p += numChannels*sizeof(*channels.origin);
+  channels.handle = (int *) p;
+  channels.vol = channels.handle + numChannels;
+  channels.sep = channels.vol + numChannels;
+  channels.x = (fixed_t *) (channels.sep + numChannels);
+  channels.y = channels.x + numChannels;
   
   /* Free all channels for use */
   for (i=0 ; i<numChannels ; i++)
-    channels[i].sfxinfo = 0;
+    channels.sfxinfo[i] = 0;
 
   /* no sounds are playing, and they are not mus_paused */
 #ifdef __DOMUSIC__
   mus_paused = 0;
+  S_SetMusicVolume(musicVolume);
 #endif /* __DOMUSIC__ */
 
   /* Note that sounds have not been cached (yet). */
@@ -312,7 +376,7 @@ void S_Start(void)
    * (trust me - a good idea)
    */
   for (cnum=0 ; cnum<numChannels ; cnum++)
-    if (channels[cnum].sfxinfo)
+    if (channels.sfxinfo[cnum])
       S_StopChannel(cnum);
 
   /* start new music for the level */
@@ -353,6 +417,7 @@ void S_Start(void)
 	mnum = spmus[gamemap-1];
     }
 
+  S_StartSong(mnum, true);
   }
 #endif /* __DOMUSIC__ */
   nextcleanup = 15;  
@@ -375,6 +440,9 @@ void S_StartSoundAtVolume( void* origin_p, int sfx_id, int volume )
   int		cnum;
   mobj_t*	origin = (mobj_t *) origin_p;
  
+  /* a predicted tic is undone, its sounds must not be heard */
+  if (predicting)
+    return;
   
   /* check for bogus sound # */
   
@@ -504,7 +572,13 @@ void S_StartSoundAtVolume( void* origin_p, int sfx_id, int volume )
 	  volume, sep, pitch, priority );
 #endif /* _DEBUGSOUND */
   
-  channels[cnum].handle = I_StartSound( sfx_id, volume, sep, pitch, priority );
+  channels.handle[cnum] = I_StartSound( sfx_id, volume, sep, pitch, priority );
+  S_SetChannelParams(cnum, volume, sep);
+  if (origin)
+    {
+      channels.x[cnum] = origin->x;
+      channels.y[cnum] = origin->y;
+    }
 #endif /* __DOSOUND__ */
   
 #ifdef _DEBUGSOUND
@@ -532,7 +606,7 @@ void S_StopSound(void* origin)
   
   for (cnum=0 ; cnum<numChannels ; cnum++)
     {
-      if (channels[cnum].sfxinfo && channels[cnum].origin == origin)
+      if (channels.sfxinfo[cnum] && channels.origin[cnum] == origin)
 	{
 	  S_StopChannel(cnum);
 	  break;
@@ -582,6 +656,11 @@ void S_ResumeSound(void)
 
 /*
  * Updates music & sounds
+ * All channels are gone through in one pass. A channel whose
+ *  origin hasn't moved relative to an unmoved listener keeps its
+ *  parameters without any work; the others have them worked out
+ *  again, but only changes past S_VOL_THRESHOLD / S_SEP_THRESHOLD
+ *  go to the mixer, all in one batch sent with I_SubmitSound.
  */
 void S_UpdateSounds(void* listener_p)
 {
@@ -591,67 +670,95 @@ void S_UpdateSounds(void* listener_p)
   int		volume;
   int		sep;
   int		pitch;
+  boolean	moved;
   sfxinfo_t*	sfx;
-  channel_t*	c;
+  mobj_t*	origin;
   
   mobj_t*	listener = (mobj_t*)listener_p;
   
+  /*
+   * everything needs working out again once the listener moves;
+   *  outside a level there is none, and no positional sound
+   */
+  moved = false;
+  if (listener)
+    {
+      moved = listener->x != listenerx || listener->y != listenery
+	|| listener->angle != listenerangle || snd_SfxVolume != listenervolume;
+      listenerx = listener->x;
+      listenery = listener->y;
+      listenerangle = listener->angle;
+      listenervolume = snd_SfxVolume;
+    }
+  
   for (cnum=0 ; cnum<numChannels ; cnum++)
     {
-      c = &channels[cnum];
-      sfx = c->sfxinfo;
+      sfx = channels.sfxinfo[cnum];
       
-      if (c->sfxinfo)
+      if (!sfx)
+	continue;
+      
+      if (!I_SoundIsPlaying(channels.handle[cnum]))
 	{
-	  if (I_SoundIsPlaying(c->handle))
+	  /*
+	   * if channel is allocated but sound has stopped,
+	   *  free it
+	   */
+	  S_StopChannel(cnum);
+	  continue;
+	}
+      
+      /*
+       * only non-local sounds are distance clipped
+       *  or have their params modified
+       */
+      origin = channels.origin[cnum];
+      if (!origin || origin == listener || !listener)
+	continue;
+      if (!moved
+	  && origin->x == channels.x[cnum] && origin->y == channels.y[cnum])
+	continue;
+      
+      /* initialize parameters */
+      volume = snd_SfxVolume;
+      pitch = NORM_PITCH;
+      sep = NORM_SEP;
+      
+      if (sfx->link)
+	{
+	  pitch = sfx->pitch;
+	  volume += sfx->volume;
+	  if (volume < 1)
 	    {
-	      /* initialize parameters */
-	      volume = snd_SfxVolume;
-	      pitch = NORM_PITCH;
-	      sep = NORM_SEP;
-	      
-	      if (sfx->link)
-		{
-		  pitch = sfx->pitch;
-		  volume += sfx->volume;
-		  if (volume < 1)
-		    {
-		      S_StopChannel(cnum);
-		      continue;
-		    }
-		  else if (volume > snd_SfxVolume)
-		    {
-		      volume = snd_SfxVolume;
-		    }
-		}
-
-	      /*
-	       * check non-local sounds for distance clipping
-	       *  or modify their params
-	       */
-	      if (c->origin && listener_p != c->origin)
-		{
-		  audible = S_AdjustSoundParams(listener, c->origin,
-						&volume, &sep, &pitch);
-		  
-		  if (!audible)
-		    {
-		      S_StopChannel(cnum);
-		    }
-		  else
-		    I_UpdateSoundParams(c->handle, volume, sep, pitch);
-		}
+	      S_StopChannel(cnum);
+	      continue;
 	    }
-	  else
+	  else if (volume > snd_SfxVolume)
 	    {
-	      /*
-	       * if channel is allocated but sound has stopped,
-	       *  free it
-	       */
-	      S_StopChannel(cnum);
+	      volume = snd_SfxVolume;
 	    }
 	}
+      
+      audible = S_AdjustSoundParams(listener, origin,
+				    &volume, &sep, &pitch);
+      channels.x[cnum] = origin->x;
+      channels.y[cnum] = origin->y;
+      
+      if (!audible)
+	{
+	  S_StopChannel(cnum);
+	}
+      else if (abs(volume - channels.vol[cnum]) >= S_VOL_THRESHOLD
+	       || abs(sep - channels.sep[cnum]) >= S_SEP_THRESHOLD)
+	{
+	  I_UpdateSoundParams(channels.handle[cnum], volume, sep, pitch);
+	  S_SetChannelParams(cnum, volume, sep);
+	}
     }
+  
+  /* hand this frame's changes to the mixer at once */
+  I_SubmitSound();
+  I_UpdateSound();
 #endif /* __DOSOUND__ */  
 
 #ifdef _DEBUGSOUND
@@ -659,10 +766,6 @@ void S_UpdateSounds(void* listener_p)
 #endif
 }
 
-/*
- * Starts some music with the music id found in sounds.h.
- */
-
 void S_SetSfxVolume(int volume)
 {
 #ifdef __DOSOUND__
@@ -676,3 +779,75 @@ void S_SetSfxVolume(int volume)
     fprintf(stderr, "FIXME: Calling S_SetSfxVolume...\n");
 #endif
 }
+
+
+/*
+ * Starts some music with the music id found in sounds.h,
+ *  unless it is playing already.
+ */
+void S_StartSong(int song, boolean loop)
+{
+#ifdef __DOMUSIC__
+  musicinfo_t*	music;
+  int		lump;
+
+  if (song <= mus_None || song >= NUMMUSIC)
+    I_Error("Bad music number %d", song);
+
+  music = &S_music[song];
+  if (mus_playing == music)
+    return;
+
+  S_StopSong();
+
+  /* the shareware WAD has only some of the songs */
+  lump = W_CheckNumForName(music->name);
+  if (lump < 0)
+    return;
+
+  music->lumpnum = lump;
+  music->data = W_CacheLumpNum(lump, PU_MUSIC);
+  music->handle = I_RegisterSong(music->data, W_LumpLength(lump));
+  I_PlaySong(music->handle, loop);
+  mus_playing = music;
+#else
+  (void)song;
+  (void)loop;
+#endif /* __DOMUSIC__ */
+}
+
+
+void S_StopSong(void)
+{
+#ifdef __DOMUSIC__
+  if (mus_playing)
+    {
+      if (mus_paused)
+	{
+	  I_ResumeSong(mus_playing->handle);
+	  mus_paused = false;
+	}
+
+      I_StopSong(mus_playing->handle);
+      I_UnRegisterSong(mus_playing->handle);
+      Z_ChangeTag(mus_playing->data, PU_CACHE);
+
+      mus_playing->data = 0;
+      mus_playing = 0;
+    }
+#endif /* __DOMUSIC__ */
+}
+
+
+void S_SetMusicVolume(int volume)
+{
+#ifdef __DOMUSIC__
+  if (volume < 0 || volume > 15)
+    I_Error("Attempt to set music volume at %d", volume);
+
+  I_SetMusicVolume(volume);
+  snd_MusicVolume = volume;
+#else
+  (void)volume;
+#endif /* __DOMUSIC__ */
+}
@@ -5,6 +5,7 @@
 #define __SOUNDSTH__
 
 extern long snd_SfxVolume;
+extern long snd_MusicVolume;
 
 /*
  * Initializes sound stuff, including volume
@@ -50,6 +51,16 @@ void S_UpdateSounds(void* listener_p);
 
 void S_SetSfxVolume(int volume);
 
+/*
+ * Start music using <song> from sounds.h,
+ *  looping it if <loop>; stop it again.
+ */
+void S_StartSong(int song, boolean loop);
+void S_StopSong(void);
+
+/* 0-15 */
+void S_SetMusicVolume(int volume);
+
 void S_SetMaxVolume(boolean fullprocess);
 
 #endif
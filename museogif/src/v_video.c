@@ -6,7 +6,8 @@
 static inline int chps( byte );
 
 byte *screen;
-int dirtybox[4];
+dirtyrect_t dirtyrects[MAXDIRTYRECTS];
+int numdirtyrects;
 long usegamma;
 
 int screenwidth,screenheight;
@@ -29,6 +30,9 @@ byte gammatable[5][256] =
 
 /*
  * V_MarkRect
+ * Adds a drawn area to the dirty rects I_FinishUpdate looks at.  An area
+ *  touching a rect already there grows it; with the list full it grows
+ *  the one that gets least bigger.
  */
 void V_MarkRect( 
 		int		x,
@@ -36,8 +40,61 @@ void V_MarkRect(
 		int		width,
 		int		height )
 {
-  M_AddToBox (dirtybox, x, y);
-  M_AddToBox (dirtybox, x+width-1, y+height-1);
+  dirtyrect_t	*r, *best;
+  int		x2 = x+width;
+  int		y2 = y+height;
+  int		grow, bestgrow;
+
+  if (x < 0)
+    x = 0;
+  if (y < 0)
+    y = 0;
+  if (x2 > screenwidth)
+    x2 = screenwidth;
+  if (y2 > screenheight)
+    y2 = screenheight;
+  if (x >= x2 || y >= y2)
+    return;
+
+  for (r = dirtyrects ; r < dirtyrects+numdirtyrects ; r++)
+    if (x <= r->x2 && x2 >= r->x1 && y <= r->y2 && y2 >= r->y1)
+      break;
+
+  if (r == dirtyrects+numdirtyrects)
+    {
+      if (numdirtyrects < MAXDIRTYRECTS)
+	{
+	  r->x1 = x;
+	  r->y1 = y;
+	  r->x2 = x2;
+	  r->y2 = y2;
+	  numdirtyrects++;
+	  return;
+	}
+      best = dirtyrects;
+      bestgrow = MAXINT;
+      for (r = dirtyrects ; r < dirtyrects+numdirtyrects ; r++)
+	{
+	  grow = ((x2 > r->x2 ? x2 : r->x2) - (x < r->x1 ? x : r->x1))
+	    * ((y2 > r->y2 ? y2 : r->y2) - (y < r->y1 ? y : r->y1))
+	    - (r->x2 - r->x1) * (r->y2 - r->y1);
+	  if (grow < bestgrow)
+	    {
+	      best = r;
+	      bestgrow = grow;
+	    }
+	}
+      r = best;
+    }
+
+  if (x < r->x1)
+    r->x1 = x;
+  if (y < r->y1)
+    r->y1 = y;
+  if (x2 > r->x2)
+    r->x2 = x2;
+  if (y2 > r->y2)
+    r->y2 = y2;
 }
 
 
@@ -123,10 +180,7 @@ void V_DrawPatch(int x, int y, patch_t *patch)
     }
 #endif
 
-  /* not needed: no doublebuffering !!!
-     if (!scrn)
-     V_MarkRect (x, y, SHORT(patch->width), SHORT(patch->height));
-  */
+  V_MarkRect (x, y, SHORT(patch->width), SHORT(patch->height));
   
   col = 0;
   desttop = screen+y*screenwidth+x;
@@ -183,6 +237,7 @@ void V_DrawFuzzPatch (int x, int y, patch_t *patch)
       I_Error ("Bad V_DrawFuzzPatch");
     }
 #endif
+  V_MarkRect (x, y, SHORT(patch->width), SHORT(patch->height));
   col = 0;
   desttop = screen+y*screenwidth+x;
   
@@ -242,6 +297,8 @@ void V_DrawShadowedPatch(int x, int y, patch_t *patch)
     }
 #endif
   
+  /* the shadow is 2 pixels down and right */
+  V_MarkRect (x, y, SHORT(patch->width)+2, SHORT(patch->height)+2);
   col = 0;
   desttop = screen+y*screenwidth+x;
   desttop2 = screen+(y+2)*screenwidth+x+2;
@@ -317,6 +374,7 @@ do_scale2x(int stride, byte *dest, byte *src)
 
 void V_DrawRawScreen(byte *raw)
 {
+	V_MarkRect(0, 0, screenwidth, screenheight);
 	if (screenwidth != SCREENWIDTH || SCREENHEIGHT != screenheight) {
 		byte *scrptr;
 		int y;